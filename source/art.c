@@ -0,0 +1,452 @@
+#include "art.h"
+#include "cache.h"
+#include "memory.h"
+#include "player.h"
+#include "stats.h"
+
+#include <png.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <turbojpeg.h>
+
+#define ART_CACHE_VERSION 1
+#define ART_TEX_BYTES     (ART_SIZE * ART_SIZE * sizeof(u16))
+#define ART_THREAD_STACK  (64 * 1024)
+#define ART_FRONT_COVER   3  // FLAC picture type
+
+// Giving the texture back under memory pressure takes a frame drawn without it, so the GPU is done with it
+typedef enum {
+    DROP_NONE,
+    DROP_REQUESTED,  // hide it at the next artUpdate
+    DROP_HIDDEN,     // a frame without it is being drawn; delete at the next artUpdate
+} TextureDrop;
+
+static const Tex3DS_SubTexture art_subtex = { ART_SIZE, ART_SIZE, 0.0f, 1.0f, 1.0f, 0.0f };
+
+static struct {
+    Thread thread;
+    LightEvent wake;
+    LightLock lock;
+    volatile bool quit;
+    int requested;     // track the UI wants art for, -1 for none
+    bool pendingReady; // worker finished `requested`; pending may be NULL for "no art"
+    u16* pending;
+    bool showing;
+    bool hasTexture;
+    TextureDrop drop;
+    C3D_Tex texture;
+} art;
+
+// === PICTURE EXTRACTION ===
+
+static u32 read_be32(const u8* p) {
+    return ((u32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static u32 read_le32(const u8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int base64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+static u8* base64_decode(const char* text, u32 length, u32* size) {
+    u8* out = (u8*)malloc(length / 4 * 3 + 3);
+    if (!out)
+        return NULL;
+
+    u32 bits = 0, count = 0, written = 0;
+    for (u32 i = 0; i < length; ++i) {
+        int value = base64_value(text[i]);
+        if (value < 0)
+            continue;  // padding or line breaks
+        bits = (bits << 6) | value;
+        if (++count == 4) {
+            out[written++] = bits >> 16;
+            out[written++] = bits >> 8;
+            out[written++] = bits;
+            bits = count = 0;
+        }
+    }
+    if (count == 3) {
+        out[written++] = bits >> 10;
+        out[written++] = bits >> 2;
+    } else if (count == 2) {
+        out[written++] = bits >> 4;
+    }
+    *size = written;
+    return out;
+}
+
+/* Finds the embedded picture in a Vorbis comment packet
+Returns the decoded FLAC picture block, preferring the front cover when a
+track carries several pictures.
+*/
+static u8* find_picture(const u8* packet, u32 size, u32* blockSize) {
+    if (size < 11 || packet[0] != 3 || memcmp(packet + 1, "vorbis", 6) != 0)
+        return NULL;
+
+    static const char key[] = "METADATA_BLOCK_PICTURE=";
+    const u32 keyLength = sizeof(key) - 1;
+    u8* best = NULL;
+
+    u32 pos = 7;
+    u32 vendorLength = read_le32(packet + pos);
+    pos += 4;
+    if (vendorLength > size - pos || size - pos - vendorLength < 4)
+        return NULL;
+    pos += vendorLength;
+
+    u32 count = read_le32(packet + pos);
+    pos += 4;
+    for (u32 i = 0; i < count && size - pos >= 4; ++i) {
+        u32 length = read_le32(packet + pos);
+        pos += 4;
+        if (length > size - pos)
+            break;
+
+        const char* comment = (const char*)packet + pos;
+        pos += length;
+        if (length <= keyLength || strncasecmp(comment, key, keyLength) != 0)
+            continue;
+
+        u32 decodedSize;
+        u8* block = base64_decode(comment + keyLength, length - keyLength, &decodedSize);
+        if (!block || decodedSize < 32) {
+            free(block);
+            continue;
+        }
+
+        if (!best || read_be32(block) == ART_FRONT_COVER) {
+            free(best);
+            best = block;
+            *blockSize = decodedSize;
+            if (read_be32(block) == ART_FRONT_COVER)
+                break;
+        } else {
+            free(block);
+        }
+    }
+    return best;
+}
+
+// Image bytes inside a FLAC picture block
+static const u8* picture_data(const u8* block, u32 size, u32* dataSize) {
+    u32 pos = 4;
+    for (int field = 0; field < 2; ++field) {  // MIME type, then description
+        if (size - pos < 4)
+            return NULL;
+        u32 length = read_be32(block + pos);
+        pos += 4;
+        if (length > size - pos)
+            return NULL;
+        pos += length;
+    }
+
+    if (size - pos < 20)
+        return NULL;
+    pos += 16;  // width, height, depth, colors: the image header is authoritative
+    u32 length = read_be32(block + pos);
+    pos += 4;
+    if (length > size - pos)
+        return NULL;
+
+    *dataSize = length;
+    return block + pos;
+}
+
+// === DECODING ===
+
+/* JPEG through libjpeg-turbo
+The IDCT can scale by 1/2, 1/4 and 1/8 for free, so decode at the
+smallest size that still covers ART_SIZE and let the box filter do the rest.
+*/
+static u8* decode_jpeg(const u8* data, u32 size, int* width, int* height) {
+    tjhandle handle = tjInitDecompress();
+    if (!handle)
+        return NULL;
+
+    int w, h, subsampling, colorspace;
+    u8* rgb = NULL;
+    if (tjDecompressHeader3(handle, data, size, &w, &h, &subsampling, &colorspace) == 0) {
+        int factorCount;
+        tjscalingfactor* factors = tjGetScalingFactors(&factorCount);
+        int bestW = w, bestH = h;
+        for (int i = 0; i < factorCount; ++i) {
+            int sw = TJSCALED(w, factors[i]);
+            int sh = TJSCALED(h, factors[i]);
+            if (sw >= ART_SIZE && sh >= ART_SIZE && sw * sh < bestW * bestH) {
+                bestW = sw;
+                bestH = sh;
+            }
+        }
+
+        rgb = (u8*)malloc(bestW * bestH * 3);
+        if (rgb && tjDecompress2(handle, data, size, rgb, bestW, 0, bestH, TJPF_RGB, TJFLAG_FASTDCT) == 0) {
+            *width = bestW;
+            *height = bestH;
+        } else {
+            free(rgb);
+            rgb = NULL;
+        }
+    }
+    tjDestroy(handle);
+    return rgb;
+}
+
+static u8* decode_png(const u8* data, u32 size, int* width, int* height) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&image, data, size))
+        return NULL;
+
+    image.format = PNG_FORMAT_RGB;
+    u8* rgb = (u8*)malloc(PNG_IMAGE_SIZE(image));
+    if (!rgb || !png_image_finish_read(&image, NULL, rgb, 0, NULL)) {
+        png_image_free(&image);
+        free(rgb);
+        return NULL;
+    }
+    *width = image.width;
+    *height = image.height;
+    return rgb;
+}
+
+// Offset of pixel (x, y) in the GPU's 8x8 Morton-ordered tiles; y counts up from the bottom row, as the GPU's t does
+static u32 tile_offset(u32 x, u32 y) {
+    u32 tile = ((y >> 3) * (ART_SIZE >> 3) + (x >> 3)) << 6;
+    return tile | (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+}
+
+// Centre-crops to a square, box-filters down to ART_SIZE and writes tiled RGB565, flipped so the top row lands at t = 1
+static u16* scale_and_tile(const u8* rgb, int width, int height) {
+    u16* pixels = (u16*)malloc(ART_TEX_BYTES);
+    if (!pixels)
+        return NULL;
+
+    int side = width < height ? width : height;
+    int left = (width - side) / 2, top = (height - side) / 2;
+    for (int y = 0; y < ART_SIZE; ++y) {
+        int y0 = top + y * side / ART_SIZE;
+        int y1 = top + (y + 1) * side / ART_SIZE;
+        if (y1 == y0) y1++;
+        for (int x = 0; x < ART_SIZE; ++x) {
+            int x0 = left + x * side / ART_SIZE;
+            int x1 = left + (x + 1) * side / ART_SIZE;
+            if (x1 == x0) x1++;
+
+            u32 r = 0, g = 0, b = 0, n = (x1 - x0) * (y1 - y0);
+            for (int sy = y0; sy < y1; ++sy) {
+                const u8* p = rgb + (sy * width + x0) * 3;
+                for (int sx = x0; sx < x1; ++sx, p += 3) {
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                }
+            }
+            r /= n; g /= n; b /= n;
+            pixels[tile_offset(x, ART_SIZE - 1 - y)] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        }
+    }
+    return pixels;
+}
+
+static u16* decode_art(int track) {
+    u32 size;
+    u8* comments = playerTrackComments(track, &size);
+    if (!comments)
+        return NULL;
+
+    u32 blockSize;
+    u8* block = find_picture(comments, size, &blockSize);
+    free(comments);
+    if (!block)
+        return NULL;
+
+    u32 dataSize;
+    const u8* data = picture_data(block, blockSize, &dataSize);
+    u8* rgb = NULL;
+    int width = 0, height = 0;
+    if (data && dataSize > 8) {
+        if (data[0] == 0xFF && data[1] == 0xD8)
+            rgb = decode_jpeg(data, dataSize, &width, &height);
+        else if (memcmp(data, "\x89PNG", 4) == 0)
+            rgb = decode_png(data, dataSize, &width, &height);
+    }
+    free(block);
+    if (!rgb)
+        return NULL;
+
+    // Decoded image and texture are both alive while scaling
+    s32 scratch = width * height * 3 + ART_TEX_BYTES;
+    statsMemory(STATS_MEMORY_ART, scratch);
+    u16* pixels = scale_and_tile(rgb, width, height);
+    free(rgb);
+    statsMemory(STATS_MEMORY_ART, -scratch);
+    return pixels;
+}
+
+// Cached texture if there is one, else decode and cache it. "No art" is cached too, as an empty entry.
+static u16* load_art(int track) {
+    CacheKey key = playerTrackCacheKey(track);
+    u32 size;
+    u16* pixels = (u16*)cacheLoad(CACHE_KIND_ART, ART_CACHE_VERSION, key, &size);
+    if (pixels) {
+        if (size == ART_TEX_BYTES)
+            return pixels;
+        free(pixels);
+        return NULL;
+    }
+
+    // Decoding holds the whole image at once; under memory pressure the track goes without art until asked again
+    if (memoryPressure() != MEMORY_PRESSURE_NONE)
+        return NULL;
+    pixels = decode_art(track);
+    cacheStore(CACHE_KIND_ART, ART_CACHE_VERSION, key, pixels, pixels ? ART_TEX_BYTES : 0);
+    return pixels;
+}
+
+// === BACKGROUND JOB ===
+
+static void art_thread(void* arg) {
+    while (!art.quit) {
+        LightEvent_Wait(&art.wake);
+
+        LightLock_Lock(&art.lock);
+        int track = art.requested;
+        bool done = art.pendingReady;
+        LightLock_Unlock(&art.lock);
+        if (art.quit || track < 0 || done)
+            continue;
+
+        u16* pixels = load_art(track);
+
+        // Only hand over the result if nobody asked for another track meanwhile
+        LightLock_Lock(&art.lock);
+        if (art.requested == track) {
+            free(art.pending);
+            art.pending = pixels;
+            art.pendingReady = true;
+            pixels = NULL;
+        }
+        LightLock_Unlock(&art.lock);
+        free(pixels);
+
+        if (art.requested != track)
+            LightEvent_Signal(&art.wake);
+    }
+}
+
+/* Finished pixels nobody has uploaded are dropped at any pressure; when it
+is critical the texture goes too, a frame later (see TextureDrop). Both
+come back from the cache the next time the track's art is requested.
+*/
+static u32 release_art(MemoryPressure pressure, void* unused) {
+    LightLock_Lock(&art.lock);
+    u32 freed = art.pending ? ART_TEX_BYTES : 0;
+    free(art.pending);
+    art.pending = NULL;
+    art.pendingReady = false;  // otherwise artUpdate would take the dropped pixels for "no art"
+    LightLock_Unlock(&art.lock);
+
+    if (pressure == MEMORY_PRESSURE_CRITICAL && art.hasTexture && art.drop == DROP_NONE)
+        art.drop = DROP_REQUESTED;
+    return freed;
+}
+
+// === ART API ===
+
+void artInit(void) {
+    memset(&art, 0, sizeof(art));
+    art.requested = -1;
+    LightLock_Init(&art.lock);
+    LightEvent_Init(&art.wake, RESET_ONESHOT);
+
+    // Below the UI thread so decoding only uses time the UI leaves idle
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+    art.thread = threadCreate(art_thread, NULL, ART_THREAD_STACK, priority + 1, -1, false);
+    memorySubscribe(MEMORY_PRIORITY_ART, release_art, NULL);
+}
+
+void artExit(void) {
+    memoryUnsubscribe(release_art, NULL);
+    if (art.thread) {
+        art.quit = true;
+        LightEvent_Signal(&art.wake);
+        threadJoin(art.thread, U64_MAX);
+        threadFree(art.thread);
+        art.thread = NULL;
+    }
+    free(art.pending);
+    art.pending = NULL;
+    if (art.hasTexture)
+        C3D_TexDelete(&art.texture);
+    art.hasTexture = false;
+}
+
+void artRequest(int track) {
+    LightLock_Lock(&art.lock);
+    art.requested = track;
+    art.pendingReady = false;
+    free(art.pending);
+    art.pending = NULL;
+    art.showing = false;
+    LightLock_Unlock(&art.lock);
+    LightEvent_Signal(&art.wake);
+}
+
+bool artUpdate(void) {
+    if (art.drop == DROP_REQUESTED) {
+        art.showing = false;
+        art.drop = DROP_HIDDEN;
+        return true;
+    }
+    if (art.drop == DROP_HIDDEN) {
+        C3D_TexDelete(&art.texture);
+        art.hasTexture = false;
+        art.drop = DROP_NONE;
+    }
+
+    LightLock_Lock(&art.lock);
+    bool ready = art.pendingReady;
+    u16* pixels = art.pending;
+    if (ready) {
+        art.pending = NULL;
+        art.pendingReady = false;
+        art.requested = -1;
+    }
+    LightLock_Unlock(&art.lock);
+
+    if (!ready || !pixels)
+        return false;
+
+    if (!art.hasTexture) {
+        art.hasTexture = C3D_TexInit(&art.texture, ART_SIZE, ART_SIZE, GPU_RGB565);
+        if (art.hasTexture)
+            C3D_TexSetFilter(&art.texture, GPU_LINEAR, GPU_LINEAR);
+    }
+    if (art.hasTexture) {
+        C3D_TexUpload(&art.texture, pixels);
+        art.showing = true;
+    }
+    free(pixels);
+    return art.showing;
+}
+
+bool artGetImage(C2D_Image* image) {
+    if (!art.showing)
+        return false;
+
+    image->tex = &art.texture;
+    image->subtex = &art_subtex;
+    return true;
+}
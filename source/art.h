@@ -0,0 +1,27 @@
+#ifndef ART_H
+#define ART_H
+
+#include <citro2d.h>
+
+/* Album art from METADATA_BLOCK_PICTURE comments
+Decoding and scaling happen on a background thread; the result is a
+128x128 RGB565 texture already in the GPU's tiled layout, which is what
+goes into the on-disk cache. Showing art a second time is one cache read
+and one texture upload.
+*/
+
+#define ART_SIZE 128
+
+void artInit(void);
+void artExit(void);
+
+// Starts loading art for a track, dropping any request still in flight
+void artRequest(int track);
+
+// Uploads finished art; call once per frame from the thread that renders. True if the image changed.
+bool artUpdate(void);
+
+// The current track's art, or false if it has none (or it isn't ready yet)
+bool artGetImage(C2D_Image* image);
+
+#endif // ART_H
@@ -0,0 +1,22 @@
+#include "assets.h"
+
+#include <stddef.h>
+
+// Defined in assets_manifest.c, which tools/mkmanifest.c writes at build time
+extern const EmbeddedAsset assetManifest[];
+extern const int assetManifestCount;
+extern const PackSeekPoint assetManifestSeekPoints[];
+
+int assetCount(void) {
+    return assetManifestCount;
+}
+
+const EmbeddedAsset* assetGet(int index) {
+    if (index < 0 || index >= assetManifestCount)
+        return NULL;
+    return &assetManifest[index];
+}
+
+const PackSeekPoint* assetSeekPoints(void) {
+    return assetManifestSeekPoints;
+}
@@ -0,0 +1,30 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "pack.h"
+
+/* Ogg tracks built into the executable, used when there's no library pack
+The table is generated at build time by tools/mkmanifest.c from whatever is
+in assets/, so adding a track needs no code changes. Besides the data it
+carries what the player would otherwise parse on device: length, format and
+a seek table. A zero sampleRate means none of that is known (the host
+stand-in may leave it out) and the player works it out when the track plays.
+*/
+typedef struct {
+    const unsigned char* data;
+    unsigned int size;
+    const char* name;
+    u32 totalSamples;
+    u32 sampleRate;
+    u16 channels;
+    u32 seekFirst;  // index of the first point in assetSeekPoints()
+    u32 seekCount;
+} EmbeddedAsset;
+
+int assetCount(void);
+const EmbeddedAsset* assetGet(int index);
+
+// Seek points of every embedded track, back to back
+const PackSeekPoint* assetSeekPoints(void);
+
+#endif // ASSETS_H
@@ -0,0 +1,172 @@
+#include "boost.h"
+
+#include <string.h>
+
+#define BOOST_SMOOTHING   0.1f                  // weight of the newest batch in the moving averages
+#define BOOST_IDLE_TICKS  (SYSCLOCK_ARM11 / 2)  // no reports for this long means nothing is decoding
+
+static struct {
+    LightLock lock;
+    bool available;  // New 3DS
+    bool wanted;     // the controller's decision, logged on either model
+
+    // Written by boostReport under `lock`
+    float ticksPerSample;  // smoothed decode cost
+    float fill;            // smoothed queue fill
+    u32 rate;
+    float comfortableSeconds;
+    float boostedSeconds;
+    float playedSeconds;
+    u64 lastReport;
+
+    int track;
+    u32 boosts;
+
+    BoostEvent log[BOOST_LOG_LENGTH];
+    u32 logHead;
+    u32 logCount;
+} boost;
+
+static void log_event(BoostEvent* event) {
+    if (boost.logCount == BOOST_LOG_LENGTH) {
+        // Full: drop the oldest so the newest transitions are always visible
+        boost.logHead = (boost.logHead + 1) % BOOST_LOG_LENGTH;
+        boost.logCount--;
+    }
+    boost.log[(boost.logHead + boost.logCount) % BOOST_LOG_LENGTH] = *event;
+    boost.logCount++;
+}
+
+// Whether the clock really is boosted; on Old 3DS it never is, however much boost is wanted
+static bool boost_applied(void) {
+    return boost.available && boost.wanted;
+}
+
+// Decode speed as a multiple of realtime, scaled back to the normal clock while boosted
+static float unboosted_realtime(void) {
+    if (boost.ticksPerSample <= 0.0f || boost.rate == 0)
+        return 0.0f;
+    float realtime = SYSCLOCK_ARM11 / (boost.ticksPerSample * boost.rate);
+    return boost_applied() ? realtime / BOOST_SPEEDUP : realtime;
+}
+
+static void set_boost(bool enabled) {
+    if (boost.available)
+        osSetSpeedupEnable(enabled);
+
+    LightLock_Lock(&boost.lock);
+    BoostEvent event = {
+        .type = enabled ? BOOST_EVENT_ON : BOOST_EVENT_OFF,
+        .track = boost.track,
+        .realtime = unboosted_realtime(),
+        .fill = boost.fill,
+        .playedSeconds = boost.playedSeconds,
+    };
+    // The cost measured so far was at the other clock, if the clock changed
+    if (boost.available)
+        boost.ticksPerSample = 0.0f;
+    boost.wanted = enabled;
+    boost.comfortableSeconds = 0.0f;
+    LightLock_Unlock(&boost.lock);
+
+    if (enabled)
+        boost.boosts++;
+    log_event(&event);
+}
+
+// === BOOST API ===
+
+void boostInit(void) {
+    memset(&boost, 0, sizeof(boost));
+    LightLock_Init(&boost.lock);
+    boost.track = -1;
+    boost.fill = 1.0f;
+
+    bool isNew3DS = false;
+    APT_CheckNew3DS(&isNew3DS);
+    boost.available = isNew3DS;
+    if (boost.available)
+        osSetSpeedupEnable(false);
+}
+
+void boostExit(void) {
+    if (boost_applied())
+        osSetSpeedupEnable(false);
+    boost.wanted = false;
+}
+
+void boostTrackStart(int track) {
+    LightLock_Lock(&boost.lock);
+    BoostEvent summary = {
+        .type = BOOST_EVENT_TRACK_SUMMARY,
+        .track = boost.track,
+        .boosts = boost.boosts,
+        .boostedSeconds = boost.boostedSeconds,
+        .playedSeconds = boost.playedSeconds,
+    };
+    boost.track = track;
+    boost.boosts = 0;
+    boost.boostedSeconds = 0.0f;
+    boost.playedSeconds = 0.0f;
+    LightLock_Unlock(&boost.lock);
+
+    if (summary.track >= 0)
+        log_event(&summary);
+}
+
+void boostReport(u64 decodeTicks, u32 samples, u32 rate, int queued, int capacity) {
+    if (samples == 0 || rate == 0 || capacity <= 0)
+        return;
+
+    LightLock_Lock(&boost.lock);
+    float cost = (float)decodeTicks / samples;
+    // The buffer that just finished can't be queued, so a full queue is capacity-1
+    float fill = capacity > 1 ? (float)queued / (capacity - 1) : (float)queued;
+    if (fill > 1.0f)
+        fill = 1.0f;
+    boost.ticksPerSample = boost.ticksPerSample > 0.0f
+        ? boost.ticksPerSample + BOOST_SMOOTHING * (cost - boost.ticksPerSample)
+        : cost;
+    boost.fill += BOOST_SMOOTHING * (fill - boost.fill);
+    boost.rate = rate;
+    boost.lastReport = svcGetSystemTick();
+
+    float seconds = (float)samples / rate;
+    boost.playedSeconds += seconds;
+    if (boost_applied())
+        boost.boostedSeconds += seconds;
+
+    if (unboosted_realtime() >= BOOST_DISABLE_REALTIME && boost.fill >= BOOST_DISABLE_FILL)
+        boost.comfortableSeconds += seconds;
+    else
+        boost.comfortableSeconds = 0.0f;
+    LightLock_Unlock(&boost.lock);
+}
+
+void boostUpdate(void) {
+    LightLock_Lock(&boost.lock);
+    float realtime = unboosted_realtime();
+    float fill = boost.fill;
+    bool comfortable = boost.comfortableSeconds >= BOOST_HOLD_SECONDS;
+    bool idle = svcGetSystemTick() - boost.lastReport > BOOST_IDLE_TICKS;
+    bool measured = realtime > 0.0f;
+    LightLock_Unlock(&boost.lock);
+
+    if (!boost.wanted && !idle && measured && (realtime < BOOST_ENABLE_REALTIME || fill < BOOST_ENABLE_FILL))
+        set_boost(true);
+    else if (boost.wanted && (comfortable || idle))
+        set_boost(false);
+}
+
+bool boostIsEnabled(void) {
+    return boost_applied();
+}
+
+bool boostPollEvent(BoostEvent* event) {
+    if (boost.logCount == 0)
+        return false;
+    *event = boost.log[boost.logHead];
+    boost.logHead = (boost.logHead + 1) % BOOST_LOG_LENGTH;
+    boost.logCount--;
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef BOOST_H
+#define BOOST_H
+
+#include <3ds.h>
+
+/* Dynamic New 3DS clock boost
+The decode path reports how long each batch of wave buffers took and how
+full the DSP queue was. boostUpdate, on the main thread, turns the 804 MHz
+mode on as soon as decoding falls behind and off again only after it has
+run comfortably ahead for BOOST_HOLD_SECONDS of audio, so the clock doesn't
+flap. Thresholds are in unboosted terms: speed measured while boosted is
+divided by BOOST_SPEEDUP before comparing. Queue fill counts against the
+buffers that can be queued when the DSP asks for more: one has just
+finished, so n-1 of n queued reads as full however long the queue is. On
+Old 3DS nothing is switched, but the log still shows when boost would have
+been wanted, with speeds measured at the one clock there is.
+*/
+
+#define BOOST_ENABLE_REALTIME  1.25f // decode speed (x realtime) below which boost turns on
+#define BOOST_DISABLE_REALTIME 2.0f  // speed the normal clock must manage before it turns off
+#define BOOST_ENABLE_FILL      0.6f  // fraction of the other wave buffers still queued when the DSP asks for more
+#define BOOST_DISABLE_FILL     0.9f
+#define BOOST_HOLD_SECONDS     3.0f
+#define BOOST_SPEEDUP          3.0f  // 804 vs 268 MHz; the extra L2 cache is left as margin
+#define BOOST_LOG_LENGTH       32
+
+typedef enum {
+    BOOST_EVENT_ON,
+    BOOST_EVENT_OFF,
+    BOOST_EVENT_TRACK_SUMMARY,  // emitted when the next track starts
+} BoostEventType;
+
+typedef struct {
+    BoostEventType type;
+    int track;
+    float realtime;        // smoothed decode speed when boost switched
+    float fill;
+    u32 boosts;            // summary: times boost turned on (on Old 3DS, was wanted) during the track
+    float boostedSeconds;  // summary: audio decoded at the boosted clock, always 0 on Old 3DS
+    float playedSeconds;   // audio decoded from the track so far (at the switch, or in total)
+} BoostEvent;
+
+void boostInit(void);
+void boostExit(void);
+
+// Starts per-track accounting and logs a summary of the previous track
+void boostTrackStart(int track);
+
+// From the decode path: ticks spent decoding `samples` frames at `rate`, and queue state before refilling
+void boostReport(u64 decodeTicks, u32 samples, u32 rate, int queued, int capacity);
+
+// Applies the controller's decision; call regularly from the main thread
+void boostUpdate(void);
+
+// True while the clock is boosted, never on Old 3DS
+bool boostIsEnabled(void);
+
+// Pops the oldest logged event; false when the log is empty
+bool boostPollEvent(BoostEvent* event);
+
+#endif // BOOST_H
@@ -0,0 +1,387 @@
+#include "cache.h"
+#include "stats.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CACHE_ENTRY_MAGIC  0x45434D58u  // "XMCE"
+#define CACHE_INDEX_MAGIC  0x49434D58u  // "XMCI"
+#define CACHE_LAYOUT       1            // bump when CacheEntryHeader or CacheRecord change
+#define CACHE_SAMPLE_BYTES (64 * 1024)
+#define CACHE_PATH_MAX     160
+
+typedef struct {
+    u32 magic;
+    u16 kind;
+    u16 version;
+    u64 hash;
+    u32 sourceSize;
+    u32 payloadSize;
+} CacheEntryHeader;
+
+typedef struct {
+    u64 hash;
+    u32 sourceSize;
+    u32 bytes;    // whole file, header included
+    u32 lastUse;
+    u16 kind;
+    u16 version;
+} CacheRecord;
+
+typedef struct {
+    u32 magic;
+    u32 layout;
+    u32 count;
+    u32 clock;
+} CacheIndexHeader;
+
+static struct {
+    char dir[CACHE_PATH_MAX - 40];
+    u32 budget;
+    u32 used;
+    u32 clock;
+    CacheRecord* records;
+    u32 count;
+    u32 capacity;
+    bool dirty;
+    bool ready;
+    LightLock lock;
+} cache;
+
+// === HELPERS ===
+
+static u64 fnv1a(u64 hash, const u8* data, u32 size) {
+    for (u32 i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static void entry_path(char* out, u16 kind, u64 hash, u32 sourceSize) {
+    snprintf(out, CACHE_PATH_MAX, "%s/%u-%016llx-%08lx.bin", cache.dir, kind,
+        (unsigned long long)hash, (unsigned long)sourceSize);
+}
+
+static void index_path(char* out, const char* suffix) {
+    snprintf(out, CACHE_PATH_MAX, "%s/index.bin%s", cache.dir, suffix);
+}
+
+// mkdir -p; sdmc:/ itself always exists
+static void make_dirs(const char* path) {
+    char partial[CACHE_PATH_MAX];
+    for (const char* p = strchr(path, '/'); p; p = strchr(p + 1, '/')) {
+        if (p == path || p[-1] == ':')
+            continue;
+        snprintf(partial, sizeof(partial), "%.*s", (int)(p - path), path);
+        mkdir(partial, 0777);
+    }
+    mkdir(path, 0777);
+}
+
+// Write to path.tmp then swap it in. FAT can't rename over an existing file, hence the remove.
+static bool write_atomic(const char* path, const void* head, u32 headSize, const void* body, u32 bodySize) {
+    char tmp[CACHE_PATH_MAX + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE* file = fopen(tmp, "wb");
+    if (!file)
+        return false;
+
+    bool ok = fwrite(head, 1, headSize, file) == headSize &&
+              (bodySize == 0 || fwrite(body, 1, bodySize, file) == bodySize);
+    ok = (fclose(file) == 0) && ok;
+    if (ok) {
+        remove(path);
+        ok = rename(tmp, path) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+    return ok;
+}
+
+static int find_record(u16 kind, CacheKey key) {
+    for (u32 i = 0; i < cache.count; ++i) {
+        const CacheRecord* record = &cache.records[i];
+        if (record->kind == kind && record->hash == key.hash && record->sourceSize == key.size)
+            return i;
+    }
+    return -1;
+}
+
+static bool add_record(const CacheRecord* record) {
+    if (cache.count == cache.capacity) {
+        u32 capacity = cache.capacity ? cache.capacity * 2 : 64;
+        CacheRecord* records = (CacheRecord*)realloc(cache.records, capacity * sizeof(CacheRecord));
+        if (!records)
+            return false; // Old table is untouched; the caller skips caching this entry
+        statsMemory(STATS_MEMORY_CACHE, (capacity - cache.capacity) * sizeof(CacheRecord));
+        cache.records = records;
+        cache.capacity = capacity;
+    }
+    cache.records[cache.count++] = *record;
+    cache.used += record->bytes;
+    cache.dirty = true;
+    return true;
+}
+
+static void drop_record(int index) {
+    CacheRecord* record = &cache.records[index];
+    char path[CACHE_PATH_MAX];
+    entry_path(path, record->kind, record->hash, record->sourceSize);
+    remove(path);
+
+    cache.used -= record->bytes;
+    cache.records[index] = cache.records[--cache.count];
+    cache.dirty = true;
+}
+
+static void evict_until(u32 needed) {
+    while (cache.count > 0 && cache.used + needed > cache.budget) {
+        int oldest = 0;
+        for (u32 i = 1; i < cache.count; ++i) {
+            if (cache.records[i].lastUse < cache.records[oldest].lastUse)
+                oldest = i;
+        }
+        drop_record(oldest);
+    }
+}
+
+static void save_index(void) {
+    if (!cache.dirty)
+        return;
+
+    CacheIndexHeader header = { CACHE_INDEX_MAGIC, CACHE_LAYOUT, cache.count, cache.clock };
+    char path[CACHE_PATH_MAX];
+    index_path(path, "");
+    if (write_atomic(path, &header, sizeof(header), cache.records, cache.count * sizeof(CacheRecord)))
+        cache.dirty = false;
+}
+
+static bool load_index(void) {
+    char path[CACHE_PATH_MAX];
+    index_path(path, "");
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    CacheIndexHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == CACHE_INDEX_MAGIC && header.layout == CACHE_LAYOUT;
+    if (ok) {
+        cache.capacity = header.count > 0 ? header.count : 64;
+        cache.records = (CacheRecord*)malloc(cache.capacity * sizeof(CacheRecord));
+        statsMemory(STATS_MEMORY_CACHE, cache.capacity * sizeof(CacheRecord));
+        ok = cache.records && fread(cache.records, sizeof(CacheRecord), header.count, file) == header.count;
+    }
+    fclose(file);
+
+    if (!ok) {
+        free(cache.records);
+        cache.records = NULL;
+        cache.capacity = 0;
+        return false;
+    }
+
+    cache.count = header.count;
+    cache.clock = header.clock;
+    for (u32 i = 0; i < cache.count; ++i)
+        cache.used += cache.records[i].bytes;
+    return true;
+}
+
+/* Rebuilds the index from the entry files themselves
+Used when index.bin is missing or from an older layout. Recency is lost,
+so every entry starts out equally old. Leftover .tmp files from an
+interrupted write are removed on the way.
+*/
+static void rebuild_index(void) {
+    DIR* dir = opendir(cache.dir);
+    if (!dir)
+        return;
+
+    char path[CACHE_PATH_MAX + 256];
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        snprintf(path, sizeof(path), "%s/%s", cache.dir, entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".tmp") == 0) {
+            remove(path);
+            continue;
+        }
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".bin") != 0 || strncmp(entry->d_name, "index", 5) == 0)
+            continue;
+
+        FILE* file = fopen(path, "rb");
+        if (!file)
+            continue;
+        CacheEntryHeader header;
+        bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+                  header.magic == CACHE_ENTRY_MAGIC && header.kind < CACHE_KIND_COUNT;
+        fclose(file);
+
+        if (!ok) {
+            remove(path);
+            continue;
+        }
+
+        CacheRecord record = {
+            .hash = header.hash,
+            .sourceSize = header.sourceSize,
+            .bytes = sizeof(header) + header.payloadSize,
+            .lastUse = 0,
+            .kind = header.kind,
+            .version = header.version
+        };
+        if (!add_record(&record))
+            remove(path); // Untracked entries would never be evicted
+    }
+    closedir(dir);
+}
+
+// === CACHE API ===
+
+bool cacheInit(const char* dir, u32 budget) {
+    if (cache.ready)
+        return true;
+
+    memset(&cache, 0, sizeof(cache));
+    LightLock_Init(&cache.lock);
+    snprintf(cache.dir, sizeof(cache.dir), "%s", dir);
+    cache.budget = budget;
+
+    make_dirs(cache.dir);
+    if (!load_index()) {
+        rebuild_index();
+        cache.dirty = true;
+    }
+
+    // A smaller budget than last session takes effect straight away
+    evict_until(0);
+    save_index();
+    cache.ready = true;
+    return true;
+}
+
+void cacheExit(void) {
+    if (!cache.ready)
+        return;
+
+    LightLock_Lock(&cache.lock);
+    save_index();
+    free(cache.records);
+    cache.records = NULL;
+    cache.count = cache.capacity = 0;
+    cache.ready = false;
+    LightLock_Unlock(&cache.lock);
+}
+
+CacheKey cacheKeyForMemory(const void* data, u32 size) {
+    const u8* bytes = (const u8*)data;
+    u64 hash = 0xCBF29CE484222325ull;
+    if (size <= 2 * CACHE_SAMPLE_BYTES) {
+        hash = fnv1a(hash, bytes, size);
+    } else {
+        hash = fnv1a(hash, bytes, CACHE_SAMPLE_BYTES);
+        hash = fnv1a(hash, bytes + size - CACHE_SAMPLE_BYTES, CACHE_SAMPLE_BYTES);
+    }
+    return (CacheKey){ hash, size };
+}
+
+void* cacheLoad(CacheKind kind, u16 version, CacheKey key, u32* size) {
+    if (!cache.ready)
+        return NULL;
+
+    LightLock_Lock(&cache.lock);
+    int index = find_record(kind, key);
+    if (index < 0) {
+        LightLock_Unlock(&cache.lock);
+        return NULL;
+    }
+    if (cache.records[index].version != version) {
+        drop_record(index);
+        LightLock_Unlock(&cache.lock);
+        return NULL;
+    }
+
+    char path[CACHE_PATH_MAX];
+    entry_path(path, kind, key.hash, key.size);
+    FILE* file = fopen(path, "rb");
+
+    CacheEntryHeader header;
+    void* data = NULL;
+    bool ok = file && fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == CACHE_ENTRY_MAGIC && header.kind == kind && header.version == version &&
+              header.hash == key.hash && header.sourceSize == key.size &&
+              sizeof(header) + header.payloadSize == cache.records[index].bytes;
+    if (ok) {
+        data = malloc(header.payloadSize ? header.payloadSize : 1);
+        ok = data && fread(data, 1, header.payloadSize, file) == header.payloadSize;
+    }
+    if (file)
+        fclose(file);
+
+    if (!ok) {
+        free(data);
+        data = NULL;
+        drop_record(index);
+    } else {
+        cache.records[index].lastUse = ++cache.clock;
+        cache.dirty = true;
+        *size = header.payloadSize;
+    }
+    LightLock_Unlock(&cache.lock);
+    return data;
+}
+
+bool cacheStore(CacheKind kind, u16 version, CacheKey key, const void* data, u32 size) {
+    if (!cache.ready || sizeof(CacheEntryHeader) + size > cache.budget)
+        return false;
+
+    LightLock_Lock(&cache.lock);
+    int existing = find_record(kind, key);
+    if (existing >= 0)
+        drop_record(existing);
+
+    CacheRecord record = {
+        .hash = key.hash,
+        .sourceSize = key.size,
+        .bytes = sizeof(CacheEntryHeader) + size,
+        .lastUse = ++cache.clock,
+        .kind = kind,
+        .version = version
+    };
+    evict_until(record.bytes);
+
+    CacheEntryHeader header = { CACHE_ENTRY_MAGIC, kind, version, key.hash, key.size, size };
+    char path[CACHE_PATH_MAX];
+    entry_path(path, kind, key.hash, key.size);
+    bool ok = write_atomic(path, &header, sizeof(header), data, size);
+    if (ok && !add_record(&record)) {
+        remove(path);
+        ok = false;
+    }
+    save_index();
+    LightLock_Unlock(&cache.lock);
+    return ok;
+}
+
+void cacheRemove(CacheKind kind, CacheKey key) {
+    if (!cache.ready)
+        return;
+
+    LightLock_Lock(&cache.lock);
+    int index = find_record(kind, key);
+    if (index >= 0) {
+        drop_record(index);
+        save_index();
+    }
+    LightLock_Unlock(&cache.lock);
+}
+
+u32 cacheUsedBytes(void) {
+    return cache.used;
+}
@@ -0,0 +1,47 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <3ds.h>
+
+/* On-disk cache shared by everything derived from track content
+(seek indexes, waveforms, header caches, transcoded audio, album art).
+
+Entries are keyed by a content hash plus the source's size, so renaming or
+moving a file keeps its cache and editing it invalidates it. Each entry file
+carries the kind and the caller's format version; a mismatch is treated as a
+miss and the stale file is deleted. The whole cache stays under one byte
+budget, evicting least recently used entries first. Writes go to a temporary
+file that is renamed into place, so a crash never leaves a torn entry.
+*/
+
+#define CACHE_DIR            "sdmc:/3ds/3dXMMP/cache"
+#define CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+typedef enum {
+    CACHE_KIND_SEEK = 0,
+    CACHE_KIND_WAVEFORM,
+    CACHE_KIND_HEADERS,
+    CACHE_KIND_PCM,
+    CACHE_KIND_ART,
+    CACHE_KIND_COUNT
+} CacheKind;
+
+typedef struct {
+    u64 hash;
+    u32 size;
+} CacheKey;
+
+bool cacheInit(const char* dir, u32 budget);
+void cacheExit(void);
+
+// Key from the first and last 64 KiB plus the size; hashing whole tracks on the ARM11 would cost more than the cache saves
+CacheKey cacheKeyForMemory(const void* data, u32 size);
+
+// Returns a malloc'd copy of the entry and marks it recently used, or NULL on a miss
+void* cacheLoad(CacheKind kind, u16 version, CacheKey key, u32* size);
+bool cacheStore(CacheKind kind, u16 version, CacheKey key, const void* data, u32 size);
+void cacheRemove(CacheKind kind, CacheKey key);
+
+u32 cacheUsedBytes(void);
+
+#endif // CACHE_H
@@ -0,0 +1,116 @@
+#include "collate.h"
+#include "search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define COLLATE_SPACE     0x01
+#define COLLATE_NUMBER    0x10  // plus the digit count, then the digits
+#define COLLATE_EMPTY     0xFF
+
+static const char* const articles[] = { "the ", "a ", "an " };
+
+static const int orderFields[PACK_SORT_COUNT][3] = {
+    [PACK_SORT_TITLE]  = { COLLATE_FIELD_TITLE, COLLATE_FIELD_ARTIST, COLLATE_FIELD_ALBUM },
+    [PACK_SORT_ARTIST] = { COLLATE_FIELD_ARTIST, COLLATE_FIELD_ALBUM, COLLATE_FIELD_TITLE },
+    [PACK_SORT_ALBUM]  = { COLLATE_FIELD_ALBUM, COLLATE_FIELD_ARTIST, COLLATE_FIELD_TITLE },
+};
+
+u32 collateKey(const char* text, u8* key, u32 size) {
+    char folded[256];
+    u32 length = searchFold(text, folded, sizeof(folded));
+    if (length == 0) {
+        if (size > 0)
+            key[0] = COLLATE_EMPTY;
+        return size > 0;
+    }
+
+    const char* p = folded;
+    for (u32 i = 0; i < sizeof(articles) / sizeof(articles[0]); ++i) {
+        u32 articleLength = strlen(articles[i]);
+        if (length > articleLength && strncmp(p, articles[i], articleLength) == 0) {
+            p += articleLength;
+            break;
+        }
+    }
+
+    u32 written = 0;
+    while (*p && written < size) {
+        if (*p >= '0' && *p <= '9') {
+            // Leading zeros don't count, so "07" and "7" are the same number
+            while (*p == '0' && p[1] >= '0' && p[1] <= '9')
+                p++;
+            u32 digits = 0;
+            while (p[digits] >= '0' && p[digits] <= '9')
+                digits++;
+            if (digits > COLLATE_EMPTY - COLLATE_NUMBER - 1)
+                digits = COLLATE_EMPTY - COLLATE_NUMBER - 1;
+
+            key[written++] = COLLATE_NUMBER + digits;
+            for (u32 i = 0; i < digits && written < size; ++i)
+                key[written++] = *p++;
+            while (*p >= '0' && *p <= '9')
+                p++;
+        } else {
+            key[written++] = *p == ' ' ? COLLATE_SPACE : (u8)*p;
+            p++;
+        }
+    }
+    return written;
+}
+
+typedef struct {
+    const u8* keys;
+    u32 index;
+} SortEntry;
+
+static int compare_entries(const void* a, const void* b) {
+    const SortEntry* x = (const SortEntry*)a;
+    const SortEntry* y = (const SortEntry*)b;
+    int result = memcmp(x->keys, y->keys, COLLATE_KEY_SIZE);
+    if (result != 0)
+        return result;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+bool collateSort(u32 count, const int* fields, int fieldCount, CollateFieldFunc get, void* user, u32* order, u32* rank) {
+    u8* keys = (u8*)calloc(count ? count : 1, COLLATE_KEY_SIZE);
+    SortEntry* entries = (SortEntry*)malloc((count ? count : 1) * sizeof(SortEntry));
+    if (!keys || !entries) {
+        free(keys);
+        free(entries);
+        return false;
+    }
+
+    for (u32 track = 0; track < count; ++track) {
+        u8* key = keys + track * COLLATE_KEY_SIZE;
+        u32 length = 0;
+        for (int f = 0; f < fieldCount && length < COLLATE_KEY_SIZE; ++f) {
+            if (f > 0)
+                key[length++] = 0;  // zero padding is already there; this just skips past it
+            length += collateKey(get(track, fields[f], user), key + length, COLLATE_KEY_SIZE - length);
+        }
+        entries[track].keys = key;
+        entries[track].index = track;
+    }
+
+    qsort(entries, count, sizeof(SortEntry), compare_entries);
+    for (u32 i = 0; i < count; ++i) {
+        if (order)
+            order[i] = entries[i].index;
+        if (rank)
+            rank[entries[i].index] = i;
+    }
+
+    free(entries);
+    free(keys);
+    return true;
+}
+
+bool collateBuildOrders(u32 count, CollateFieldFunc get, void* user, u32* orders, u32* ranks) {
+    for (int sort = 0; sort < PACK_SORT_COUNT; ++sort) {
+        if (!collateSort(count, orderFields[sort], 3, get, user, orders + sort * count, ranks + sort * count))
+            return false;
+    }
+    return true;
+}
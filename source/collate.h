@@ -0,0 +1,40 @@
+#ifndef COLLATE_H
+#define COLLATE_H
+
+#include <3ds.h>
+#include "pack.h"
+
+/* Sort keys for tags
+A key is built from the search fold (no case, no accents, punctuation as
+spaces) with a leading "the", "a" or "an" dropped and runs of digits encoded
+length first, so "Track 2" sorts before "Track 10". Keys of several fields
+are joined with a zero byte and compared with memcmp, and an empty field
+sorts after every other value.
+*/
+
+#define COLLATE_KEY_SIZE 64  // bytes per track; fields beyond it only break ties by library order
+
+// Fields handed to a CollateFieldFunc
+enum {
+    COLLATE_FIELD_TITLE,
+    COLLATE_FIELD_ARTIST,
+    COLLATE_FIELD_ALBUM
+};
+
+// Returns the field's tag for a track, or "" if it has none
+typedef const char* (*CollateFieldFunc)(u32 track, int field, void* user);
+
+// Writes the key of one field into `key` (at most `size` bytes, not terminated); returns its length
+u32 collateKey(const char* text, u8* key, u32 size);
+
+/* Sorts `count` tracks by `fields` in priority order
+Fills order[] with track indices in sorted order and rank[] with each
+track's position in it (either may be NULL). Equal keys keep library order.
+Returns false if the keys couldn't be allocated.
+*/
+bool collateSort(u32 count, const int* fields, int fieldCount, CollateFieldFunc get, void* user, u32* order, u32* rank);
+
+// Every PackSort ordering, laid out as in PACK_SECTION_SORT
+bool collateBuildOrders(u32 count, CollateFieldFunc get, void* user, u32* orders, u32* ranks);
+
+#endif // COLLATE_H
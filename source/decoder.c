@@ -0,0 +1,279 @@
+#include "decoder.h"
+#include "trace.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static DecoderIoHook io_hook = NULL;
+static void* io_hook_user = NULL;
+
+// === OGG CALLBACKS ===
+
+static size_t stream_read_func(void *ptr, size_t size, size_t nmemb, void *datasource) {
+    DecoderStream* stream = (DecoderStream*)datasource;
+    size_t bytes_to_read = size * nmemb;
+    if (io_hook)
+        io_hook(false, (u32)bytes_to_read, io_hook_user);
+
+    if (stream->offset + bytes_to_read > stream->size)
+        bytes_to_read = stream->size - stream->offset;
+
+    if (stream->data) {
+        memcpy(ptr, stream->data + stream->offset, bytes_to_read);
+    } else {
+        u32 position = stream->base + stream->offset;
+        if (position != stream->filePosition && fseek(stream->file, position, SEEK_SET) != 0) {
+            stream->filePosition = (u32)-1;
+            return 0;
+        }
+        bytes_to_read = fread(ptr, 1, bytes_to_read, stream->file);
+        stream->filePosition = position + bytes_to_read;
+    }
+    stream->offset += bytes_to_read;
+
+    return bytes_to_read / size;
+}
+
+static int stream_seek_func(void *datasource, ogg_int64_t offset, int whence) {
+    DecoderStream* stream = (DecoderStream*)datasource;
+    if (io_hook)
+        io_hook(true, 0, io_hook_user);
+
+    switch (whence) {
+        case SEEK_SET:
+            if (offset < 0 || offset > stream->size) return -1;
+            stream->offset = offset;
+            break;
+        case SEEK_CUR:
+            if (offset < -(ogg_int64_t)stream->offset || stream->offset + offset > stream->size) return -1;
+            stream->offset += offset;
+            break;
+        case SEEK_END:
+            if (offset > 0 || -offset > stream->size) return -1;
+            stream->offset = stream->size + offset;
+            break;
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+static int stream_close_func(void *datasource) {
+    return 0;
+}
+
+static long stream_tell_func(void *datasource) {
+    DecoderStream* stream = (DecoderStream*)datasource;
+    return (long)stream->offset;
+}
+
+// === WAV ===
+
+static u16 read_le16(const u8* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static u32 read_le32(const u8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static bool stream_read_exact(DecoderStream* stream, void* out, u32 bytes) {
+    return stream_read_func(out, 1, bytes, stream) == bytes;
+}
+
+/* Walks the chunks after the RIFF header up to "data"
+Only 16-bit PCM in one or two channels is accepted, plain or as
+WAVE_FORMAT_EXTENSIBLE: that is what the DSP plays without conversion.
+A data chunk that claims more than the stream holds (a truncated file, or
+a size left at 0xFFFFFFFF by a recorder) is cut to what is there.
+*/
+static bool wav_open(Decoder* decoder) {
+    DecoderStream* stream = &decoder->stream;
+    bool haveFormat = false;
+    for (;;) {
+        u8 chunk[8];
+        if (!stream_read_exact(stream, chunk, sizeof(chunk)))
+            return false;
+        u32 size = read_le32(chunk + 4);
+        u32 start = stream->offset;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            u8 format[26];
+            u32 length = size < sizeof(format) ? size : sizeof(format);
+            if (size < 16 || !stream_read_exact(stream, format, length))
+                return false;
+            u16 tag = read_le16(format);
+            if (tag == 0xFFFE && length >= 26)
+                tag = read_le16(format + 24);  // the sub-format GUID starts with the plain format tag
+            decoder->channels = read_le16(format + 2);
+            decoder->rate = read_le32(format + 4);
+            if (tag != 1 || read_le16(format + 14) != 16 || decoder->channels < 1 || decoder->channels > 2 ||
+                decoder->rate == 0)
+                return false;
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat)
+                return false;
+            u32 frameBytes = decoder->channels * sizeof(s16);
+            u32 available = stream->size - start;
+            decoder->pcmOffset = start;
+            decoder->pcmSize = (size < available ? size : available) / frameBytes * frameBytes;
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        if (stream_seek_func(stream, (ogg_int64_t)start + size + (size & 1), SEEK_SET) != 0)
+            return false;
+    }
+}
+
+/* Reads PCM from the stream into `out` without going through stdio
+Pack files get a large stdio buffer for Vorbis's small reads; sample data
+would only be copied through it, so it is read from the descriptor instead.
+The descriptor's position is put back afterwards, since stdio assumes it
+is where its own buffer left it.
+*/
+static u32 stream_read_direct(DecoderStream* stream, void* out, u32 bytes) {
+    if (io_hook)
+        io_hook(false, bytes, io_hook_user);
+
+    if (bytes > stream->size - stream->offset)
+        bytes = stream->size - stream->offset;
+    if (stream->data) {
+        memcpy(out, stream->data + stream->offset, bytes);
+    } else {
+        int fd = fileno(stream->file);
+        off_t saved = lseek(fd, 0, SEEK_CUR);
+        if (saved < 0 || lseek(fd, stream->base + stream->offset, SEEK_SET) < 0)
+            return 0;
+        ssize_t got = read(fd, out, bytes);
+        lseek(fd, saved, SEEK_SET);
+        bytes = got > 0 ? (u32)got : 0;
+    }
+    stream->offset += bytes;
+    return bytes;
+}
+
+static long pcm_read(Decoder* decoder, s16* out, long bytes) {
+    TRACE_SCOPE("pcm read");
+    DecoderStream* stream = &decoder->stream;
+    u32 frameBytes = decoder->channels * sizeof(s16);
+    u32 dspBytes = DECODER_DSP_FRAME * frameBytes;
+    u32 remaining = decoder->pcmOffset + decoder->pcmSize - stream->offset;
+    u32 want = (u32)bytes < remaining ? (u32)bytes : remaining;
+    want -= want % (want >= dspBytes ? dspBytes : frameBytes);
+    if (want == 0)
+        return 0;
+
+    u32 got = stream_read_direct(stream, out, want);
+    if (got == 0)
+        return -1;
+    // A short read keeps the stream on a frame boundary for the next one
+    stream->offset -= got % frameBytes;
+    return got - got % frameBytes;
+}
+
+// === DECODER ===
+
+static bool decoder_open(Decoder* decoder) {
+    ov_callbacks callbacks = {
+        .read_func = stream_read_func,
+        .seek_func = stream_seek_func,
+        .close_func = stream_close_func,
+        .tell_func = stream_tell_func
+    };
+
+    decoder->open = false;
+    u8 riff[12];
+    if (stream_read_exact(&decoder->stream, riff, sizeof(riff)) && memcmp(riff, "RIFF", 4) == 0 &&
+        memcmp(riff + 8, "WAVE", 4) == 0) {
+        if (!wav_open(decoder) || stream_seek_func(&decoder->stream, decoder->pcmOffset, SEEK_SET) != 0)
+            return false;
+        decoder->format = DECODER_PCM;
+        decoder->open = true;
+        return true;
+    }
+
+    decoder->stream.offset = 0;
+    decoder->format = DECODER_VORBIS;
+    if (ov_open_callbacks(&decoder->stream, &decoder->vf, NULL, 0, callbacks) < 0)
+        return false;
+
+    vorbis_info* info = ov_info(&decoder->vf, -1);
+    decoder->channels = info->channels;
+    decoder->rate = info->rate;
+    decoder->open = true;
+    return true;
+}
+
+bool decoderOpenMemory(Decoder* decoder, const unsigned char* data, u32 size) {
+    memset(&decoder->stream, 0, sizeof(DecoderStream));
+    decoder->stream.data = data;
+    decoder->stream.size = size;
+    return decoder_open(decoder);
+}
+
+bool decoderOpenFile(Decoder* decoder, FILE* file, u32 base, u32 size) {
+    memset(&decoder->stream, 0, sizeof(DecoderStream));
+    decoder->stream.file = file;
+    decoder->stream.base = base;
+    decoder->stream.size = size;
+    decoder->stream.filePosition = (u32)-1;
+    return decoder_open(decoder);
+}
+
+void decoderClose(Decoder* decoder) {
+    if (decoder->open && decoder->format == DECODER_VORBIS)
+        ov_clear(&decoder->vf);
+    decoder->open = false;
+}
+
+long decoderRead(Decoder* decoder, s16* out, long bytes) {
+    if (decoder->format == DECODER_PCM)
+        return pcm_read(decoder, out, bytes);
+
+    TRACE_SCOPE("ov_read");
+    int bitstream = 0;
+    return ov_read(&decoder->vf, (char*)out, bytes, &bitstream);
+}
+
+bool decoderSeek(Decoder* decoder, ogg_int64_t sample, const PackSeekPoint* point, s16* scratch, long scratchBytes) {
+    TRACE_SCOPE("seek");
+    if (decoder->format == DECODER_PCM) {
+        u64 offset = (u64)sample * decoder->channels * sizeof(s16);
+        return sample >= 0 && offset <= decoder->pcmSize &&
+               stream_seek_func(&decoder->stream, decoder->pcmOffset + offset, SEEK_SET) == 0;
+    }
+
+    if (!point || ov_raw_seek(&decoder->vf, point->offset) != 0)
+        return ov_pcm_seek(&decoder->vf, sample) == 0;
+
+    // Discard up to the target sample, never reading past it
+    long frameBytes = decoder->channels * sizeof(s16);
+    ogg_int64_t remaining = sample - ov_pcm_tell(&decoder->vf);
+    while (remaining > 0) {
+        long want = scratchBytes;
+        if (remaining * frameBytes < want)
+            want = (long)(remaining * frameBytes);
+
+        long bytesRead = decoderRead(decoder, scratch, want);
+        if (bytesRead <= 0)
+            return false;
+        remaining -= bytesRead / frameBytes;
+    }
+    return true;
+}
+
+ogg_int64_t decoderTotalSamples(Decoder* decoder) {
+    if (decoder->format == DECODER_PCM)
+        return decoder->pcmSize / (decoder->channels * sizeof(s16));
+
+    ogg_int64_t total = ov_pcm_total(&decoder->vf, -1);
+    return total > 0 ? total : 0;
+}
+
+void decoderSetIoHook(DecoderIoHook hook, void* user) {
+    io_hook = hook;
+    io_hook_user = user;
+}
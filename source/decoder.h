@@ -0,0 +1,72 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <3ds.h>
+#include <stdio.h>
+#include "pack.h"
+#include "tremor/ivorbisfile.h"
+
+/* Ogg Vorbis decoding shared by the player and the host tools
+Keeping one copy of the stream callbacks and seek logic means what the
+host tools measure is exactly what the 3DS decodes.
+
+RIFF/WAVE files with 16-bit PCM go through the same calls without being
+decoded at all: reads take sample data from the file straight into the
+caller's buffer (for the player, the wave buffer the DSP reads), around
+stdio's buffer, and seeks are a multiplication.
+*/
+
+#define DECODER_DSP_FRAME 160  // sample frames NDSP mixes per audio frame; PCM reads come in multiples of it
+
+typedef enum {
+    DECODER_VORBIS,
+    DECODER_PCM,
+} DecoderFormat;
+
+typedef struct {
+    const unsigned char* data;  // in-memory stream, NULL when reading a region of `file`
+    FILE* file;
+    u32 base;                   // file offset of the stream
+    u32 size;
+    u32 offset;
+    u32 filePosition;           // where file's cursor is, to skip redundant fseeks
+} DecoderStream;
+
+typedef struct {
+    OggVorbis_File vf;          // DECODER_VORBIS only
+    DecoderStream stream;
+    DecoderFormat format;
+    u32 pcmOffset;              // DECODER_PCM: stream offset of the first sample frame
+    u32 pcmSize;                // DECODER_PCM: bytes of whole sample frames
+    int channels;
+    long rate;
+    bool open;
+} Decoder;
+
+bool decoderOpenMemory(Decoder* decoder, const unsigned char* data, u32 size);
+bool decoderOpenFile(Decoder* decoder, FILE* file, u32 base, u32 size);
+void decoderClose(Decoder* decoder);
+
+// Decodes up to `bytes` of interleaved s16; returns bytes written, 0 at the end, <0 on error
+// PCM is read whole DSP frames at a time whenever `bytes` holds at least one
+long decoderRead(Decoder* decoder, s16* out, long bytes);
+
+/* Seeks to an exact sample
+With a seek table point the stream jumps straight to that page and decodes forward
+into `scratch`; without one it falls back to Tremor's bisecting ov_pcm_seek.
+PCM needs neither: the target's byte offset is computed and the stream moves there.
+*/
+bool decoderSeek(Decoder* decoder, ogg_int64_t sample, const PackSeekPoint* point, s16* scratch, long scratchBytes);
+
+// Total length in samples, or 0 if unknown
+ogg_int64_t decoderTotalSamples(Decoder* decoder);
+
+/* I/O observer
+Called before every read and seek the stream callbacks serve, on whichever
+thread is decoding. The host fault harness uses it to stall reads; with no
+hook set (the default) it costs one branch per call.
+*/
+typedef void (*DecoderIoHook)(bool seek, u32 bytes, void* user);
+void decoderSetIoHook(DecoderIoHook hook, void* user);
+
+#endif // DECODER_H
@@ -0,0 +1,357 @@
+#include "effects.h"
+#include "boost.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef __ARM_FEATURE_SIMD32
+#include <arm_acle.h>
+#endif
+
+/* === FIXED-POINT HELPERS ===
+Stereo frames are loaded as one word, left in the low half. On the 3DS the
+pair helpers are single ARMv6 SIMD instructions; the C versions beside them
+do the same per half for host builds.
+*/
+
+static inline u32 load_pair(const s16* p) {
+    u32 pair;
+    memcpy(&pair, p, sizeof(pair));
+    return pair;
+}
+
+static inline void store_pair(s16* p, u32 pair) {
+    memcpy(p, &pair, sizeof(pair));
+}
+
+static inline s16 low_half(u32 pair) {
+    return (s16)pair;
+}
+
+static inline s16 high_half(u32 pair) {
+    return (s16)(pair >> 16);
+}
+
+static inline u32 make_pair(s32 low, s32 high) {
+    return (u16)low | ((u32)(u16)high << 16);
+}
+
+#ifdef __ARM_FEATURE_SIMD32
+static inline s32 saturate16(s32 x) {
+    return __ssat(x, 16);
+}
+
+// (a * b) >> 16 for a 32-bit a and 16-bit b
+static inline s32 multiply_wide(s32 a, s16 b) {
+    return __smulwb(a, b);
+}
+
+// Low half (l + r) / 2, high half (r - l) / 2
+static inline u32 mid_side(u32 pair) {
+    return __shsax(pair, pair);
+}
+
+// Back from mid_side: low half mid - high, high half mid + high, saturated
+static inline u32 join_mid_side(u32 pair) {
+    return __qasx(pair, pair);
+}
+
+static inline u32 pair_max(u32 a, u32 b) {
+    __ssub16(a, b);
+    return __sel(a, b);
+}
+
+static inline u32 pair_min(u32 a, u32 b) {
+    __ssub16(a, b);
+    return __sel(b, a);
+}
+
+// Both halves times a Q15 gain
+static inline u32 pair_scale(u32 pair, s16 gain) {
+    return make_pair(__smulbb(pair, gain) >> 15, __smultb(pair, gain) >> 15);
+}
+#else
+static inline s32 saturate16(s32 x) {
+    return x > 32767 ? 32767 : x < -32768 ? -32768 : x;
+}
+
+static inline s32 multiply_wide(s32 a, s16 b) {
+    return (s32)(((s64)a * b) >> 16);
+}
+
+static inline u32 mid_side(u32 pair) {
+    s32 l = low_half(pair), r = high_half(pair);
+    return make_pair((l + r) >> 1, (r - l) >> 1);
+}
+
+static inline u32 join_mid_side(u32 pair) {
+    s32 mid = low_half(pair), side = high_half(pair);
+    return make_pair(saturate16(mid - side), saturate16(mid + side));
+}
+
+static inline u32 pair_max(u32 a, u32 b) {
+    return make_pair(low_half(a) >= low_half(b) ? low_half(a) : low_half(b),
+                     high_half(a) >= high_half(b) ? high_half(a) : high_half(b));
+}
+
+static inline u32 pair_min(u32 a, u32 b) {
+    return make_pair(low_half(a) >= low_half(b) ? low_half(b) : low_half(a),
+                     high_half(a) >= high_half(b) ? high_half(b) : high_half(a));
+}
+
+static inline u32 pair_scale(u32 pair, s16 gain) {
+    return make_pair((low_half(pair) * gain) >> 15, (high_half(pair) * gain) >> 15);
+}
+#endif
+
+// === EFFECTS ===
+
+typedef struct {
+    EffectConfig config;
+    union {
+        struct {
+            s32 low[2];       // one-pole lowpass per channel, samples << 8
+            s16 coefficient;  // Q16
+            s16 gain;         // Q12, added on top of the dry signal
+        } bass;
+        struct {
+            s16 width;        // Q12
+        } widen;
+        struct {
+            s32 threshold;    // linear, full scale 32767
+            s32 envelope;
+            s32 gain;         // Q15, as applied at the end of the last block
+            s32 release;      // Q15, how far the envelope falls towards the peak per block
+        } compressor;
+    };
+} Effect;
+
+typedef struct {
+    const char* name;
+    u32 cost;  // ARM11 cycles per stereo frame, counted from the inner loop's instructions and their latencies
+    const char* (*validate)(const EffectConfig* config);  // NULL if valid, else what is wrong
+    void (*reset)(Effect* effect, u32 rate);
+    void (*process)(Effect* effect, s16* samples, u32 frames, int channels);
+} EffectKind;
+
+/* Bass: a one-pole lowpass per channel, scaled and added back
+The filter state keeps 8 bits below the sample so low cutoffs don't stall.
+*/
+static const char* bass_validate(const EffectConfig* config) {
+    if (config->gain < 0 || config->gain > 120)
+        return "bass gain is 0 to 12 dB";
+    if (config->cutoff < 20 || config->cutoff > 500)
+        return "bass cutoff is 20 to 500 Hz";
+    return NULL;
+}
+
+static void bass_reset(Effect* effect, u32 rate) {
+    effect->bass.low[0] = effect->bass.low[1] = 0;
+    effect->bass.coefficient = (s16)(65536.0f * (1.0f - expf(-2.0f * (float)M_PI * effect->config.cutoff / rate)));
+    effect->bass.gain = (s16)(4096.0f * (powf(10.0f, effect->config.gain / 200.0f) - 1.0f));
+}
+
+static void bass_process(Effect* effect, s16* samples, u32 frames, int channels) {
+    s16 coefficient = effect->bass.coefficient;
+    s16 gain = effect->bass.gain;
+    for (int c = 0; c < channels; ++c) {
+        s32 low = effect->bass.low[c];
+        for (u32 i = c; i < frames * channels; i += channels) {
+            s32 x = samples[i];
+            low += multiply_wide(x * 256 - low, coefficient);
+            samples[i] = saturate16(x + (((low >> 8) * gain) >> 12));
+        }
+        effect->bass.low[c] = low;
+    }
+}
+
+// Widen: mid/side in one instruction each way, with the side scaled in between
+static const char* widen_validate(const EffectConfig* config) {
+    return config->width < 0 || config->width > 200 ? "width is 0 to 200%" : NULL;
+}
+
+static void widen_reset(Effect* effect, u32 rate) {
+    effect->widen.width = (s16)(effect->config.width * 4096 / 100);
+}
+
+static void widen_process(Effect* effect, s16* samples, u32 frames, int channels) {
+    if (channels != 2)
+        return;
+    s16 width = effect->widen.width;
+    for (u32 i = 0; i < frames; ++i) {
+        u32 pair = mid_side(load_pair(samples + i * 2));
+        s32 side = saturate16((high_half(pair) * width) >> 12);
+        store_pair(samples + i * 2, join_mid_side(make_pair(low_half(pair), side)));
+    }
+}
+
+/* Compressor: gain from the peak of each EFFECTS_BLOCK_FRAMES block
+The block's peak is known before any of it is scaled, so a falling gain is
+applied from the block's first frame and nothing overshoots; a rising one
+ramps across the block. The envelope follows peaks at once and falls back
+over about EFFECTS_RELEASE_SECONDS.
+*/
+#define EFFECTS_RELEASE_SECONDS 0.2f
+
+static const char* compressor_validate(const EffectConfig* config) {
+    if (config->threshold < 0 || config->threshold > 400)
+        return "threshold is 0 to 40 dB below full scale";
+    if (config->ratio < 0 || config->ratio == 1 || config->ratio > 20)
+        return "ratio is 2 to 20, or 0 to limit";
+    return NULL;
+}
+
+static void compressor_reset(Effect* effect, u32 rate) {
+    effect->compressor.threshold = (s32)(32767.0f * powf(10.0f, -effect->config.threshold / 200.0f));
+    effect->compressor.envelope = 0;
+    effect->compressor.gain = 32767;
+    effect->compressor.release =
+        (s32)(32768.0f * (1.0f - expf(-(float)EFFECTS_BLOCK_FRAMES / (rate * EFFECTS_RELEASE_SECONDS))));
+}
+
+static s32 block_peak(const s16* samples, u32 frames, int channels) {
+    if (channels != 2) {
+        s32 peak = 0;
+        for (u32 i = 0; i < frames * channels; ++i) {
+            s32 magnitude = samples[i] < 0 ? -samples[i] : samples[i];
+            if (magnitude > peak)
+                peak = magnitude;
+        }
+        return peak;
+    }
+
+    u32 highest = make_pair(-32768, -32768), lowest = make_pair(32767, 32767);
+    for (u32 i = 0; i < frames; ++i) {
+        u32 pair = load_pair(samples + i * 2);
+        highest = pair_max(highest, pair);
+        lowest = pair_min(lowest, pair);
+    }
+    s32 peak = -low_half(lowest) > -high_half(lowest) ? -low_half(lowest) : -high_half(lowest);
+    if (low_half(highest) > peak)
+        peak = low_half(highest);
+    if (high_half(highest) > peak)
+        peak = high_half(highest);
+    return peak;
+}
+
+static void compressor_process(Effect* effect, s16* samples, u32 frames, int channels) {
+    for (u32 start = 0; start < frames; start += EFFECTS_BLOCK_FRAMES) {
+        u32 count = frames - start < EFFECTS_BLOCK_FRAMES ? frames - start : EFFECTS_BLOCK_FRAMES;
+        s16* block = samples + start * channels;
+
+        s32 peak = block_peak(block, count, channels);
+        s32 envelope = effect->compressor.envelope;
+        if (peak > envelope)
+            envelope = peak;
+        else
+            envelope -= ((envelope - peak) * effect->compressor.release) >> 15;
+        effect->compressor.envelope = envelope;
+
+        s32 threshold = effect->compressor.threshold;
+        s32 target = 32767;
+        if (envelope > threshold) {
+            s32 level = effect->config.ratio ? threshold + (envelope - threshold) / effect->config.ratio : threshold;
+            target = (s32)(((s64)level << 15) / envelope);
+            if (target > 32767)
+                target = 32767;
+        }
+
+        s32 gain = effect->compressor.gain;
+        s32 step = 0;
+        if (target <= gain)
+            gain = target;
+        else
+            step = (target - gain) / (s32)count;
+
+        if (gain == 32767 && step == 0) {
+            effect->compressor.gain = gain;
+            continue;
+        }
+        if (channels == 2) {
+            for (u32 i = 0; i < count; ++i, gain += step)
+                store_pair(block + i * 2, pair_scale(load_pair(block + i * 2), (s16)gain));
+        } else {
+            for (u32 i = 0; i < count * channels; ++i, gain += step)
+                block[i] = (s16)((block[i] * gain) >> 15);
+        }
+        effect->compressor.gain = target;
+    }
+}
+
+static const EffectKind effect_kinds[EFFECT_TYPE_COUNT] = {
+    [EFFECT_BASS]       = { "bass",       30, bass_validate,       bass_reset,       bass_process },
+    [EFFECT_WIDEN]      = { "widen",      12, widen_validate,      widen_reset,      widen_process },
+    [EFFECT_COMPRESSOR] = { "compressor", 26, compressor_validate, compressor_reset, compressor_process },
+};
+
+// === CHAIN ===
+
+static struct {
+    Effect chain[EFFECTS_MAX_CHAIN];
+    u32 count;
+    u32 cost;
+    u32 rate;
+} effects = { .rate = 48000 };
+
+const char* effectsName(EffectType type) {
+    return type < EFFECT_TYPE_COUNT ? effect_kinds[type].name : "?";
+}
+
+u32 effectsCost(EffectType type) {
+    return type < EFFECT_TYPE_COUNT ? effect_kinds[type].cost : 0;
+}
+
+// Cycles per frame a chain may take: what Old 3DS spares, or that times the boost on New 3DS
+static u32 budget(void) {
+    bool isNew3DS = false;
+    APT_CheckNew3DS(&isNew3DS);
+    return isNew3DS ? (u32)(EFFECTS_OLD3DS_BUDGET * BOOST_SPEEDUP) : EFFECTS_OLD3DS_BUDGET;
+}
+
+bool effectsConfigure(const EffectConfig* chain, u32 count, char* error, u32 errorSize) {
+    if (count > EFFECTS_MAX_CHAIN) {
+        snprintf(error, errorSize, "at most %d effects", EFFECTS_MAX_CHAIN);
+        return false;
+    }
+
+    u32 cost = 0;
+    for (u32 i = 0; i < count; ++i) {
+        if (chain[i].type >= EFFECT_TYPE_COUNT) {
+            snprintf(error, errorSize, "unknown effect");
+            return false;
+        }
+        const char* problem = effect_kinds[chain[i].type].validate(&chain[i]);
+        if (problem) {
+            snprintf(error, errorSize, "%s", problem);
+            return false;
+        }
+        cost += effect_kinds[chain[i].type].cost;
+    }
+    if (cost > budget()) {
+        snprintf(error, errorSize, "%lu cycles/frame, budget is %lu", (unsigned long)cost, (unsigned long)budget());
+        return false;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        effects.chain[i].config = chain[i];
+        effect_kinds[chain[i].type].reset(&effects.chain[i], effects.rate);
+    }
+    effects.count = count;
+    effects.cost = cost;
+    return true;
+}
+
+u32 effectsChainCost(void) {
+    return effects.cost;
+}
+
+void effectsReset(u32 rate) {
+    effects.rate = rate;
+    for (u32 i = 0; i < effects.count; ++i)
+        effect_kinds[effects.chain[i].config.type].reset(&effects.chain[i], rate);
+}
+
+void effectsProcess(s16* samples, u32 frames, int channels) {
+    for (u32 i = 0; i < effects.count; ++i)
+        effect_kinds[effects.chain[i].config.type].process(&effects.chain[i], samples, frames, channels);
+}
@@ -0,0 +1,55 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include <3ds.h>
+
+/* Software effects on decoded audio
+A short chain of effects runs on every wave buffer after decoding and
+before it is queued, for what the DSP's own filters can't do. Everything
+is fixed point: s16 samples in, 32-bit intermediates, saturated back to
+s16, with stereo frames handled as one 32-bit word through the ARMv6
+dual-16 instructions where the effect allows it.
+
+Each effect type declares what it costs in ARM11 cycles per frame.
+effectsConfigure adds the chain up and refuses it if the total is over
+what the console can spare beside Tremor (EFFECTS_OLD3DS_BUDGET, or
+BOOST_SPEEDUP times that on New 3DS, where the clock boost covers the
+rest), so a chain can't push decoding below realtime.
+*/
+
+#define EFFECTS_MAX_CHAIN     4
+#define EFFECTS_OLD3DS_BUDGET 64  // cycles per frame at 268 MHz, about 1% of the core at 48 kHz
+#define EFFECTS_BLOCK_FRAMES  32  // compressor gain is worked out once per block
+
+typedef enum {
+    EFFECT_BASS,        // low shelf: gain in tenths of a dB, up to 120, below cutoff Hz
+    EFFECT_WIDEN,       // side level: width in percent, 0 (mono) to 200, 100 leaves it as is
+    EFFECT_COMPRESSOR,  // above threshold (tenths of a dB below full scale) by ratio:1; ratio 0 limits
+    EFFECT_TYPE_COUNT
+} EffectType;
+
+typedef struct {
+    EffectType type;
+    int gain;
+    int cutoff;
+    int width;
+    int threshold;
+    int ratio;
+} EffectConfig;
+
+const char* effectsName(EffectType type);
+u32 effectsCost(EffectType type);
+
+// Replaces the chain, or leaves it as it was and returns false with the reason in `error`
+bool effectsConfigure(const EffectConfig* chain, u32 count, char* error, u32 errorSize);
+
+// Cycles per frame of the configured chain
+u32 effectsChainCost(void);
+
+// Clears filter and envelope state for a new stream at `rate`; call before its first buffer
+void effectsReset(u32 rate);
+
+// Runs the chain in place over interleaved frames; the caller serializes this with effectsConfigure
+void effectsProcess(s16* samples, u32 frames, int channels);
+
+#endif // EFFECTS_H
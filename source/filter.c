@@ -0,0 +1,437 @@
+#include "filter.h"
+#include "search.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define FILTER_TOKEN_LENGTH 64
+#define SECONDS_PER_DAY     86400u
+
+enum {
+    OP_TEXT,   // bitmap from the match table at `low`, indexed by the column's ids
+    OP_RANGE,  // bitmap of low <= value <= high
+    OP_AGE,    // OP_RANGE over a timestamp column, bounds in days before `now`
+    OP_AND,
+    OP_OR,
+    OP_NOT
+};
+
+enum {
+    FIELD_TEXT,
+    FIELD_NUMBER,
+    FIELD_AGE
+};
+
+static const struct {
+    const char* name;
+    u8 kind;
+    u8 column;
+    bool zeroUnknown;  // 0 means missing, so comparisons never match it
+} fields[] = {
+    { "genre",      FIELD_TEXT,   FILTER_TEXT_GENRE,        false },
+    { "artist",     FIELD_TEXT,   FILTER_TEXT_ARTIST,       false },
+    { "album",      FIELD_TEXT,   FILTER_TEXT_ALBUM,        false },
+    { "year",       FIELD_NUMBER, FILTER_NUMBER_YEAR,       true },
+    { "length",     FIELD_NUMBER, FILTER_NUMBER_LENGTH,     true },
+    { "plays",      FIELD_NUMBER, FILTER_NUMBER_PLAYS,      false },
+    { "lastplayed", FIELD_AGE,    FILTER_NUMBER_LASTPLAYED, false },
+};
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_WORD,
+    TOKEN_STRING,
+    TOKEN_OPERATOR,
+    TOKEN_OPEN,
+    TOKEN_CLOSE
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    char text[FILTER_TOKEN_LENGTH];
+} Token;
+
+typedef struct {
+    const char* p;
+    FilterProgram* program;
+    const FilterColumns* columns;
+    char* error;
+    u32 errorSize;
+    int depth;
+    bool failed;
+} Parser;
+
+// === COMPILER ===
+
+static void fail(Parser* parser, const char* message, const char* detail) {
+    if (parser->failed)
+        return;
+    parser->failed = true;
+    snprintf(parser->error, parser->errorSize, "%s%s%s", message, detail ? ": " : "", detail ? detail : "");
+}
+
+static bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c == '\'' || c == '.' || (u8)c >= 0x80;
+}
+
+static Token next_token(Parser* parser) {
+    Token token = { TOKEN_END, "" };
+    const char* p = parser->p;
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    u32 length = 0;
+    if (*p == '(' || *p == ')') {
+        token.type = *p == '(' ? TOKEN_OPEN : TOKEN_CLOSE;
+        token.text[length++] = *p++;
+    } else if (*p == '"') {
+        token.type = TOKEN_STRING;
+        for (p++; *p && *p != '"'; p++) {
+            if (length < FILTER_TOKEN_LENGTH - 1)
+                token.text[length++] = *p;
+        }
+        if (*p != '"')
+            fail(parser, "unterminated string", NULL);
+        else
+            p++;
+    } else if (strchr("=!<>~", *p) && *p) {
+        token.type = TOKEN_OPERATOR;
+        token.text[length++] = *p++;
+        if (*p == '=' || (token.text[0] == '!' && *p == '~'))
+            token.text[length++] = *p++;
+    } else if (is_word_char(*p)) {
+        token.type = TOKEN_WORD;
+        while (is_word_char(*p)) {
+            if (length < FILTER_TOKEN_LENGTH - 1)
+                token.text[length++] = *p;
+            p++;
+        }
+    } else if (*p) {
+        char c[2] = { *p, '\0' };
+        fail(parser, "unexpected character", c);
+    }
+    token.text[length] = '\0';
+    parser->p = p;
+    return token;
+}
+
+static Token peek_token(Parser* parser) {
+    const char* p = parser->p;
+    Token token = next_token(parser);
+    parser->p = p;
+    return token;
+}
+
+static bool is_keyword(const Token* token, const char* keyword) {
+    return token->type == TOKEN_WORD && strcasecmp(token->text, keyword) == 0;
+}
+
+static void emit(Parser* parser, u8 op, u8 column, u32 low, u32 high) {
+    FilterProgram* program = parser->program;
+    if (program->length >= FILTER_MAX_PROGRAM) {
+        fail(parser, "query too long", NULL);
+        return;
+    }
+
+    // Scans push a bitmap, and/or combine two into one, not works in place
+    parser->depth += op == OP_AND || op == OP_OR ? -1 : op == OP_NOT ? 0 : 1;
+    if (parser->depth > FILTER_MAX_DEPTH)
+        fail(parser, "query nested too deeply", NULL);
+    program->code[program->length++] = (FilterInstruction){ op, column, low, high };
+}
+
+// Decides the comparison for every distinct value of the column, so running it is a table lookup per track
+static void compile_text(Parser* parser, u8 column, const char* op, const char* value) {
+    const FilterColumns* columns = parser->columns;
+    bool contains = op[strlen(op) - 1] == '~';
+    bool negate = op[0] == '!';
+    if (!contains && strcmp(op, "=") != 0 && strcmp(op, "!=") != 0) {
+        fail(parser, "text fields only compare with = != ~ !~", op);
+        return;
+    }
+
+    FilterProgram* program = parser->program;
+    u32 count = columns->text[column].nameCount;
+    u8* matches = (u8*)realloc(program->matches, program->matchesSize + count + 1);
+    if (!matches) {
+        fail(parser, "out of memory", NULL);
+        return;
+    }
+    program->matches = matches;
+
+    char folded[FILTER_TOKEN_LENGTH];
+    char name[256];
+    searchFold(value, folded, sizeof(folded));
+    u8* table = matches + program->matchesSize;
+    for (u32 i = 0; i < count; ++i) {
+        searchFold(columns->text[column].names[i], name, sizeof(name));
+        bool match = contains ? strstr(name, folded) != NULL : strcmp(name, folded) == 0;
+        table[i] = match != negate;
+    }
+
+    emit(parser, OP_TEXT, column, program->matchesSize, 0);
+    program->matchesSize += count + 1;
+}
+
+static void compile_number(Parser* parser, int field, const char* op, const char* value) {
+    char* end;
+    unsigned long long number = strtoull(value, &end, 10);
+    if (!*value || *end || number > 0xFFFFFFFFull) {
+        fail(parser, "expected a number", value);
+        return;
+    }
+
+    u8 column = fields[field].column;
+    s64 limit = parser->columns->number[column].wide ? 0xFFFFFFFFll : 0xFFFF;
+    s64 low = 0, high = limit;
+    bool negate = false;
+    if (strcmp(op, "=") == 0 || strcmp(op, "!=") == 0) {
+        low = high = number;
+        negate = op[0] == '!';
+    } else if (strcmp(op, "<") == 0) {
+        high = (s64)number - 1;
+    } else if (strcmp(op, "<=") == 0) {
+        high = number;
+    } else if (strcmp(op, ">") == 0) {
+        low = (s64)number + 1;
+    } else if (strcmp(op, ">=") == 0) {
+        low = number;
+    } else {
+        fail(parser, "numbers compare with = != < <= > >=", op);
+        return;
+    }
+
+    if (fields[field].zeroUnknown && low == 0)
+        low = 1;
+    if (high > limit)
+        high = limit;
+
+    u32 known = fields[field].zeroUnknown ? 1 : 0;
+    if (low > high) {
+        // Nothing matches: everything, negated; != of such a value is every known one
+        emit(parser, OP_RANGE, column, negate ? known : 0, (u32)limit);
+        if (!negate)
+            emit(parser, OP_NOT, 0, 0, 0);
+        return;
+    }
+
+    if (fields[field].kind == FIELD_AGE) {
+        // Days become timestamps when the program runs; high == limit means no upper bound
+        emit(parser, OP_AGE, column, (u32)low, (u32)high);
+    } else {
+        emit(parser, OP_RANGE, column, (u32)low, (u32)high);
+    }
+    if (negate) {
+        emit(parser, OP_NOT, 0, 0, 0);
+        // Not brings missing values back in; they stay out of != as of every other comparison
+        if (known) {
+            emit(parser, OP_RANGE, column, known, (u32)limit);
+            emit(parser, OP_AND, 0, 0, 0);
+        }
+    }
+}
+
+static void parse_predicate(Parser* parser) {
+    Token name = next_token(parser);
+    if (name.type != TOKEN_WORD) {
+        fail(parser, "expected a field name", name.text[0] ? name.text : NULL);
+        return;
+    }
+
+    int field = -1;
+    for (u32 i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        if (strcasecmp(name.text, fields[i].name) == 0)
+            field = i;
+    }
+    if (field < 0) {
+        fail(parser, "unknown field", name.text);
+        return;
+    }
+
+    bool present = fields[field].kind == FIELD_TEXT ? parser->columns->text[fields[field].column].ids != NULL
+                                                    : parser->columns->number[fields[field].column].values != NULL;
+    if (!present) {
+        fail(parser, "this library has no data for", name.text);
+        return;
+    }
+
+    Token op = next_token(parser);
+    Token value = next_token(parser);
+    if (op.type != TOKEN_OPERATOR) {
+        fail(parser, "expected a comparison after", name.text);
+        return;
+    }
+    if (value.type != TOKEN_WORD && value.type != TOKEN_STRING) {
+        fail(parser, "expected a value after", op.text);
+        return;
+    }
+
+    if (fields[field].kind == FIELD_TEXT)
+        compile_text(parser, fields[field].column, op.text, value.text);
+    else
+        compile_number(parser, field, op.text, value.text);
+}
+
+static void parse_or(Parser* parser);
+
+static void parse_not(Parser* parser) {
+    Token token = peek_token(parser);
+    if (is_keyword(&token, "not")) {
+        next_token(parser);
+        parse_not(parser);
+        emit(parser, OP_NOT, 0, 0, 0);
+    } else if (token.type == TOKEN_OPEN) {
+        next_token(parser);
+        parse_or(parser);
+        if (next_token(parser).type != TOKEN_CLOSE)
+            fail(parser, "missing )", NULL);
+    } else {
+        parse_predicate(parser);
+    }
+}
+
+static void parse_and(Parser* parser) {
+    parse_not(parser);
+    for (Token token = peek_token(parser); is_keyword(&token, "and") && !parser->failed; token = peek_token(parser)) {
+        next_token(parser);
+        parse_not(parser);
+        emit(parser, OP_AND, 0, 0, 0);
+    }
+}
+
+static void parse_or(Parser* parser) {
+    parse_and(parser);
+    for (Token token = peek_token(parser); is_keyword(&token, "or") && !parser->failed; token = peek_token(parser)) {
+        next_token(parser);
+        parse_and(parser);
+        emit(parser, OP_OR, 0, 0, 0);
+    }
+}
+
+bool filterCompile(FilterProgram* program, const char* query, const FilterColumns* columns, char* error, u32 errorSize) {
+    memset(program, 0, sizeof(*program));
+    Parser parser = { query, program, columns, error, errorSize, 0, false };
+    if (errorSize > 0)
+        error[0] = '\0';
+
+    parse_or(&parser);
+    Token rest = next_token(&parser);
+    if (rest.type != TOKEN_END)
+        fail(&parser, "unexpected", rest.text);
+
+    if (parser.failed) {
+        filterFree(program);
+        return false;
+    }
+    return true;
+}
+
+void filterFree(FilterProgram* program) {
+    free(program->matches);
+    memset(program, 0, sizeof(*program));
+}
+
+// === EVALUATION ===
+
+static void scan_text(u32* bits, const u16* ids, const u8* matches, u32 count) {
+    for (u32 base = 0; base < count; base += 32) {
+        u32 n = count - base < 32 ? count - base : 32;
+        u32 word = 0;
+        for (u32 b = 0; b < n; ++b)
+            word |= (u32)matches[ids[base + b]] << b;
+        bits[base / 32] = word;
+    }
+}
+
+// One unsigned compare per track: value - low wraps around for anything below low
+static void scan_range(u32* bits, const void* values, bool wide, u32 low, u32 high, u32 count) {
+    u32 span = high - low;
+    for (u32 base = 0; base < count; base += 32) {
+        u32 n = count - base < 32 ? count - base : 32;
+        u32 word = 0;
+        if (wide) {
+            const u32* v = (const u32*)values + base;
+            for (u32 b = 0; b < n; ++b)
+                word |= (u32)(v[b] - low <= span) << b;
+        } else {
+            const u16* v = (const u16*)values + base;
+            for (u32 b = 0; b < n; ++b)
+                word |= (u32)((u32)v[b] - low <= span) << b;
+        }
+        bits[base / 32] = word;
+    }
+}
+
+// Played between `high` and `low` whole days before now; a timestamp of 0 (never) only counts when there's no upper bound
+static void scan_age(u32* bits, const void* values, bool wide, u32 low, u32 high, u32 now, u32 count) {
+    s64 newest = low == 0 ? 0xFFFFFFFFll : (s64)now - (s64)low * SECONDS_PER_DAY;
+    s64 oldest = high == 0xFFFFFFFFu ? 0 : (s64)now - ((s64)high + 1) * SECONDS_PER_DAY + 1;
+    if (high != 0xFFFFFFFFu && oldest < 1)
+        oldest = 1;
+
+    if (newest < oldest)
+        memset(bits, 0, (count + 31) / 32 * sizeof(u32));
+    else
+        scan_range(bits, values, wide, (u32)oldest, (u32)newest, count);
+}
+
+u32 filterRun(const FilterProgram* program, const FilterColumns* columns, u32 now, u32* results, u32 maxResults) {
+    u32 count = columns->trackCount;
+    u32 words = (count + 31) / 32;
+    if (program->length == 0 || words == 0)
+        return 0;
+
+    u32* stack = (u32*)malloc(FILTER_MAX_DEPTH * words * sizeof(u32));
+    if (!stack)
+        return 0;
+
+    u32 tailMask = count % 32 ? (1u << (count % 32)) - 1 : 0xFFFFFFFFu;
+    int top = 0;
+    for (u32 i = 0; i < program->length; ++i) {
+        const FilterInstruction* in = &program->code[i];
+        u32* bits = stack + top * words;  // next free bitmap
+        u32* last = bits - words;         // top of the stack
+        u32* second = last - words;
+        switch (in->op) {
+        case OP_TEXT:
+            scan_text(bits, columns->text[in->column].ids, program->matches + in->low, count);
+            top++;
+            break;
+        case OP_RANGE:
+            scan_range(bits, columns->number[in->column].values, columns->number[in->column].wide, in->low, in->high, count);
+            top++;
+            break;
+        case OP_AGE:
+            scan_age(bits, columns->number[in->column].values, columns->number[in->column].wide, in->low, in->high, now,
+                count);
+            top++;
+            break;
+        case OP_NOT:
+            for (u32 w = 0; w < words; ++w)
+                last[w] = ~last[w];
+            last[words - 1] &= tailMask;
+            break;
+        case OP_AND:
+            for (u32 w = 0; w < words; ++w)
+                second[w] &= last[w];
+            top--;
+            break;
+        case OP_OR:
+            for (u32 w = 0; w < words; ++w)
+                second[w] |= last[w];
+            top--;
+            break;
+        }
+    }
+
+    u32 found = 0;
+    for (u32 w = 0; w < words && found < maxResults; ++w) {
+        for (u32 word = stack[w]; word && found < maxResults; word &= word - 1)
+            results[found++] = w * 32 + __builtin_ctz(word);
+    }
+    free(stack);
+    return found;
+}
@@ -0,0 +1,76 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <3ds.h>
+
+/* Smart playlist queries over columnar track metadata
+A query is a boolean expression of comparisons:
+
+    genre = rock and year >= 1990 and not (artist ~ "various" or lastplayed < 30)
+
+  genre, artist, album  = != (folded equality)  ~ !~ (folded substring)
+  year, length, plays   = != < <= > >=          (length in seconds; unknown matches none, != included)
+  lastplayed            the same, in days ago; never played is infinitely long ago
+
+Text values are a word or a "quoted string"; and binds tighter than or.
+filterCompile turns a query into a postfix program once. Text comparisons
+are decided per dictionary value at compile time into a match table, and
+numeric ones become an inclusive range, so running the program is a few
+branch-free passes over u16/u32 columns, each producing a bitmap of
+matching tracks, combined with word-wide and/or/not.
+*/
+
+#define FILTER_MAX_PROGRAM 32  // instructions
+#define FILTER_MAX_DEPTH   8   // bitmaps on the evaluation stack
+
+typedef enum {
+    FILTER_TEXT_GENRE,
+    FILTER_TEXT_ARTIST,
+    FILTER_TEXT_ALBUM,
+    FILTER_TEXT_COUNT
+} FilterText;
+
+typedef enum {
+    FILTER_NUMBER_YEAR,        // 0 = unknown
+    FILTER_NUMBER_LENGTH,      // seconds, 0 = unknown
+    FILTER_NUMBER_PLAYS,
+    FILTER_NUMBER_LASTPLAYED,  // Unix time, 0 = never
+    FILTER_NUMBER_COUNT
+} FilterNumber;
+
+// A NULL column means the library doesn't have it; queries using it fail to compile
+typedef struct {
+    u32 trackCount;
+    struct {
+        const u16* ids;              // per track, indexes names
+        const char* const* names;    // distinct values
+        u32 nameCount;
+    } text[FILTER_TEXT_COUNT];
+    struct {
+        const void* values;          // per track, u16 or u32
+        bool wide;                   // u32 values
+    } number[FILTER_NUMBER_COUNT];
+} FilterColumns;
+
+typedef struct {
+    u8 op;
+    u8 column;
+    u32 low;   // text scans: offset of the match table; range scans: inclusive bounds
+    u32 high;
+} FilterInstruction;
+
+typedef struct {
+    FilterInstruction code[FILTER_MAX_PROGRAM];
+    u32 length;
+    u8* matches;  // match tables of the text scans, one byte per dictionary value
+    u32 matchesSize;
+} FilterProgram;
+
+// Returns false with a message in `error` if the query is malformed or uses a missing column
+bool filterCompile(FilterProgram* program, const char* query, const FilterColumns* columns, char* error, u32 errorSize);
+void filterFree(FilterProgram* program);
+
+// Tracks matching the program, in library order; `now` (Unix time) dates lastplayed. Returns the count written.
+u32 filterRun(const FilterProgram* program, const FilterColumns* columns, u32 now, u32* results, u32 maxResults);
+
+#endif // FILTER_H
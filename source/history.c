@@ -0,0 +1,155 @@
+#include "history.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HISTORY_MAGIC  0x48504D58u  // "XMPH"
+#define HISTORY_LAYOUT 1
+#define HISTORY_PATH_MAX 128
+
+typedef struct {
+    u32 magic;
+    u32 layout;
+    u32 count;
+} HistoryHeader;
+
+typedef struct {
+    u64 hash;
+    u32 size;
+    u32 lastPlayed;
+    u32 playCount;
+    u32 reserved;
+} HistoryRecord;
+
+static struct {
+    char path[HISTORY_PATH_MAX];
+    HistoryRecord* records;
+    u32 count;
+    u32 capacity;
+    bool dirty;
+} history;
+
+static int compare_key(const HistoryRecord* record, CacheKey key) {
+    if (record->hash != key.hash)
+        return record->hash < key.hash ? -1 : 1;
+    return record->size < key.size ? -1 : record->size > key.size;
+}
+
+// Index of the record for `key`, or where it would be inserted
+static u32 find_record(CacheKey key) {
+    u32 low = 0, high = history.count;
+    while (low < high) {
+        u32 mid = (low + high) / 2;
+        if (compare_key(&history.records[mid], key) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// find_record binary-searches, so a file not in strict key order is refused
+static bool records_sorted(const HistoryRecord* records, u32 count) {
+    for (u32 i = 1; i < count; ++i) {
+        CacheKey key = { records[i].hash, records[i].size };
+        if (compare_key(&records[i - 1], key) >= 0)
+            return false;
+    }
+    return true;
+}
+
+bool historyLoad(const char* path) {
+    historyExit();
+    snprintf(history.path, sizeof(history.path), "%s", path);
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    HistoryHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == HISTORY_MAGIC && header.layout == HISTORY_LAYOUT;
+    // A corrupt count must not size the allocation: the file has to hold that many records
+    long end = ok && fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    ok = ok && end >= (long)sizeof(header) &&
+         header.count <= (u32)((end - sizeof(header)) / sizeof(HistoryRecord)) &&
+         fseek(file, sizeof(header), SEEK_SET) == 0;
+    if (ok && header.count > 0) {
+        history.records = (HistoryRecord*)malloc(header.count * sizeof(HistoryRecord));
+        ok = history.records && fread(history.records, sizeof(HistoryRecord), header.count, file) == header.count &&
+             records_sorted(history.records, header.count);
+    }
+    fclose(file);
+
+    if (!ok) {
+        free(history.records);
+        history.records = NULL;
+        return false;
+    }
+    statsMemory(STATS_MEMORY_HISTORY, header.count * sizeof(HistoryRecord));
+    history.count = history.capacity = header.count;
+    return true;
+}
+
+// Written to path.tmp and swapped in, as the cache does, so a crash never loses the whole history
+bool historySave(void) {
+    if (!history.dirty || !history.path[0])
+        return true;
+
+    char tmp[HISTORY_PATH_MAX + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", history.path);
+    FILE* file = fopen(tmp, "wb");
+    if (!file)
+        return false;
+
+    HistoryHeader header = { HISTORY_MAGIC, HISTORY_LAYOUT, history.count };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(history.records, sizeof(HistoryRecord), history.count, file) == history.count;
+    ok = (fclose(file) == 0) && ok;
+    if (ok) {
+        remove(history.path);
+        ok = rename(tmp, history.path) == 0;
+    }
+    if (!ok)
+        remove(tmp);
+    else
+        history.dirty = false;
+    return ok;
+}
+
+void historyExit(void) {
+    free(history.records);
+    memset(&history, 0, sizeof(history));
+}
+
+void historyRecordPlay(CacheKey key, u32 when) {
+    u32 index = find_record(key);
+    if (index == history.count || compare_key(&history.records[index], key) != 0) {
+        if (history.count == history.capacity) {
+            u32 capacity = history.capacity ? history.capacity * 2 : 64;
+            HistoryRecord* records = (HistoryRecord*)realloc(history.records, capacity * sizeof(HistoryRecord));
+            if (!records)
+                return;
+            statsMemory(STATS_MEMORY_HISTORY, (capacity - history.capacity) * sizeof(HistoryRecord));
+            history.records = records;
+            history.capacity = capacity;
+        }
+        memmove(&history.records[index + 1], &history.records[index], (history.count - index) * sizeof(HistoryRecord));
+        history.records[index] = (HistoryRecord){ .hash = key.hash, .size = key.size };
+        history.count++;
+    }
+
+    history.records[index].lastPlayed = when;
+    history.records[index].playCount++;
+    history.dirty = true;
+}
+
+bool historyLookup(CacheKey key, u32* lastPlayed, u32* playCount) {
+    u32 index = find_record(key);
+    bool found = index < history.count && compare_key(&history.records[index], key) == 0;
+    *lastPlayed = found ? history.records[index].lastPlayed : 0;
+    *playCount = found ? history.records[index].playCount : 0;
+    return found;
+}
@@ -0,0 +1,25 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <3ds.h>
+#include "cache.h"
+
+/* Play history
+When each track was last played and how many times, keyed by content like
+the cache so it survives rebuilding or reordering the library. Records are
+kept sorted by key for binary search, and the file is only rewritten on
+historySave when something changed.
+*/
+
+#define HISTORY_PATH "sdmc:/3ds/3dXMMP/history.bin"
+
+bool historyLoad(const char* path);
+bool historySave(void);
+void historyExit(void);
+
+void historyRecordPlay(CacheKey key, u32 when);
+
+// Last play time (Unix seconds) and play count; false, with both 0, if the track was never played
+bool historyLookup(CacheKey key, u32* lastPlayed, u32* playCount);
+
+#endif // HISTORY_H
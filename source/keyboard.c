@@ -0,0 +1,75 @@
+#include "keyboard.h"
+#include "panel.h"
+
+#include <citro2d.h>
+#include <string.h>
+
+#define KEY_CAP_WIDTH  32
+#define KEY_CAP_HEIGHT 28
+
+// The space key stretches over whatever is left of its row
+static const char* const key_rows[] = { "1234567890", "qwertyuiop", "asdfghjkl\b", "zxcvbnm " };
+#define KEY_ROW_COUNT (sizeof(key_rows) / sizeof(key_rows[0]))
+
+static Panel panel;
+static C2D_TextBuf text_buf;
+
+static void draw_keys(void* user) {
+    C2D_TextBufClear(text_buf);
+    for (u32 row = 0; row < KEY_ROW_COUNT; ++row) {
+        for (u32 col = 0; key_rows[row][col]; ++col) {
+            char key = key_rows[row][col];
+            float x = col * KEY_CAP_WIDTH, y = row * KEY_CAP_HEIGHT;
+            float width = key == ' ' ? KEYBOARD_WIDTH - x : KEY_CAP_WIDTH;
+            C2D_DrawRectSolid(x + 1, y + 1, 0, width - 2, KEY_CAP_HEIGHT - 2, C2D_Color32(50, 50, 50, 255));
+
+            char label[8] = { key, '\0' };
+            if (key == KEYBOARD_BACKSPACE)
+                strcpy(label, "<-");
+            else if (key == ' ')
+                strcpy(label, "space");
+
+            C2D_Text text;
+            C2D_TextParse(&text, text_buf, label);
+            C2D_TextOptimize(&text);
+            C2D_DrawText(&text, C2D_WithColor | C2D_AlignCenter, x + width / 2, y + 6, 0, 0.6f, 0.6f,
+                C2D_Color32(255, 255, 255, 255));
+        }
+    }
+}
+
+bool keyboardInit(void) {
+    text_buf = C2D_TextBufNew(64);
+    return text_buf && panelInit(&panel, KEYBOARD_WIDTH, KEYBOARD_HEIGHT, C2D_Color32(16, 16, 16, 255), draw_keys, NULL);
+}
+
+void keyboardExit(void) {
+    panelExit(&panel);
+    if (text_buf)
+        C2D_TextBufDelete(text_buf);
+    text_buf = NULL;
+}
+
+char keyboardInput(float x, float y, u32 kDown, const touchPosition* touch) {
+    if (!(kDown & KEY_TOUCH))
+        return 0;
+
+    float localX = touch->px - x, localY = touch->py - y;
+    if (localX < 0 || localY < 0 || localX >= KEYBOARD_WIDTH || localY >= KEYBOARD_HEIGHT)
+        return 0;
+
+    const char* keys = key_rows[(u32)localY / KEY_CAP_HEIGHT];
+    u32 col = (u32)localX / KEY_CAP_WIDTH;
+    u32 count = strlen(keys);
+    if (col >= count)
+        return keys[count - 1] == ' ' ? ' ' : 0;
+    return keys[col];
+}
+
+void keyboardRender(void) {
+    panelRender(&panel);
+}
+
+void keyboardDraw(float x, float y) {
+    panelDraw(&panel, x, y);
+}
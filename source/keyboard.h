@@ -0,0 +1,27 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <3ds.h>
+
+/* On-screen keyboard for the bottom screen
+Digits, letters, space and backspace in four rows. The key caps are drawn
+once into a panel, so showing the keyboard costs one quad a frame. Unlike
+the system software keyboard it doesn't take over the app, so whatever is
+being typed into can react to every key press.
+*/
+
+#define KEYBOARD_WIDTH     320
+#define KEYBOARD_HEIGHT    112
+#define KEYBOARD_BACKSPACE '\b'
+
+bool keyboardInit(void);
+void keyboardExit(void);
+
+// Key pressed by this frame's touch, or 0; the keyboard's top-left corner is at (x, y)
+char keyboardInput(float x, float y, u32 kDown, const touchPosition* touch);
+
+// Draws the key caps if they haven't been yet; call after C3D_FrameBegin, before drawing to the screens
+void keyboardRender(void);
+void keyboardDraw(float x, float y);
+
+#endif // KEYBOARD_H
@@ -0,0 +1,182 @@
+#include "latency.h"
+#include "memory.h"
+#include "stats.h"
+
+#include <string.h>
+
+#define LATENCY_RESULTS    8
+#define LATENCY_LOST_TICKS SYSCLOCK_ARM11  // a second, longer than any queue
+
+typedef enum {
+    MARKER_IDLE,
+    MARKER_ARMED,    // set by the main thread
+    MARKER_QUEUED,   // written into a buffer by the decoding thread
+} MarkerState;
+
+static struct {
+    volatile bool active;
+    LightLock lock;     // held while the ring is scanned or set up and freed, since those are on different threads
+    bool lockReady;
+    ndspWaveBuf capture;
+    s16* ring;
+    u32 scanned;        // ring position scanned up to
+    u32 silentRun;      // consecutive silent frames ending at `scanned`
+
+    volatile MarkerState state;
+    LatencyKind kind;
+    u64 originTick;
+    u64 enqueueTick;
+    float leadInSeconds;
+
+    LatencyResult results[LATENCY_RESULTS];
+    volatile u32 resultHead;  // written by the NDSP callback
+    u32 resultTail;           // read by the main thread
+} latency;
+
+// A debugging mode is the first thing to go when memory runs low
+static u32 release_capture(MemoryPressure pressure, void* unused) {
+    latencyStop();
+    return LATENCY_CAPTURE_FRAMES * 2 * sizeof(s16);
+}
+
+bool latencyStart(void) {
+    if (latency.active)
+        return true;
+    if (memoryPressure() != MEMORY_PRESSURE_NONE)
+        return false;
+
+    s16* ring = (s16*)linearAlloc(LATENCY_CAPTURE_FRAMES * 2 * sizeof(s16));
+    if (!ring)
+        return false;
+    if (!latency.lockReady) {
+        LightLock_Init(&latency.lock);
+        latency.lockReady = true;
+    }
+
+    LightLock_Lock(&latency.lock);
+    latency.ring = ring;
+    statsMemory(STATS_MEMORY_AUDIO, LATENCY_CAPTURE_FRAMES * 2 * sizeof(s16));
+    // Loud filler, so frames the DSP hasn't written yet can't pass for the marker's silence
+    for (u32 i = 0; i < LATENCY_CAPTURE_FRAMES * 2; ++i)
+        latency.ring[i] = 0x7FFF;
+
+    memset(&latency.capture, 0, sizeof(latency.capture));
+    latency.capture.data_pcm16 = latency.ring;
+    latency.capture.nsamples = LATENCY_CAPTURE_FRAMES;
+    latency.scanned = 0;
+    latency.silentRun = 0;
+    latency.state = MARKER_IDLE;
+    latency.resultHead = latency.resultTail = 0;
+    latency.active = true;
+    ndspSetCapture(&latency.capture);
+    LightLock_Unlock(&latency.lock);
+    memorySubscribe(MEMORY_PRIORITY_DEBUG, release_capture, NULL);
+    return true;
+}
+
+void latencyStop(void) {
+    if (!latency.active)
+        return;
+    memoryUnsubscribe(release_capture, NULL);
+
+    // A scan in progress on the NDSP thread finishes before the ring goes
+    LightLock_Lock(&latency.lock);
+    latency.active = false;
+    ndspSetCapture(NULL);
+    linearFree(latency.ring);
+    latency.ring = NULL;
+    LightLock_Unlock(&latency.lock);
+    statsMemory(STATS_MEMORY_AUDIO, -(s32)(LATENCY_CAPTURE_FRAMES * 2 * sizeof(s16)));
+}
+
+bool latencyIsActive(void) {
+    return latency.active;
+}
+
+bool latencyArm(LatencyKind kind, u64 originTick) {
+    if (!latency.active)
+        return false;
+    // A queued marker that never showed up went with a cleared queue; an armed one can just be retargeted
+    bool lost = latency.state == MARKER_QUEUED && svcGetSystemTick() - latency.enqueueTick > LATENCY_LOST_TICKS;
+    if (latency.state == MARKER_QUEUED && !lost)
+        return false;
+    latency.kind = kind;
+    latency.originTick = originTick;
+    __sync_synchronize();
+    latency.state = MARKER_ARMED;
+    return true;
+}
+
+bool latencyPollResult(LatencyResult* result) {
+    if (latency.resultTail == latency.resultHead)
+        return false;
+    *result = latency.results[latency.resultTail % LATENCY_RESULTS];
+    __sync_synchronize();
+    latency.resultTail++;
+    return true;
+}
+
+void latencyMarkBuffer(s16* samples, u32 frames, int channels, float rate) {
+    if (latency.state != MARKER_ARMED || frames < LATENCY_MARKER_OFFSET + LATENCY_MARKER_LENGTH)
+        return;
+
+    memset(samples, 0, LATENCY_MARKER_OFFSET * channels * sizeof(s16));
+    s16* burst = samples + LATENCY_MARKER_OFFSET * channels;
+    for (u32 i = 0; i < LATENCY_MARKER_LENGTH; ++i)
+        for (int c = 0; c < channels; ++c)
+            *burst++ = (i / 4) % 2 ? -LATENCY_MARKER_LEVEL : LATENCY_MARKER_LEVEL;
+
+    latency.leadInSeconds = LATENCY_MARKER_OFFSET / rate;
+    latency.enqueueTick = svcGetSystemTick();
+    latency.state = MARKER_QUEUED;
+}
+
+static void finish(u32 framesAgo) {
+    // The newest captured frame was mixed about now; the burst framesAgo before it
+    double burstSeconds = -(double)framesAgo / NDSP_SAMPLE_RATE;
+    double startTicks = (double)svcGetSystemTick() + (burstSeconds - latency.leadInSeconds) * SYSCLOCK_ARM11;
+    u64 origin = latency.kind == LATENCY_PRESS ? latency.originTick : latency.enqueueTick;
+
+    if (latency.resultHead - latency.resultTail < LATENCY_RESULTS) {
+        LatencyResult* result = &latency.results[latency.resultHead % LATENCY_RESULTS];
+        result->kind = latency.kind;
+        result->ms = (float)((startTicks - (double)origin) * 1000.0 / SYSCLOCK_ARM11);
+        __sync_synchronize();
+        latency.resultHead++;
+    }
+    latency.state = MARKER_IDLE;
+}
+
+static void scan_capture(void) {
+    u32 end = latency.capture.offset;
+    u32 pending = (end + LATENCY_CAPTURE_FRAMES - latency.scanned) % LATENCY_CAPTURE_FRAMES;
+    for (u32 n = 0; n < pending; ++n) {
+        const s16* frame = latency.ring + latency.scanned * 2;
+        int level = frame[0] < 0 ? -frame[0] : frame[0];
+        int right = frame[1] < 0 ? -frame[1] : frame[1];
+        if (right > level)
+            level = right;
+        latency.scanned = (latency.scanned + 1) % LATENCY_CAPTURE_FRAMES;
+
+        if (level <= LATENCY_SILENCE_LEVEL) {
+            latency.silentRun++;
+            continue;
+        }
+        // Resampling to the DSP rate shortens the lead-in, so half of it is enough
+        if (latency.state == MARKER_QUEUED && level >= LATENCY_BURST_LEVEL &&
+            latency.silentRun >= LATENCY_MARKER_OFFSET / 2)
+            finish(pending - 1 - n);
+        latency.silentRun = 0;
+    }
+}
+
+// Runs on the NDSP callback thread, so it holds the lock latencyStop frees the ring under
+void latencyScanCapture(void) {
+    if (!latency.active)
+        return;
+
+    LightLock_Lock(&latency.lock);
+    if (latency.active)
+        scan_capture();
+    LightLock_Unlock(&latency.lock);
+}
@@ -0,0 +1,56 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <3ds.h>
+
+/* Output latency measurement through DSP capture
+While active, the final mix is captured into a ring with ndspSetCapture.
+latencyArm marks the next wave buffer the player queues: its first
+LATENCY_MARKER_OFFSET frames are replaced by silence and the next
+LATENCY_MARKER_LENGTH by a loud square wave, a pattern music hardly ever
+has. The NDSP callback scans the newly captured frames for it, and the
+interval ends when the burst appears, less the silent lead-in, so it ends
+when the buffer's first frame was mixed.
+
+Two intervals are measured: from the buffer being queued (enqueue to
+output, the depth of the queue plus the DSP's own pipeline), and from a
+button press that changed what plays (press to audible). Markers replace
+a few milliseconds of audio, so this is a debugging mode.
+*/
+
+#define LATENCY_CAPTURE_FRAMES (160 * 64)  // stereo frames of captured mix, about 310 ms
+#define LATENCY_MARKER_OFFSET  256         // silent frames before the burst
+#define LATENCY_MARKER_LENGTH  32
+#define LATENCY_MARKER_LEVEL   0x5000
+#define LATENCY_SILENCE_LEVEL  8           // captured samples at most this loud count as silence
+#define LATENCY_BURST_LEVEL    1024        // the burst survives loudness gain down to -28 dB
+
+typedef enum {
+    LATENCY_ENQUEUE,  // from ndspChnWaveBufAdd
+    LATENCY_PRESS,    // from the tick passed to latencyArm
+} LatencyKind;
+
+typedef struct {
+    LatencyKind kind;
+    float ms;
+} LatencyResult;
+
+bool latencyStart(void);
+void latencyStop(void);
+bool latencyIsActive(void);
+
+// False while a queued marker is still on its way out; an armed but unqueued one is replaced
+bool latencyArm(LatencyKind kind, u64 originTick);
+
+// Finished measurements, oldest first; call from the main thread
+bool latencyPollResult(LatencyResult* result);
+
+// === PLAYER SIDE ===
+
+// Writes the marker into a buffer about to be queued, if one is armed; call just before ndspChnWaveBufAdd
+void latencyMarkBuffer(s16* samples, u32 frames, int channels, float rate);
+
+// Scans what the DSP captured since the last call; call from the NDSP callback
+void latencyScanCapture(void);
+
+#endif // LATENCY_H
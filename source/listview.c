@@ -0,0 +1,183 @@
+#include "listview.h"
+#include "trace.h"
+
+#include <math.h>
+#include <string.h>
+
+#define LIST_TEXT_SCALE    0.5f
+#define LIST_FLING_DECAY   0.92f
+#define LIST_TAP_SLOP      6.0f  // pixels a touch may move and still count as a tap
+#define LIST_SCROLLBAR_MIN 8.0f
+
+static float max_scroll(const ListView* list) {
+    float total = (float)list->count * LIST_ROW_HEIGHT - list->height;
+    return total > 0.0f ? total : 0.0f;
+}
+
+static void clamp_scroll(ListView* list) {
+    float limit = max_scroll(list);
+    if (list->scroll > limit) {
+        list->scroll = limit;
+        list->velocity = 0.0f;
+    }
+    if (list->scroll < 0.0f) {
+        list->scroll = 0.0f;
+        list->velocity = 0.0f;
+    }
+}
+
+static void drop_slots(ListView* list) {
+    for (int i = 0; i < LIST_POOL_SIZE; ++i)
+        list->slots[i].row = -1;
+}
+
+// Shaped text for a row, reusing the slot's buffer when the row changes
+static const C2D_Text* row_text(ListView* list, int row) {
+    ListSlot* slot = &list->slots[row % LIST_POOL_SIZE];
+    if (slot->row != row) {
+        TRACE_SCOPE("shape row");
+        char label[LIST_LABEL_LENGTH];
+        label[0] = '\0';
+        list->label(row, label, sizeof(label), list->user);
+
+        C2D_TextBufClear(slot->buf);
+        C2D_TextParse(&slot->text, slot->buf, label);
+        C2D_TextOptimize(&slot->text);
+        slot->row = row;
+        list->rowsShaped++;
+    }
+    return &slot->text;
+}
+
+// === LIST API ===
+
+void listViewInit(ListView* list, float x, float y, float width, float height) {
+    memset(list, 0, sizeof(*list));
+    list->x = x;
+    list->y = y;
+    list->width = width;
+
+    // Rows on screen at once must fit the pool or slots would evict each other mid-frame
+    float limit = (LIST_POOL_SIZE - 1) * LIST_ROW_HEIGHT;
+    list->height = height < limit ? height : limit;
+
+    for (int i = 0; i < LIST_POOL_SIZE; ++i)
+        list->slots[i].buf = C2D_TextBufNew(LIST_LABEL_LENGTH);
+    drop_slots(list);
+}
+
+void listViewExit(ListView* list) {
+    for (int i = 0; i < LIST_POOL_SIZE; ++i) {
+        if (list->slots[i].buf)
+            C2D_TextBufDelete(list->slots[i].buf);
+        list->slots[i].buf = NULL;
+    }
+}
+
+void listViewSetSource(ListView* list, int count, ListLabelFunc label, void* user) {
+    list->count = count;
+    list->label = label;
+    list->user = user;
+    list->cursor = 0;
+    list->scroll = 0.0f;
+    list->velocity = 0.0f;
+    drop_slots(list);
+}
+
+void listViewSetCursor(ListView* list, int index) {
+    if (list->count == 0)
+        return;
+    if (index < 0) index = 0;
+    if (index >= list->count) index = list->count - 1;
+    list->cursor = index;
+
+    float top = (float)index * LIST_ROW_HEIGHT;
+    if (top < list->scroll)
+        list->scroll = top;
+    else if (top + LIST_ROW_HEIGHT > list->scroll + list->height)
+        list->scroll = top + LIST_ROW_HEIGHT - list->height;
+    list->velocity = 0.0f;
+    clamp_scroll(list);
+}
+
+void listViewScrollBy(ListView* list, float pixels) {
+    list->scroll += pixels;
+    clamp_scroll(list);
+}
+
+int listViewInput(ListView* list, u32 kDown, u32 kHeld, const touchPosition* touch) {
+    bool inside = touch->px >= list->x && touch->px < list->x + list->width &&
+                  touch->py >= list->y && touch->py < list->y + list->height;
+
+    if ((kDown & KEY_TOUCH) && inside) {
+        list->touching = true;
+        list->dragged = false;
+        list->touchY = touch->py;
+        list->velocity = 0.0f;
+        return -1;
+    }
+
+    if (list->touching && (kHeld & KEY_TOUCH)) {
+        float delta = list->touchY - touch->py;
+        if (fabsf(delta) >= LIST_TAP_SLOP || list->dragged) {
+            list->dragged = true;
+            list->scroll += delta;
+            list->velocity = delta;
+            list->touchY = touch->py;
+            clamp_scroll(list);
+        }
+        return -1;
+    }
+
+    if (list->touching) {
+        // Released: a touch that never moved is a tap on the row under it
+        list->touching = false;
+        if (!list->dragged) {
+            int row = (int)((list->touchY - list->y + list->scroll) / LIST_ROW_HEIGHT);
+            if (row >= 0 && row < list->count) {
+                list->cursor = row;
+                return row;
+            }
+        }
+        return -1;
+    }
+
+    if (list->velocity != 0.0f) {
+        list->scroll += list->velocity;
+        list->velocity *= LIST_FLING_DECAY;
+        if (fabsf(list->velocity) < 0.5f)
+            list->velocity = 0.0f;
+        clamp_scroll(list);
+    }
+    return -1;
+}
+
+bool listViewIsAnimating(const ListView* list) {
+    return list->touching || list->velocity != 0.0f;
+}
+
+void listViewDraw(ListView* list) {
+    if (list->count == 0)
+        return;
+
+    int first = (int)(list->scroll / LIST_ROW_HEIGHT);
+    float rowY = list->y - (list->scroll - (float)first * LIST_ROW_HEIGHT);
+    float bottom = list->y + list->height;
+
+    for (int row = first; row < list->count && rowY < bottom; ++row, rowY += LIST_ROW_HEIGHT) {
+        if (row == list->cursor)
+            C2D_DrawRectSolid(list->x, rowY, 0, list->width, LIST_ROW_HEIGHT, C2D_Color32(0, 90, 150, 255));
+        C2D_DrawText(row_text(list, row), C2D_WithColor, list->x + 4, rowY + 1, 0, LIST_TEXT_SCALE, LIST_TEXT_SCALE,
+            C2D_Color32(255, 255, 255, 255));
+    }
+
+    // Scrollbar, so position in a long library is readable at a glance
+    float total = (float)list->count * LIST_ROW_HEIGHT;
+    if (total > list->height) {
+        float thumb = list->height * list->height / total;
+        if (thumb < LIST_SCROLLBAR_MIN)
+            thumb = LIST_SCROLLBAR_MIN;
+        float thumbY = list->y + (list->height - thumb) * (list->scroll / max_scroll(list));
+        C2D_DrawRectSolid(list->x + list->width - 3, thumbY, 0, 3, thumb, C2D_Color32(160, 160, 160, 255));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef LISTVIEW_H
+#define LISTVIEW_H
+
+#include <3ds.h>
+#include <citro2d.h>
+
+/* Scrolling list that only shapes and draws the rows on screen
+Each row on screen owns one slot from a fixed pool; a slot keeps its own
+small text buffer, so a row scrolling into view is cleared and reparsed
+in place while rows that stay visible are drawn from their shaped text.
+Per-frame cost depends on the view's height, not on the number of entries.
+*/
+
+#define LIST_ROW_HEIGHT   16
+#define LIST_POOL_SIZE    20  // rows in a full-height view plus the partial ones at either edge
+#define LIST_LABEL_LENGTH 96
+
+// Writes the label of row `index` into `label`
+typedef void (*ListLabelFunc)(int index, char* label, int size, void* user);
+
+typedef struct {
+    C2D_TextBuf buf;
+    C2D_Text text;
+    int row;  // row currently shaped into `text`, -1 if none
+} ListSlot;
+
+typedef struct {
+    float x, y, width, height;
+    int count;
+    int cursor;
+    float scroll;    // pixels from the top of row 0
+    float velocity;  // fling speed after a touch drag, pixels per frame
+    ListLabelFunc label;
+    void* user;
+    ListSlot slots[LIST_POOL_SIZE];
+
+    bool touching;
+    bool dragged;
+    float touchY;
+
+    u32 rowsShaped;  // total rows parsed, for profiling
+} ListView;
+
+void listViewInit(ListView* list, float x, float y, float width, float height);
+void listViewExit(ListView* list);
+
+// Replaces the entries; every pooled row is reshaped on the next draw
+void listViewSetSource(ListView* list, int count, ListLabelFunc label, void* user);
+
+// Moves the cursor (clamped) and scrolls just enough to keep it in view
+void listViewSetCursor(ListView* list, int index);
+void listViewScrollBy(ListView* list, float pixels);
+
+// Touch drag and fling; returns the row that was tapped, or -1
+int listViewInput(ListView* list, u32 kDown, u32 kHeld, const touchPosition* touch);
+
+// True while a touch or fling is moving the list, so it needs redrawing every frame
+bool listViewIsAnimating(const ListView* list);
+
+void listViewDraw(ListView* list);
+
+#endif // LISTVIEW_H
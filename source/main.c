@@ -2,31 +2,137 @@
 #include <citro2d.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <tremor/ivorbisfile.h>
 #include <tremor/ivorbiscodec.h>
+#include "art.h"
+#include "boost.h"
+#include "cache.h"
+#include "keyboard.h"
+#include "latency.h"
+#include "listview.h"
+#include "memory.h"
+#include "panel.h"
+#include "playlist.h"
+#include "record.h"
+#include "search.h"
+#include "stats.h"
+#include "trace.h"
+#include "player.h"
 
-#define NUM_TRACKS 3
 #define DEBUG_LOG_LINES 8
 #define DEBUG_LOG_LINE_LENGTH 64
 #define SEEK_BAR_X 40
 #define SEEK_BAR_Y 180
 #define SEEK_BAR_WIDTH 320
 #define SEEK_BAR_HEIGHT 10
-
-// Track names for UI display
-static const char* trackNames[NUM_TRACKS] = {
-    "Track 1",
-    "Track 2",
-    "Track 3"
-};
+#define WAVEFORM_HEIGHT 24
+#define INFO_PANEL_Y 8
+#define INFO_PANEL_HEIGHT 48
+#define INFO_BASELINE 32 // within the info panel
+#define ART_X 8
+#define ART_Y 50
+#define ART_SCALE 0.75f
+#define MOCK_TRACK_LENGTH 180.0f
+#define INPUT_POLL_NS (1000000000LL / 60) // idle input polling, one display frame
+#define LIST_BENCH_ENTRIES 20000
+#define LIST_BENCH_FRAMES 600
+#define LIST_BENCH_SPEED (4 * LIST_ROW_HEIGHT) // pixels per frame, a hard fling
+#define LIST_BENCH_JUMP_EVERY 60               // frames between jumps to a far part of the list
+#define SEARCH_BAR_HEIGHT 20
+#define SEARCH_MAX_RESULTS 2000
+#define SORT_BAR_HEIGHT 16
+#define LATENCY_ENQUEUE_EVERY SYSCLOCK_ARM11 // ticks between enqueue-to-output markers
 
 // Playback state
 static int selectedTrack = 0;
 static bool isPlaying = true;
-static float trackLength = 180.0f; // mock duration in seconds
+static float trackLength = MOCK_TRACK_LENGTH; // mock duration until the player knows better
 static float trackPosition = 0.0f; // current position in seconds
 
+// Track list on the bottom screen; SELECT swaps it for the debug log
+static ListView trackList;
+static bool showDebugLog = false;
+
+// Sort order and smart playlist of the track list; tapping either half of the bar above it cycles one
+static PlayerSort listSort = PLAYER_SORT_LIBRARY;
+static int listPlaylist = -1;        // -1 shows every track
+static const u32* listOrder = NULL;  // row -> track: a presorted ordering, or playlistRows
+static int listCount = 0;
+static u32* playlistRows = NULL;
+static u32 playlistRowCount = 0;
+static bool playlistsLoaded = false;
+static Panel sortPanel;
+static C2D_TextBuf sortTextBuf;
+static C2D_Text sortBarText;
+static C2D_Text listBarText;
+
+// Search mode (B): query line, results and keyboard on the bottom screen
+static bool searchMode = false;
+static char searchText[SEARCH_MAX_QUERY + 1];
+static u32 searchResults[SEARCH_MAX_RESULTS];
+static u32 searchResultCount = 0;
+static u64 searchTicks = 0;
+static ListView searchList;
+static Panel searchPanel;
+static C2D_TextBuf searchTextBuf;
+static C2D_Text searchBarText;
+
+// Scroll benchmark state (X starts it)
+static struct {
+    bool running;
+    int frame;
+    u64 drawTicks;
+    u64 worstDrawTicks;
+    u64 lastFrameTick;
+    int droppedFrames;
+    u32 startShaped;
+} listBench;
+
+// Latency mode (Y on the debug log): markers measure enqueue-to-output and press-to-audible
+static u64 inputTick = 0;  // when this frame's input was read
+static u64 lastEnqueueMarker = 0;
+static struct {
+    u32 count;
+    float total;
+    float worst;
+} latencyStats[2];
+
+// Effects presets (X on the debug log); the last is over the Old 3DS budget and is refused there
+static const struct {
+    const char* name;
+    EffectConfig chain[EFFECTS_MAX_CHAIN];
+    u32 count;
+} effectPresets[] = {
+    { "off", { { 0 } }, 0 },
+    { "bass boost", { { .type = EFFECT_BASS, .gain = 60, .cutoff = 120 } }, 1 },
+    { "wide", { { .type = EFFECT_WIDEN, .width = 150 } }, 1 },
+    { "loud", { { .type = EFFECT_BASS, .gain = 40, .cutoff = 100 },
+                { .type = EFFECT_COMPRESSOR, .threshold = 120, .ratio = 4 } }, 2 },
+    { "all", { { .type = EFFECT_BASS, .gain = 40, .cutoff = 100 }, { .type = EFFECT_WIDEN, .width = 130 },
+               { .type = EFFECT_COMPRESSOR, .threshold = 10, .ratio = 0 } }, 3 },
+};
+static int effectPreset = 0;
+
+// Memory pressure as of the last frame, to log changes
+static MemoryPressure lastPressure = MEMORY_PRESSURE_NONE;
+
+// Redraw state: the loop only renders when something visible changed
+static bool forceRender = true;
+static int lastSeekPixel = -1;
+static bool lastPlayerActive = false;
+
+// Panels cached in textures, re-rendered only when their contents change
+static Panel infoPanel;
+static Panel waveformPanel;
+static Panel logPanel;
+static C2D_TextBuf topTextBuf;
+static C2D_TextBuf botTextBuf;
+static C2D_Text topText;
+static C2D_Text debugTexts[DEBUG_LOG_LINES];
+static char playbackInfo[128];
+
 // Debug log buffer
 static char debugLog[DEBUG_LOG_LINES][DEBUG_LOG_LINE_LENGTH];
 static int debugLogIndex = 0;
@@ -38,15 +144,30 @@ static void debug_log(const char* fmt, ...) {
     vsnprintf(debugLog[debugLogIndex], DEBUG_LOG_LINE_LENGTH, fmt, args);
     va_end(args);
     debugLogIndex = (debugLogIndex + 1) % DEBUG_LOG_LINES;
+    panelInvalidate(&logPanel);
 }
 
-// Render debug log lines on bottom screen
-static void render_debug_log(C2D_TextBuf buf, C2D_Text* texts) {
+// Render debug log lines into the log panel
+static void render_debug_log(void* user) {
+    C2D_TextBufClear(botTextBuf);
     for (int i = 0; i < DEBUG_LOG_LINES; ++i) {
         int idx = (debugLogIndex + i) % DEBUG_LOG_LINES;
-        C2D_TextParse(&texts[i], buf, debugLog[idx]);
-        C2D_TextOptimize(&texts[i]);
-        C2D_DrawText(&texts[i], C2D_AtBaseline | C2D_WithColor, 8, 10 + i * 16, 1.0f, 1.0f, 1.0f, C2D_Color32(255, 255, 255, 255));
+        C2D_TextParse(&debugTexts[i], botTextBuf, debugLog[idx]);
+        C2D_TextOptimize(&debugTexts[i]);
+        C2D_DrawText(&debugTexts[i], C2D_AtBaseline | C2D_WithColor, 8, 10 + i * 16, 1.0f, 1.0f, 1.0f, C2D_Color32(255, 255, 255, 255));
+    }
+}
+
+// Draw the precomputed peak overview into the waveform panel
+static void draw_waveform(void* user) {
+    const unsigned char* waveform = playerTrackWaveform(selectedTrack);
+    if (!waveform)
+        return;
+
+    float barWidth = (float)SEEK_BAR_WIDTH / PLAYER_WAVEFORM_POINTS;
+    for (int i = 0; i < PLAYER_WAVEFORM_POINTS; ++i) {
+        float height = WAVEFORM_HEIGHT * waveform[i] / 255.0f;
+        C2D_DrawRectSolid(i * barWidth, WAVEFORM_HEIGHT - height, 0, barWidth - 1, height, C2D_Color32(0, 90, 150, 255));
     }
 }
 
@@ -69,33 +190,389 @@ static void draw_seek_bar(float position, float length) {
     }
 }
 
-// Draw current track and playback status on top screen
-static void draw_playback_info(C2D_TextBuf buf, C2D_Text* text) {
-    char info[128];
+// Format current track and playback status; the info panel is only redrawn when the text changes
+static void update_playback_info(void) {
+    char info[sizeof(playbackInfo)];
     snprintf(info, sizeof(info),
         "%s [%s] %02d:%02d / %02d:%02d",
-        trackNames[selectedTrack],
+        playerTrackTitle(selectedTrack),
         isPlaying ? "Playing" : "Paused",
         (int)(trackPosition / 60), (int)((int)trackPosition % 60),
         (int)(trackLength / 60), (int)((int)trackLength % 60)
     );
 
-    C2D_TextParse(text, buf, info);
-    C2D_TextOptimize(text);
-    C2D_DrawText(text, C2D_AtBaseline | C2D_WithColor, 8, 40, 1.0f, 1.0f, 1.0f, C2D_Color32(255, 255, 0, 255));
+    if (strcmp(info, playbackInfo) != 0) {
+        strcpy(playbackInfo, info);
+        panelInvalidate(&infoPanel);
+    }
+}
+
+// Progress bar width in whole pixels; redrawing for anything smaller would be invisible
+static int seek_bar_pixel(void) {
+    if (trackLength <= 0.0f)
+        return 0;
+    float ratio = trackPosition / trackLength;
+    return (int)(SEEK_BAR_WIDTH * (ratio > 1.0f ? 1.0f : ratio));
+}
+
+// Returning from the HOME menu or sleep needs a fresh frame even if nothing else changed
+static void on_apt_event(APT_HookType hook, void* param) {
+    if (hook == APTHOOK_ONRESTORE || hook == APTHOOK_ONWAKEUP)
+        forceRender = true;
+}
+
+/* Decides whether this iteration draws a frame
+Input, a list animation or benchmark, a finished album art job, a player
+state change, a dirty panel or the seek bar moving a whole pixel all count.
+The playback text itself changes once a second via update_playback_info.
+*/
+static bool needs_render(u32 kDown, u32 kHeld, u32 kUp, bool artChanged) {
+    bool render = forceRender || artChanged || kDown || kHeld || kUp;
+    render |= listBench.running || listViewIsAnimating(&trackList) || listViewIsAnimating(&searchList);
+    render |= infoPanel.dirty || waveformPanel.dirty || (showDebugLog && logPanel.dirty) || (searchMode && searchPanel.dirty);
+    render |= sortPanel.dirty && !showDebugLog && !searchMode;
+
+    int seekPixel = seek_bar_pixel();
+    render |= seekPixel != lastSeekPixel;
+    lastSeekPixel = seekPixel;
+
+    bool playerActive = playerIsPlaying();
+    render |= playerActive != lastPlayerActive;
+    lastPlayerActive = playerActive;
+
+    forceRender = false;
+    return render;
+}
+
+static void draw_playback_info(void* user) {
+    C2D_TextBufClear(topTextBuf);
+    C2D_TextParse(&topText, topTextBuf, playbackInfo);
+    C2D_TextOptimize(&topText);
+    C2D_DrawText(&topText, C2D_AtBaseline | C2D_WithColor, 8, INFO_BASELINE, 1.0f, 1.0f, 1.0f, C2D_Color32(255, 255, 0, 255));
+}
+
+static int list_track(int row) {
+    return listOrder ? (int)listOrder[row] : row;
+}
+
+static void track_label(int track, char* label, int size) {
+    const char* artist = playerTrackArtist(track);
+    if (artist[0])
+        snprintf(label, size, "%s - %s", playerTrackTitle(track), artist);
+    else
+        snprintf(label, size, "%s", playerTrackTitle(track));
+}
+
+static void library_label(int index, char* label, int size, void* user) {
+    int track = list_track(index);
+    if (listSort == PLAYER_SORT_LIBRARY && listPlaylist < 0) {
+        int prefix = snprintf(label, size, "%d. ", track + 1);
+        track_label(track, label + prefix, size - prefix);
+    } else {
+        track_label(track, label, size);
+    }
+}
+
+static void search_label(int index, char* label, int size, void* user) {
+    track_label(searchResults[index], label, size);
+}
+
+static void bench_label(int index, char* label, int size, void* user) {
+    snprintf(label, size, "%05d Benchmark Artist %d - Album %d", index + 1, index % 97, index % 13);
+}
+
+// Copy clock boost transitions and per-track summaries into the debug log
+static void log_boost_events(void) {
+    BoostEvent event;
+    while (boostPollEvent(&event)) {
+        if (event.type == BOOST_EVENT_TRACK_SUMMARY)
+            debug_log("Boost: %s on %lux, %.0fs of %.0fs", playerTrackTitle(event.track), (unsigned long)event.boosts,
+                event.boostedSeconds, event.playedSeconds);
+        else
+            debug_log("Boost %s at %.0fs: %.2fx realtime, %.0f%% queued", event.type == BOOST_EVENT_ON ? "on" : "off",
+                event.playedSeconds, event.realtime, event.fill * 100.0f);
+    }
+}
+
+// Caches are given back inside memoryUpdate; the log only notes each change of pressure
+static void update_memory(void) {
+    static const char* const levels[] = { "ok", "low", "critical" };
+    MemoryPressure pressure = memoryUpdate();
+    if (pressure == lastPressure)
+        return;
+    lastPressure = pressure;
+
+    u32 heap, linear;
+    memoryGetFree(&heap, &linear);
+    debug_log("Memory %s: heap %lu KiB, linear %lu KiB free", levels[pressure], (unsigned long)(heap / 1024),
+        (unsigned long)(linear / 1024));
+}
+
+// Row of a track in the list, or -1 if the current playlist doesn't have it
+static int list_row(int track) {
+    if (listPlaylist < 0)
+        return (int)playerSortPosition(listSort, track);
+    for (u32 i = 0; i < playlistRowCount; ++i) {
+        if ((int)playlistRows[i] == track)
+            return i;
+    }
+    return -1;
+}
+
+// Measures from this frame's input to the first audio a press makes the player queue
+static void mark_press(void) {
+    if (latencyIsActive())
+        latencyArm(LATENCY_PRESS, inputTick);
+}
+
+// Point the display at a track from its start and pick up its real length if the player has it
+static void show_track(int index) {
+    selectedTrack = index;
+    trackPosition = 0.0f;
+    artRequest(selectedTrack);
+    panelInvalidate(&waveformPanel);
+    int row = list_row(selectedTrack);
+    if (!listBench.running && row >= 0)
+        listViewSetCursor(&trackList, row);
+
+    float length = playerTrackLength(selectedTrack);
+    trackLength = length > 0.0f ? length : MOCK_TRACK_LENGTH;
+}
+
+// Start playing a track
+static void select_track(int index) {
+    isPlaying = true;
+    mark_press();
+    playerPlay(index);
+    show_track(index);
+    debug_log("Selected track: %s", playerTrackTitle(selectedTrack));
+}
+
+// Next effects preset; a refused one is logged with the reason and the chain stays as it was
+static void cycle_effects(void) {
+    int count = sizeof(effectPresets) / sizeof(effectPresets[0]);
+    effectPreset = (effectPreset + 1) % count;
+    char error[48];
+    if (playerSetEffects(effectPresets[effectPreset].chain, effectPresets[effectPreset].count, error, sizeof(error)))
+        debug_log("Effects: %s, %lu cycles/frame", effectPresets[effectPreset].name,
+            (unsigned long)effectsChainCost());
+    else
+        debug_log("Effects %s refused: %s", effectPresets[effectPreset].name, error);
+}
+
+static void toggle_latency_mode(void) {
+    if (latencyIsActive()) {
+        latencyStop();
+        debug_log("Latency mode off");
+        return;
+    }
+    memset(latencyStats, 0, sizeof(latencyStats));
+    lastEnqueueMarker = 0;
+    debug_log(latencyStart() ? "Latency mode: switch or seek to measure" : "Latency mode: no memory for capture");
+}
+
+static void update_latency(void) {
+    if (!latencyIsActive())
+        return;
+
+    LatencyResult result;
+    while (latencyPollResult(&result)) {
+        static const char* const names[2] = { "queue->out", "press->audible" };
+        latencyStats[result.kind].count++;
+        latencyStats[result.kind].total += result.ms;
+        if (result.ms > latencyStats[result.kind].worst)
+            latencyStats[result.kind].worst = result.ms;
+        debug_log("%s %.1f ms (avg %.1f, worst %.1f)", names[result.kind], result.ms,
+            latencyStats[result.kind].total / latencyStats[result.kind].count, latencyStats[result.kind].worst);
+    }
+
+    // Nothing in flight: time the queue again once in a while
+    if (playerIsPlaying() && inputTick - lastEnqueueMarker > LATENCY_ENQUEUE_EVERY &&
+        latencyArm(LATENCY_ENQUEUE, 0))
+        lastEnqueueMarker = inputTick;
+}
+
+// Next or previous track in the list's current order
+static void step_track(int direction) {
+    if (listCount == 0)
+        return;
+    int row = list_row(selectedTrack);
+    if (row < 0)
+        row = direction > 0 ? -1 : 0;
+    select_track(list_track((row + direction + listCount) % listCount));
+}
+
+// Points the list at every track in sort order, or at the playlist's rows
+static void show_list(void) {
+    if (listPlaylist < 0) {
+        listOrder = playerSortOrder(listSort);
+        listCount = playerTrackCount();
+    } else {
+        listOrder = playlistRows;
+        listCount = playlistRowCount;
+    }
+    listViewSetSource(&trackList, listCount, library_label, NULL);
+    int row = list_row(selectedTrack);
+    if (row >= 0)
+        listViewSetCursor(&trackList, row);
+}
+
+static void draw_sort_bar(void* user) {
+    char sort[32], list[48];
+    snprintf(sort, sizeof(sort), "Sort: %s", playerSortName(listSort));
+    snprintf(list, sizeof(list), "List: %s", listPlaylist < 0 ? "All tracks" : playlistName(listPlaylist));
+
+    C2D_TextBufClear(sortTextBuf);
+    C2D_TextParse(&sortBarText, sortTextBuf, sort);
+    C2D_TextParse(&listBarText, sortTextBuf, list);
+    C2D_TextOptimize(&sortBarText);
+    C2D_TextOptimize(&listBarText);
+    C2D_DrawText(&sortBarText, C2D_WithColor, 4, 1, 0, 0.5f, 0.5f, C2D_Color32(255, 255, 0, 255));
+    C2D_DrawText(&listBarText, C2D_WithColor, 164, 1, 0, 0.5f, 0.5f, C2D_Color32(255, 255, 0, 255));
+}
+
+/* Switches the track list to the next sort order
+The orderings are presorted (see collate.h), so this swaps the list's row to
+track mapping and reshapes the visible rows; search results are reordered
+by their precomputed ranks.
+*/
+static void cycle_sort(void) {
+    u64 start = svcGetSystemTick();
+    listSort = (PlayerSort)((listSort + 1) % PLAYER_SORT_COUNT);
+    playerSortTracks(listSort, playlistRows, playlistRowCount);
+    show_list();
+    playerSortTracks(listSort, searchResults, searchResultCount);
+    u64 ticks = svcGetSystemTick() - start;
+
+    panelInvalidate(&sortPanel);
+    debug_log("Sort: %s (%.3f ms)", playerSortName(listSort), ticks / (SYSCLOCK_ARM11 / 1000.0));
+}
+
+/* Switches the track list to the next smart playlist, then back to every track
+Playlists are loaded and compiled on first use, which also builds the
+player's metadata columns. After that a switch only runs the compiled
+program, then orders its rows like the rest of the list.
+*/
+static void cycle_playlist(void) {
+    if (!playlistsLoaded) {
+        u64 start = svcGetSystemTick();
+        playlistLoad(PLAYLIST_PATH, playerFilterColumns());
+        debug_log("Playlists: %d loaded (%.2f ms)", playlistCount(), (svcGetSystemTick() - start) / (SYSCLOCK_ARM11 / 1000.0));
+        for (int i = 0; i < playlistCount(); ++i) {
+            if (playlistError(i))
+                debug_log("  %s: %s", playlistName(i), playlistError(i));
+        }
+        playlistRows = (u32*)malloc(playerTrackCount() * sizeof(u32));
+        playlistsLoaded = true;
+    }
+
+    listPlaylist = listPlaylist + 1 < playlistCount() && playlistRows ? listPlaylist + 1 : -1;
+    if (listPlaylist >= 0) {
+        u64 start = svcGetSystemTick();
+        playlistRowCount = playlistRun(listPlaylist, playlistRows, playerTrackCount());
+        u64 runTicks = svcGetSystemTick() - start;
+        playerSortTracks(listSort, playlistRows, playlistRowCount);
+        debug_log("Playlist %s: %lu tracks (%.2f ms)", playlistName(listPlaylist), (unsigned long)playlistRowCount,
+            runTicks / (SYSCLOCK_ARM11 / 1000.0));
+    }
+    show_list();
+    panelInvalidate(&sortPanel);
+}
+
+// Query line with the match count and how long the lookup took
+static void draw_search_bar(void* user) {
+    char line[SEARCH_MAX_QUERY + 64];
+    if (searchText[0])
+        snprintf(line, sizeof(line), "Find: %s_  %lu%s (%.2f ms)", searchText, (unsigned long)searchResultCount,
+            searchResultCount == SEARCH_MAX_RESULTS ? "+" : "", searchTicks / (SYSCLOCK_ARM11 / 1000.0));
+    else
+        snprintf(line, sizeof(line), "Find: _  (title, artist or album)");
+
+    C2D_TextBufClear(searchTextBuf);
+    C2D_TextParse(&searchBarText, searchTextBuf, line);
+    C2D_TextOptimize(&searchBarText);
+    C2D_DrawText(&searchBarText, C2D_WithColor, 4, 2, 0, 0.55f, 0.55f, C2D_Color32(255, 255, 0, 255));
 }
-// Add missing declarations for playing and vf
-static bool playing = false;
 
-// Dummy struct for vf, replace with actual type if using libvorbisfile
-// Use the actual OggVorbis_File struct from the Tremor library
+// Runs on every key press; an empty query shows no results rather than the whole library
+static void run_search(void) {
+    u64 start = svcGetSystemTick();
+    searchResultCount = searchText[0] ? playerSearch(searchText, searchResults, SEARCH_MAX_RESULTS) : 0;
+    playerSortTracks(listSort, searchResults, searchResultCount);
+    searchTicks = svcGetSystemTick() - start;
+    listViewSetSource(&searchList, searchResultCount, search_label, NULL);
+    panelInvalidate(&searchPanel);
+}
 
-static OggVorbis_File vf;
+static void search_input(u32 kDown, u32 kHeld, u32 kRepeat, const touchPosition* touch) {
+    char key = keyboardInput(0, 240 - KEYBOARD_HEIGHT, kDown, touch);
+    size_t length = strlen(searchText);
+    if (key == KEYBOARD_BACKSPACE && length > 0) {
+        searchText[length - 1] = '\0';
+        run_search();
+    } else if (key && key != KEYBOARD_BACKSPACE && length < SEARCH_MAX_QUERY) {
+        searchText[length] = key;
+        searchText[length + 1] = '\0';
+        run_search();
+    }
 
-bool playerIsPlaying(void) {
-    return playing;
+    if (kRepeat & KEY_DUP)
+        listViewSetCursor(&searchList, searchList.cursor - 1);
+    if (kRepeat & KEY_DDOWN)
+        listViewSetCursor(&searchList, searchList.cursor + 1);
+    int tapped = listViewInput(&searchList, kDown, kHeld, touch);
+    if (tapped >= 0 || ((kDown & KEY_Y) && searchResultCount > 0))
+        select_track(searchResults[tapped >= 0 ? tapped : searchList.cursor]);
 }
+
+/* List scroll benchmark
+Swaps the library for LIST_BENCH_ENTRIES synthetic rows and scrolls through
+them at fling speed, jumping far ahead every second, while timing the list's
+draw and counting frames that missed vsync. Results go to the debug log.
+*/
+static void list_bench_start(void) {
+    listViewSetSource(&trackList, LIST_BENCH_ENTRIES, bench_label, NULL);
+    memset(&listBench, 0, sizeof(listBench));
+    listBench.running = true;
+    listBench.startShaped = trackList.rowsShaped;
+    showDebugLog = false;
+}
+
+static void list_bench_step(void) {
+    if (listBench.frame % LIST_BENCH_JUMP_EVERY == LIST_BENCH_JUMP_EVERY - 1)
+        listViewSetCursor(&trackList, (int)((listBench.frame * 7919u) % LIST_BENCH_ENTRIES));
+    else
+        listViewScrollBy(&trackList, LIST_BENCH_SPEED);
+}
+
+static void list_bench_frame(u64 drawTicks) {
+    u64 now = svcGetSystemTick();
+    if (listBench.lastFrameTick && now - listBench.lastFrameTick > SYSCLOCK_ARM11 / 60 * 5 / 4)
+        listBench.droppedFrames++;
+    listBench.lastFrameTick = now;
+
+    listBench.drawTicks += drawTicks;
+    if (drawTicks > listBench.worstDrawTicks)
+        listBench.worstDrawTicks = drawTicks;
+    if (++listBench.frame < LIST_BENCH_FRAMES)
+        return;
+
+    const double ticksPerMs = SYSCLOCK_ARM11 / 1000.0;
+    debug_log("List bench: %d rows, %d frames", LIST_BENCH_ENTRIES, LIST_BENCH_FRAMES);
+    debug_log("  draw avg %.3f ms worst %.3f ms", listBench.drawTicks / ticksPerMs / LIST_BENCH_FRAMES,
+        listBench.worstDrawTicks / ticksPerMs);
+    debug_log("  %d dropped, %.1f rows shaped/frame", listBench.droppedFrames,
+        (double)(trackList.rowsShaped - listBench.startShaped) / LIST_BENCH_FRAMES);
+
+    listBench.running = false;
+    show_list();
+    showDebugLog = true;
+}
+
 int main() {
+    TRACE_THREAD("main");
+    statsStart();
+
     // Initialize services and graphics
     gfxInitDefault();
     C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
@@ -107,15 +584,41 @@ int main() {
     C3D_RenderTarget* botTarget = C2D_CreateScreenTarget(GFX_BOTTOM, GFX_LEFT);
 
     // Text buffers for UI and debug log
-    C2D_TextBuf topTextBuf = C2D_TextBufNew(256);
-    C2D_TextBuf botTextBuf = C2D_TextBufNew(1024);
-
-    C2D_Text topText;
-    C2D_Text debugTexts[DEBUG_LOG_LINES];
+    topTextBuf = C2D_TextBufNew(256);
+    botTextBuf = C2D_TextBufNew(1024);
+
+    // Off-screen panels for the parts that only change on events
+    panelInit(&infoPanel, 400, INFO_PANEL_HEIGHT, C2D_Color32(0, 0, 0, 0), draw_playback_info, NULL);
+    panelInit(&waveformPanel, SEEK_BAR_WIDTH, WAVEFORM_HEIGHT, C2D_Color32(0, 0, 0, 0), draw_waveform, NULL);
+    panelInit(&logPanel, 320, 240, C2D_Color32(16, 16, 16, 255), render_debug_log, NULL);
+    searchTextBuf = C2D_TextBufNew(128);
+    panelInit(&searchPanel, 320, SEARCH_BAR_HEIGHT, C2D_Color32(32, 32, 32, 255), draw_search_bar, NULL);
+    sortTextBuf = C2D_TextBufNew(96);
+    panelInit(&sortPanel, 320, SORT_BAR_HEIGHT, C2D_Color32(32, 32, 32, 255), draw_sort_bar, NULL);
+    keyboardInit();
 
     // Initialize debug log with startup message
     debug_log("Application started");
 
+    cacheInit(CACHE_DIR, CACHE_DEFAULT_BUDGET);
+    playerInit();
+    artInit();
+    debug_log("Library: %d tracks, cache %lu KiB", playerTrackCount(), (unsigned long)(cacheUsedBytes() / 1024));
+    listViewInit(&trackList, 0, SORT_BAR_HEIGHT, 320, 240 - SORT_BAR_HEIGHT);
+    show_list();
+    listViewInit(&searchList, 0, SEARCH_BAR_HEIGHT, 320, 240 - SEARCH_BAR_HEIGHT - KEYBOARD_HEIGHT);
+    hidSetRepeatParameters(20, 4);
+    if (playerTrackCount() > 0)
+        select_track(0);
+
+    aptHookCookie aptCookie;
+    aptHook(&aptCookie, on_apt_event, NULL);
+
+    // Holding L+R at launch records the session's input for tools/replay.c
+    hidScanInput();
+    if ((hidKeysHeld() & (KEY_L | KEY_R)) == (KEY_L | KEY_R))
+        debug_log(recordStart(RECORD_PATH) ? "Recording input" : "Cannot record input");
+
     // Variables for timing playback updates
     u64 lastTick = svcGetSystemTick();
     const u64 ticksPerSecond = 268123480; // approximate ticks per second on 3DS
@@ -123,29 +626,71 @@ int main() {
     // Main loop
     while (aptMainLoop()) {
         hidScanInput();
+        inputTick = svcGetSystemTick();
         u32 kDown = hidKeysDown();
         u32 kHeld = hidKeysHeld();
+        u32 kUp = hidKeysUp();
+        u32 kRepeat = hidKeysDownRepeat();
+        touchPosition touch;
+        hidTouchRead(&touch);
+        recordFrame(kDown, kHeld, kUp, kRepeat, &touch);
+        int numTracks = playerTrackCount();
 
         if (kDown & KEY_START)
             break;
 
         // Track switching (left/right d-pad)
-        if (kDown & KEY_DRIGHT) {
-            selectedTrack = (selectedTrack + 1) % NUM_TRACKS;
-            trackPosition = 0.0f;
-            debug_log("Selected track: %s", trackNames[selectedTrack]);
+        if ((kDown & KEY_DRIGHT) && numTracks > 0)
+            step_track(1);
+        if ((kDown & KEY_DLEFT) && numTracks > 0)
+            step_track(-1);
+
+        // Search mode: typing on the keyboard refines the results on every key press
+        if ((kDown & KEY_B) && !listBench.running) {
+            searchMode = !searchMode;
+            showDebugLog = false;
         }
-        if (kDown & KEY_DLEFT) {
-            selectedTrack = (selectedTrack + NUM_TRACKS - 1) % NUM_TRACKS;
-            trackPosition = 0.0f;
-            debug_log("Selected track: %s", trackNames[selectedTrack]);
+
+        // Track list: d-pad up/down moves the cursor, Y or a tap plays
+        if (searchMode && !listBench.running) {
+            if (!showDebugLog)
+                search_input(kDown, kHeld, kRepeat, &touch);
+        } else if (!listBench.running) {
+            if (kRepeat & KEY_DUP)
+                listViewSetCursor(&trackList, trackList.cursor - 1);
+            if (kRepeat & KEY_DDOWN)
+                listViewSetCursor(&trackList, trackList.cursor + 1);
+            int tapped = showDebugLog ? -1 : listViewInput(&trackList, kDown, kHeld, &touch);
+            if (tapped >= 0 || ((kDown & KEY_Y) && listCount > 0 && !showDebugLog))
+                select_track(list_track(tapped >= 0 ? tapped : trackList.cursor));
+            if (!showDebugLog && (kDown & KEY_TOUCH) && touch.py < SORT_BAR_HEIGHT && numTracks > 0) {
+                if (touch.px < 160)
+                    cycle_sort();
+                else
+                    cycle_playlist();
+            }
+            if ((kDown & KEY_X) && showDebugLog)
+                cycle_effects();
+            else if (kDown & KEY_X)
+                list_bench_start();
+        } else {
+            list_bench_step();
         }
+        if (kDown & KEY_SELECT)
+            showDebugLog = !showDebugLog;
+        else if ((kDown & KEY_Y) && showDebugLog)
+            toggle_latency_mode();
 
-        // Play/pause toggle (A button)
+        // Play/pause toggle (A button); the resume is logged once the DSP is playing again
         if (kDown & KEY_A) {
             isPlaying = !isPlaying;
-            debug_log(isPlaying ? "Playback resumed" : "Playback paused");
+            playerPause(!isPlaying);
+            if (!isPlaying)
+                debug_log("Playback paused");
         }
+        float resumeMs;
+        if (playerPollResumeLatency(&resumeMs))
+            debug_log("Playback resumed in %.1f ms", resumeMs);
 
         // Seek control (L/R held)
         if (kHeld & KEY_L) {
@@ -158,41 +703,127 @@ int main() {
             if (trackPosition > trackLength)
                 trackPosition = trackLength;
         }
+        // Apply the seek once the shoulder button is released
+        if (kUp & (KEY_L | KEY_R)) {
+            mark_press();
+            playerSeek(trackPosition);
+        }
 
         // Playback simulation with timing independent from frame rate
         u64 currentTick = svcGetSystemTick();
         double deltaSeconds = (double)(currentTick - lastTick) / (double)ticksPerSecond;
         lastTick = currentTick;
 
+        // A CUE track ran into the next one of its file without a gap: follow what is heard
+        int heardTrack = playerCurrentTrack();
+        if (heardTrack >= 0 && heardTrack != selectedTrack) {
+            show_track(heardTrack);
+            debug_log("Now playing: %s", playerTrackTitle(selectedTrack));
+        }
+
         if (isPlaying) {
             trackPosition += (float)deltaSeconds;
+            // Held at the end while the player still sounds, which the next CUE track of a file does
             if (trackPosition >= trackLength) {
                 trackPosition = trackLength;
-                isPlaying = false;
-                debug_log("Track ended");
+                if (!playerIsPlaying()) {
+                    isPlaying = false;
+                    debug_log("Track ended");
+                }
             }
         }
 
-        // Start drawing top screen
+        // Release memory before anything this frame allocates
+        update_memory();
+
+        // Switch the New 3DS clock boost if decoding fell behind or caught up
+        boostUpdate();
+        log_boost_events();
+        update_latency();
+
+        // Pick up cover art the background job has finished
+        bool artChanged = artUpdate();
+
+        update_playback_info();
+
+        // Nothing visible changed: sleep until the next input poll, leaving the core to decoding
+        if (!needs_render(kDown, kHeld, kUp, artChanged)) {
+            svcSleepThread(INPUT_POLL_NS);
+            continue;
+        }
+
+        // Re-render panels whose contents changed, then start drawing top screen
+        TRACE_BEGIN(frameTrace, "frame");
+        u64 updateTicks = svcGetSystemTick() - inputTick;
         C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
+        u64 renderStart = svcGetSystemTick();  // after the vsync wait
+        panelRender(&infoPanel);
+        panelRender(&waveformPanel);
+        if (showDebugLog)
+            panelRender(&logPanel);
+        if (searchMode) {
+            panelRender(&searchPanel);
+            keyboardRender();
+        } else if (!showDebugLog) {
+            panelRender(&sortPanel);
+        }
+
         C2D_TargetClear(topTarget, C2D_Color32(0, 0, 0, 255));
         C2D_SceneBegin(topTarget);
 
-        draw_playback_info(topTextBuf, &topText);
+        panelDraw(&infoPanel, 0, INFO_PANEL_Y);
+        C2D_Image cover;
+        if (artGetImage(&cover))
+            C2D_DrawImageAt(cover, ART_X, ART_Y, 0, NULL, ART_SCALE, ART_SCALE);
+        panelDraw(&waveformPanel, SEEK_BAR_X, SEEK_BAR_Y - 6 - WAVEFORM_HEIGHT);
         draw_seek_bar(trackPosition, trackLength);
 
-        // Start drawing bottom screen (debug log)
+        // Start drawing bottom screen (track list or debug log)
         C2D_TargetClear(botTarget, C2D_Color32(16, 16, 16, 255));
         C2D_SceneBegin(botTarget);
-        render_debug_log(botTextBuf, debugTexts);
+        if (showDebugLog) {
+            panelDraw(&logPanel, 0, 0);
+        } else if (searchMode) {
+            panelDraw(&searchPanel, 0, 0);
+            listViewDraw(&searchList);
+            keyboardDraw(0, 240 - KEYBOARD_HEIGHT);
+        } else {
+            panelDraw(&sortPanel, 0, 0);
+            u64 drawStart = svcGetSystemTick();
+            listViewDraw(&trackList);
+            if (listBench.running)
+                list_bench_frame(svcGetSystemTick() - drawStart);
+        }
 
         // Finish frame and swap buffers
         C3D_FrameEnd(0);
+        TRACE_END(frameTrace);
+        statsFrame(updateTicks + svcGetSystemTick() - renderStart);
         gfxSwapBuffers();
         gfxFlushBuffers();
     }
 
     // Cleanup resources
+    latencyStop();
+    statsWrite(STATS_PATH);
+    traceWrite(TRACE_PATH);
+    recordStop();
+    aptUnhook(&aptCookie);
+    artExit();
+    playerExit();
+    listViewExit(&trackList);
+    listViewExit(&searchList);
+    keyboardExit();
+    panelExit(&searchPanel);
+    C2D_TextBufDelete(searchTextBuf);
+    panelExit(&sortPanel);
+    C2D_TextBufDelete(sortTextBuf);
+    playlistExit();
+    free(playlistRows);
+    panelExit(&infoPanel);
+    panelExit(&waveformPanel);
+    panelExit(&logPanel);
+    cacheExit();
     C2D_TextBufDelete(topTextBuf);
     C2D_TextBufDelete(botTextBuf);
     C2D_Fini();
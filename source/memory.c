@@ -0,0 +1,104 @@
+#include "memory.h"
+
+#include <string.h>
+#ifdef __3DS__
+#include <malloc.h>
+
+extern u32 __ctru_heap_size;
+#endif
+
+typedef struct {
+    MemoryPriority priority;
+    MemoryReleaseFunc release;
+    void* user;
+} Subscriber;
+
+static struct {
+    Subscriber subscribers[MEMORY_MAX_SUBSCRIBERS];  // sorted by priority, in subscription order within one
+    u32 count;
+    volatile MemoryPressure pressure;
+    u32 heapFree;
+    u32 linearFree;
+    u32 released;
+} memory;
+
+/* Free bytes in both pools
+The heap's free space is what newlib hasn't taken from the application heap
+yet plus the free chunks inside what it has; linear memory is libctru's own
+count. On a PC the figures come from the host layer, which tools set.
+*/
+static void measure(void) {
+#ifdef __3DS__
+    struct mallinfo info = mallinfo();
+    memory.heapFree = __ctru_heap_size - info.arena + info.fordblks;
+#else
+    memory.heapFree = hostHeapFree();
+#endif
+    memory.linearFree = linearSpaceFree();
+}
+
+static MemoryPressure pressure_now(void) {
+    if (memory.heapFree < MEMORY_HEAP_CRITICAL || memory.linearFree < MEMORY_LINEAR_CRITICAL)
+        return MEMORY_PRESSURE_CRITICAL;
+    if (memory.heapFree < MEMORY_HEAP_LOW || memory.linearFree < MEMORY_LINEAR_LOW)
+        return MEMORY_PRESSURE_LOW;
+    return MEMORY_PRESSURE_NONE;
+}
+
+bool memorySubscribe(MemoryPriority priority, MemoryReleaseFunc release, void* user) {
+    if (memory.count == MEMORY_MAX_SUBSCRIBERS)
+        return false;
+
+    u32 at = memory.count;
+    while (at > 0 && memory.subscribers[at - 1].priority > priority) {
+        memory.subscribers[at] = memory.subscribers[at - 1];
+        at--;
+    }
+    memory.subscribers[at] = (Subscriber){ priority, release, user };
+    memory.count++;
+    return true;
+}
+
+void memoryUnsubscribe(MemoryReleaseFunc release, void* user) {
+    for (u32 i = 0; i < memory.count; ++i) {
+        if (memory.subscribers[i].release == release && memory.subscribers[i].user == user) {
+            memmove(&memory.subscribers[i], &memory.subscribers[i + 1], (memory.count - i - 1) * sizeof(Subscriber));
+            memory.count--;
+            return;
+        }
+    }
+}
+
+MemoryPressure memoryUpdate(void) {
+    measure();
+    MemoryPressure pressure = pressure_now();
+
+    // Subscribers may unsubscribe while releasing (latencyStop does), so walk a copy
+    Subscriber subscribers[MEMORY_MAX_SUBSCRIBERS];
+    u32 count = memory.count;
+    memcpy(subscribers, memory.subscribers, count * sizeof(Subscriber));
+    for (u32 i = 0; i < count && pressure != MEMORY_PRESSURE_NONE; ++i) {
+        u32 freed = subscribers[i].release(pressure, subscribers[i].user);
+        if (freed == 0)
+            continue;
+        memory.released += freed;
+        measure();
+        pressure = pressure_now();
+    }
+
+    memory.pressure = pressure;
+    return pressure;
+}
+
+MemoryPressure memoryPressure(void) {
+    return memory.pressure;
+}
+
+void memoryGetFree(u32* heap, u32* linear) {
+    *heap = memory.heapFree;
+    *linear = memory.linearFree;
+}
+
+u32 memoryReleased(void) {
+    return memory.released;
+}
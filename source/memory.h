@@ -0,0 +1,56 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <3ds.h>
+
+/* Memory pressure
+Free heap and free linear memory are measured once per frame against a low
+and a critical mark each. Under pressure, everything holding memory it can
+do without is asked to give it back, lowest priority value first, and free
+memory is measured again after each so the release stops as soon as both
+pools are back above their low marks. Allocations that can be put off (art
+decoding, the latency capture ring) check memoryPressure first and skip
+the work instead of being the allocation that fails.
+
+Subscribers decide how much to give at each level: optional caches go at
+LOW, the playback queue only at CRITICAL and always after everything else,
+since shrinking it is the one release that can be heard.
+*/
+
+#define MEMORY_HEAP_LOW        (2 * 1024 * 1024)
+#define MEMORY_HEAP_CRITICAL   (512 * 1024)
+#define MEMORY_LINEAR_LOW      (1024 * 1024)
+#define MEMORY_LINEAR_CRITICAL (256 * 1024)
+#define MEMORY_MAX_SUBSCRIBERS 8
+
+typedef enum {
+    MEMORY_PRESSURE_NONE,
+    MEMORY_PRESSURE_LOW,       // below a low mark: drop what can be rebuilt
+    MEMORY_PRESSURE_CRITICAL,  // below a critical mark: also shrink what playback uses
+} MemoryPressure;
+
+// Order releases run in, first to last
+typedef enum {
+    MEMORY_PRIORITY_DEBUG,   // measurement buffers
+    MEMORY_PRIORITY_ART,     // cover art, back from the cache on the next request
+    MEMORY_PRIORITY_TABLES,  // seek tables of tracks that aren't playing, reloaded on play
+    MEMORY_PRIORITY_QUEUE,   // wave buffers of the playback queue; always last
+} MemoryPriority;
+
+// Gives back what it can at `pressure` and returns the bytes freed; runs on the main thread
+typedef u32 (*MemoryReleaseFunc)(MemoryPressure pressure, void* user);
+
+bool memorySubscribe(MemoryPriority priority, MemoryReleaseFunc release, void* user);
+void memoryUnsubscribe(MemoryReleaseFunc release, void* user);
+
+// Measures and, under pressure, releases until both pools are above their low marks. Call once per frame.
+MemoryPressure memoryUpdate(void);
+
+// As of the last memoryUpdate; safe to read from any thread
+MemoryPressure memoryPressure(void);
+
+// Free bytes as of the last memoryUpdate, and the total released since start
+void memoryGetFree(u32* heap, u32* linear);
+u32 memoryReleased(void);
+
+#endif // MEMORY_H
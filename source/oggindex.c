@@ -0,0 +1,119 @@
+#include "oggindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static u32 read_u32(const u8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+u32 oggPageSize(const u8* p, u32 avail) {
+    if (avail < 27 || memcmp(p, "OggS", 4) != 0)
+        return 0;
+
+    u32 segments = p[26];
+    if (avail < 27 + segments)
+        return 0;
+
+    u32 size = 27 + segments;
+    for (u32 i = 0; i < segments; ++i)
+        size += p[27 + i];
+    return size <= avail ? size : 0;
+}
+
+u32 oggBuildSeekTable(const u8* data, u32 size, u32 interval, PackSeekPoint** points, u32* totalSamples) {
+    u32 count = 0, capacity = 0;
+    u32 lastPointSample = 0;
+    s64 previousGranule = 0;
+    *points = NULL;
+
+    u32 offset = 0;
+    while (offset < size) {
+        u32 pageSize = oggPageSize(data + offset, size - offset);
+        if (pageSize == 0)
+            break;
+
+        // Header pages carry granule 0 and pages without a finished packet carry -1
+        s64 granule = (s64)((u64)read_u32(data + offset + 6) | ((u64)read_u32(data + offset + 10) << 32));
+        if (granule > 0) {
+            if (count == 0 || (u32)previousGranule >= lastPointSample + interval) {
+                if (count == capacity) {
+                    capacity = capacity ? capacity * 2 : 256;
+                    PackSeekPoint* grown = (PackSeekPoint*)realloc(*points, capacity * sizeof(PackSeekPoint));
+                    if (!grown) {
+                        free(*points);
+                        *points = NULL;
+                        *totalSamples = 0;
+                        return 0;
+                    }
+                    *points = grown;
+                }
+                (*points)[count].sample = (u32)previousGranule;
+                (*points)[count].offset = offset;
+                lastPointSample = (u32)previousGranule;
+                count++;
+            }
+            previousGranule = granule;
+        }
+        offset += pageSize;
+    }
+
+    *totalSamples = (u32)previousGranule;
+    return count;
+}
+
+u8* oggReadHeaderPacket(const u8* data, u32 size, int index, u32* packetSize, u32* endOffset) {
+    u8* packet = NULL;
+    u32 length = 0, capacity = 0;
+    int current = 0;
+
+    u32 offset = 0;
+    while (offset < size) {
+        u32 pageSize = oggPageSize(data + offset, size - offset);
+        if (pageSize == 0)
+            break;
+
+        // Walk the lacing values; a value below 255 ends a packet
+        u32 segments = data[offset + 26];
+        const u8* body = data + offset + 27 + segments;
+        for (u32 i = 0; i < segments; ++i) {
+            u32 lace = data[offset + 27 + i];
+            if (current == index) {
+                if (length + lace > capacity) {
+                    capacity = (length + lace) * 2;
+                    packet = (u8*)realloc(packet, capacity);
+                }
+                memcpy(packet + length, body, lace);
+                length += lace;
+            }
+            body += lace;
+
+            if (lace < 255 && current++ == index) {
+                *packetSize = length;
+                if (endOffset)
+                    *endOffset = offset + pageSize;
+                return packet ? packet : (u8*)malloc(1);
+            }
+        }
+        offset += pageSize;
+    }
+
+    free(packet);
+    return NULL;
+}
+
+const PackSeekPoint* oggSeekLookup(const PackSeekPoint* points, u32 count, u32 sample) {
+    if (count == 0 || points[0].sample > sample)
+        return NULL;
+
+    // Binary search for the last point whose sample is <= the target
+    u32 lo = 0, hi = count - 1;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo + 1) / 2;
+        if (points[mid].sample <= sample)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return &points[lo];
+}
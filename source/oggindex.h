@@ -0,0 +1,32 @@
+#ifndef OGGINDEX_H
+#define OGGINDEX_H
+
+#include <3ds.h>
+#include "pack.h"
+
+// Ogg page walking shared by mkpack, packs and on-device seek tables
+
+#define OGG_SEEK_INTERVAL_SECONDS 1
+
+// Size of the Ogg page at p, or 0 if there isn't a complete one
+u32 oggPageSize(const u8* p, u32 avail);
+
+/* Builds a seek table for an in-memory Ogg stream
+One point roughly every `interval` samples, each at a page boundary after the
+Vorbis headers. Returns the number of points (*points is malloc'd) and the
+stream's last granule in *totalSamples. Out of memory, it returns 0 with
+*points NULL, as for a stream with no audio pages.
+*/
+u32 oggBuildSeekTable(const u8* data, u32 size, u32 interval, PackSeekPoint** points, u32* totalSamples);
+
+/* Reassembles header packet `index` (0 = identification, 1 = comments, 2 = setup)
+Returns a malloc'd copy, or NULL if the stream ends first. *endOffset is set to
+the end of the page that completes the packet, which for the setup packet is
+where audio data starts.
+*/
+u8* oggReadHeaderPacket(const u8* data, u32 size, int index, u32* packetSize, u32* endOffset);
+
+// Last point at or before `sample`, or NULL
+const PackSeekPoint* oggSeekLookup(const PackSeekPoint* points, u32 count, u32 sample);
+
+#endif // OGGINDEX_H
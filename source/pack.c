@@ -0,0 +1,215 @@
+#include "pack.h"
+#include "oggindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bound on the directory so a corrupt header can't make us allocate the whole heap
+#define PACK_MAX_DIRECTORY (4 * 1024 * 1024)
+
+static void* pack_section_data(const Pack* pack, u32 id, u32 elementSize, u32* count) {
+    const PackSection* section = packFindSection(pack, id);
+    *count = 0;
+    if (!section)
+        return NULL;
+
+    *count = section->size / elementSize;
+    return pack->directory + section->offset;
+}
+
+/* Opens a pack and reads its whole directory in one go
+The Ogg data itself is only read on demand through pack->file,
+which gets a larger stdio buffer since SD reads are slow to start.
+Returns false (and leaves the pack closed) if the file is missing or malformed.
+*/
+bool packOpen(Pack* pack, const char* path) {
+    memset(pack, 0, sizeof(Pack));
+
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+    setvbuf(file, NULL, _IOFBF, PACK_IO_BUFFER);
+
+    PackHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != PACK_MAGIC || header.version != PACK_VERSION ||
+        header.directorySize < sizeof(header) + header.sectionCount * sizeof(PackSection) ||
+        header.directorySize > PACK_MAX_DIRECTORY) {
+        fclose(file);
+        return false;
+    }
+
+    u8* directory = (u8*)malloc(header.directorySize);
+    if (!directory) {
+        fclose(file);
+        return false;
+    }
+
+    memcpy(directory, &header, sizeof(header));
+    size_t rest = header.directorySize - sizeof(header);
+    if (fread(directory + sizeof(header), 1, rest, file) != rest) {
+        free(directory);
+        fclose(file);
+        return false;
+    }
+
+    pack->file = file;
+    pack->directory = directory;
+    pack->directorySize = header.directorySize;
+
+    // Every section must lie inside the directory
+    const PackSection* sections = (const PackSection*)(directory + sizeof(PackHeader));
+    for (u32 i = 0; i < header.sectionCount; ++i) {
+        if (sections[i].offset > pack->directorySize ||
+            sections[i].size > pack->directorySize - sections[i].offset) {
+            packClose(pack);
+            return false;
+        }
+    }
+
+    u32 trackCount;
+    pack->tracks = pack_section_data(pack, PACK_SECTION_TRACKS, sizeof(PackTrack), &trackCount);
+    pack->seekPoints = pack_section_data(pack, PACK_SECTION_SEEK, sizeof(PackSeekPoint), &pack->seekPointCount);
+    pack->strings = pack_section_data(pack, PACK_SECTION_STRINGS, 1, &pack->stringsSize);
+    pack->trackCount = header.trackCount;
+
+    if (!pack->tracks || trackCount < header.trackCount) {
+        packClose(pack);
+        return false;
+    }
+
+    u32 count;
+    pack->loudness = pack_section_data(pack, PACK_SECTION_LOUDNESS, sizeof(PackLoudness), &count);
+    if (count < pack->trackCount)
+        pack->loudness = NULL;
+    pack->waveforms = pack_section_data(pack, PACK_SECTION_WAVEFORM, PACK_WAVEFORM_POINTS, &count);
+    if (count < pack->trackCount)
+        pack->waveforms = NULL;
+
+    // The search index is optional; a malformed one is ignored rather than failing the pack
+    const PackSection* search = packFindSection(pack, PACK_SECTION_SEARCH);
+    if (search && search->size >= sizeof(PackSearchHeader)) {
+        const PackSearchHeader* index = (const PackSearchHeader*)(pack->directory + search->offset);
+        u64 expected = sizeof(PackSearchHeader) + (u64)index->trigramCount * sizeof(PackTrigram) +
+                       ((u64)index->postingCount + pack->trackCount) * sizeof(u32) + index->textSize;
+        if (expected == search->size && index->textSize > 0) {
+            pack->trigrams = (const PackTrigram*)(index + 1);
+            pack->trigramCount = index->trigramCount;
+            pack->postings = (const u32*)(pack->trigrams + index->trigramCount);
+            pack->searchTextOffsets = pack->postings + index->postingCount;
+            pack->searchText = (const char*)(pack->searchTextOffsets + pack->trackCount);
+            pack->searchTextSize = index->textSize;
+
+            bool valid = pack->searchText[index->textSize - 1] == '\0';
+            for (u32 i = 0; i < pack->trigramCount && valid; ++i) {
+                valid = pack->trigrams[i].first <= index->postingCount &&
+                        pack->trigrams[i].count <= index->postingCount - pack->trigrams[i].first;
+            }
+            for (u32 i = 0; i < pack->trackCount && valid; ++i)
+                valid = pack->searchTextOffsets[i] < index->textSize;
+            if (!valid) {
+                pack->trigrams = NULL;
+                pack->trigramCount = 0;
+            }
+        }
+    }
+
+    // Orderings must be permutations, so a caller can index through them unchecked
+    const PackSection* sort = packFindSection(pack, PACK_SECTION_SORT);
+    if (sort && sort->size == (u64)2 * PACK_SORT_COUNT * pack->trackCount * sizeof(u32)) {
+        const u32* orders = (const u32*)(pack->directory + sort->offset);
+        const u32* ranks = orders + PACK_SORT_COUNT * pack->trackCount;
+        bool valid = true;
+        for (u32 i = 0; i < PACK_SORT_COUNT * pack->trackCount && valid; ++i) {
+            u32 base = i - i % pack->trackCount;
+            valid = orders[i] < pack->trackCount && ranks[base + orders[i]] == i - base;
+        }
+        if (valid) {
+            pack->sortOrders = orders;
+            pack->sortRanks = ranks;
+        }
+    }
+
+    // Tag columns: ids must index their dictionary, since smart playlists look them up unchecked
+    const PackSection* columns = packFindSection(pack, PACK_SECTION_COLUMNS);
+    if (columns && columns->size >= sizeof(PackColumnsHeader)) {
+        const PackColumnsHeader* header = (const PackColumnsHeader*)(pack->directory + columns->offset);
+        u64 names = 0;
+        for (int i = 0; i < PACK_TEXT_COUNT; ++i)
+            names += header->nameCount[i];
+        u64 expected = sizeof(PackColumnsHeader) + names * sizeof(u32) +
+                       (u64)(PACK_TEXT_COUNT + 1) * pack->trackCount * sizeof(u16);
+        if (expected == columns->size) {
+            const u32* name = (const u32*)(header + 1);
+            const u16* ids = (const u16*)(name + names);
+            bool valid = true;
+            for (int i = 0; i < PACK_TEXT_COUNT; ++i) {
+                pack->columnNames[i] = name;
+                pack->columnNameCount[i] = header->nameCount[i];
+                pack->columnIds[i] = ids;
+                for (u32 t = 0; t < pack->trackCount && valid; ++t)
+                    valid = ids[t] < header->nameCount[i];
+                name += header->nameCount[i];
+                ids += pack->trackCount;
+            }
+            pack->years = ids;
+            if (!valid) {
+                memset(pack->columnNames, 0, sizeof(pack->columnNames));
+                memset(pack->columnIds, 0, sizeof(pack->columnIds));
+                pack->years = NULL;
+            }
+        }
+    }
+
+    // A start that would run a track past 32-bit samples can't be real; without the section tracks play whole
+    pack->cueStarts = pack_section_data(pack, PACK_SECTION_CUES, sizeof(u32), &count);
+    for (u32 i = 0; i < pack->trackCount && pack->cueStarts; ++i) {
+        if (count < pack->trackCount || pack->cueStarts[i] > 0xFFFFFFFFu - pack->tracks[i].totalSamples)
+            pack->cueStarts = NULL;
+    }
+
+    // Drop seek tables that point outside the seek section rather than trusting them later
+    for (u32 i = 0; i < pack->trackCount; ++i) {
+        PackTrack* track = (PackTrack*)&pack->tracks[i];
+        if (track->seekFirst > pack->seekPointCount ||
+            track->seekCount > pack->seekPointCount - track->seekFirst)
+            track->seekCount = 0;
+    }
+
+    return true;
+}
+
+void packClose(Pack* pack) {
+    if (pack->file)
+        fclose(pack->file);
+    free(pack->directory);
+    memset(pack, 0, sizeof(Pack));
+}
+
+const PackSection* packFindSection(const Pack* pack, u32 id) {
+    if (!pack->directory)
+        return NULL;
+
+    const PackHeader* header = (const PackHeader*)pack->directory;
+    const PackSection* sections = (const PackSection*)(pack->directory + sizeof(PackHeader));
+    for (u32 i = 0; i < header->sectionCount; ++i) {
+        if (sections[i].id == id)
+            return &sections[i];
+    }
+    return NULL;
+}
+
+const char* packString(const Pack* pack, u32 offset) {
+    // The pool is NUL-terminated by the writer; anything else reads as empty
+    if (!pack->strings || offset >= pack->stringsSize || pack->strings[pack->stringsSize - 1] != '\0')
+        return "";
+    return pack->strings + offset;
+}
+
+const PackSeekPoint* packSeekLookup(const Pack* pack, u32 track, u32 sample) {
+    if (track >= pack->trackCount)
+        return NULL;
+
+    const PackTrack* entry = &pack->tracks[track];
+    return oggSeekLookup(pack->seekPoints + entry->seekFirst, entry->seekCount, sample);
+}
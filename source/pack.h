@@ -0,0 +1,168 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <3ds.h>
+#include <stdio.h>
+
+/* Packed library container (.xpk)
+Many tracks' Ogg streams stored in one file so the player does a single
+directory read at startup and random access afterwards.
+
+  [PackHeader][PackSection x sectionCount][sections...]   <- the directory
+  [padding to PACK_DATA_ALIGN]
+  [track 0 Ogg pages][padding][track 1 Ogg pages][padding]...
+
+Each track's data starts on a PACK_DATA_ALIGN boundary and contains whole
+Ogg pages only. All fields are little-endian (both the 3DS and the PCs that
+build packs are).
+*/
+
+#define PACK_MAGIC      0x4B504D58u  // "XMPK"
+#define PACK_VERSION    1
+#define PACK_DATA_ALIGN 0x1000
+#define PACK_IO_BUFFER  (32 * 1024)
+
+#define PACK_ID(a, b, c, d) ((u32)(a) | ((u32)(b) << 8) | ((u32)(c) << 16) | ((u32)(d) << 24))
+
+#define PACK_SECTION_TRACKS  PACK_ID('T', 'R', 'K', 'S')  // PackTrack[trackCount]
+#define PACK_SECTION_SEEK    PACK_ID('S', 'E', 'E', 'K')  // PackSeekPoint[]
+#define PACK_SECTION_STRINGS PACK_ID('S', 'T', 'R', 'S')  // NUL-terminated UTF-8, offset 0 is ""
+
+// Optional sections, filled in by mkpack's decode pass
+#define PACK_SECTION_LOUDNESS PACK_ID('L', 'O', 'U', 'D')  // PackLoudness[trackCount]
+#define PACK_SECTION_WAVEFORM PACK_ID('W', 'A', 'V', 'E')  // u8[trackCount][PACK_WAVEFORM_POINTS]
+
+// Optional trigram index over titles, artists and albums, see search.h
+#define PACK_SECTION_SEARCH   PACK_ID('S', 'R', 'C', 'H')  // PackSearchHeader, PackTrigram[], u32 postings[],
+                                                           // u32 textOffsets[trackCount], folded text
+
+// Optional presorted orderings, see collate.h
+#define PACK_SECTION_SORT     PACK_ID('S', 'O', 'R', 'T')  // u32 order[PACK_SORT_COUNT][trackCount],
+                                                           // u32 rank[PACK_SORT_COUNT][trackCount]
+
+// Optional dictionary-coded tag columns for smart playlists, see filter.h
+#define PACK_SECTION_COLUMNS  PACK_ID('C', 'O', 'L', 'S')  // PackColumnsHeader, u32 names[] (string offsets),
+                                                           // u16 ids[PACK_TEXT_COUNT][trackCount], u16 year[trackCount]
+
+/* Optional CUE sheet cuts
+Tracks cut from one long file by a CUE sheet are consecutive entries with
+the same dataOffset, dataSize and seek points (whose samples count from the
+start of the file). Each plays from its start sample for its totalSamples,
+running straight on into the next one.
+*/
+#define PACK_SECTION_CUES     PACK_ID('C', 'U', 'E', 'S')  // u32 startSample[trackCount], 0 for whole files
+
+#define PACK_WAVEFORM_POINTS  64
+#define PACK_LOUDNESS_TARGET  -18.0f  // dBFS RMS that track gains normalize to
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 sectionCount;
+    u32 trackCount;
+    u32 directorySize;  // bytes from the start of the file to the end of the last section
+} PackHeader;
+
+typedef struct {
+    u32 id;
+    u32 offset;  // from the start of the file
+    u32 size;
+} PackSection;
+
+typedef struct {
+    u32 dataOffset;    // absolute file offset of the first Ogg page
+    u32 dataSize;
+    u32 headerSize;    // bytes covering the three Vorbis header packets
+    u32 sampleRate;
+    u32 totalSamples;  // granule of the last page, i.e. duration in samples
+    u16 channels;
+    u16 flags;
+    u32 seekFirst;     // index of the first seek point in PACK_SECTION_SEEK
+    u32 seekCount;
+    u32 title;         // offsets into PACK_SECTION_STRINGS
+    u32 artist;
+    u32 album;
+} PackTrack;
+
+typedef struct {
+    s16 gain;  // hundredths of a dB to reach PACK_LOUDNESS_TARGET
+    u16 peak;  // largest absolute sample value
+} PackLoudness;
+
+typedef struct {
+    u32 trigramCount;
+    u32 postingCount;
+    u32 textSize;  // each track's folded fields joined by SEARCH_FIELD_SEPARATOR, NUL-terminated
+} PackSearchHeader;
+
+// Tracks containing a trigram: postings[first .. first + count), ascending track indices
+typedef struct {
+    u32 key;  // folded bytes, first one most significant; the table is sorted by key
+    u32 first;
+    u32 count;
+} PackTrigram;
+
+// Orderings in PACK_SECTION_SORT; fields compared in the order given
+typedef enum {
+    PACK_SORT_TITLE,   // title, artist, album
+    PACK_SORT_ARTIST,  // artist, album, title
+    PACK_SORT_ALBUM,   // album, artist, title
+    PACK_SORT_COUNT
+} PackSort;
+
+// Text columns in PACK_SECTION_COLUMNS
+typedef enum {
+    PACK_TEXT_GENRE,
+    PACK_TEXT_ARTIST,
+    PACK_TEXT_ALBUM,
+    PACK_TEXT_COUNT
+} PackTextColumn;
+
+// Distinct values per text column; names[] holds each column's in turn and a track's id indexes its column's
+typedef struct {
+    u32 nameCount[PACK_TEXT_COUNT];
+} PackColumnsHeader;
+
+// First sample decodable from the page at `offset` (relative to dataOffset)
+typedef struct {
+    u32 sample;
+    u32 offset;
+} PackSeekPoint;
+
+typedef struct {
+    FILE* file;
+    u8* directory;
+    u32 directorySize;
+    u32 trackCount;
+    const PackTrack* tracks;
+    const PackSeekPoint* seekPoints;
+    u32 seekPointCount;
+    const char* strings;
+    u32 stringsSize;
+    const PackLoudness* loudness;  // NULL when the pack has no decode pass data
+    const u8* waveforms;
+    const PackTrigram* trigrams;   // NULL when the pack has no search index
+    u32 trigramCount;
+    const u32* postings;
+    const u32* searchTextOffsets;
+    const char* searchText;
+    u32 searchTextSize;
+    const u32* sortOrders;  // order[PACK_SORT_COUNT][trackCount] (track indices), NULL when absent
+    const u32* sortRanks;   // rank[PACK_SORT_COUNT][trackCount] (position of each track in its order)
+    const u32* columnNames[PACK_TEXT_COUNT];  // NULL when the pack has no tag columns
+    u32 columnNameCount[PACK_TEXT_COUNT];
+    const u16* columnIds[PACK_TEXT_COUNT];
+    const u16* years;                         // 0 when the track has no DATE tag
+    const u32* cueStarts;                     // NULL when no track is cut from a CUE sheet
+} Pack;
+
+bool packOpen(Pack* pack, const char* path);
+void packClose(Pack* pack);
+
+const PackSection* packFindSection(const Pack* pack, u32 id);
+const char* packString(const Pack* pack, u32 offset);
+
+// Last seek point at or before `sample`, or NULL if the track has none
+const PackSeekPoint* packSeekLookup(const Pack* pack, u32 track, u32 sample);
+
+#endif // PACK_H
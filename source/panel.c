@@ -0,0 +1,72 @@
+#include "panel.h"
+#include "trace.h"
+
+#include <string.h>
+
+// GPU textures must have power-of-two sides of at least 8
+static u16 texture_side(u16 size) {
+    u16 side = 8;
+    while (side < size)
+        side <<= 1;
+    return side;
+}
+
+bool panelInit(Panel* panel, u16 width, u16 height, u32 background, PanelDrawFunc draw, void* user) {
+    memset(panel, 0, sizeof(*panel));
+    u16 texWidth = texture_side(width), texHeight = texture_side(height);
+    if (!C3D_TexInitVRAM(&panel->texture, texWidth, texHeight, GPU_RGBA8))
+        return false;
+
+    panel->target = C3D_RenderTargetCreateFromTex(&panel->texture, GPU_TEXFACE_2D, 0, -1);
+    if (!panel->target) {
+        C3D_TexDelete(&panel->texture);
+        return false;
+    }
+
+    // Render targets are stored bottom-up, so the image's top edge is t = 1
+    panel->subtex.width = width;
+    panel->subtex.height = height;
+    panel->subtex.left = 0.0f;
+    panel->subtex.top = 1.0f;
+    panel->subtex.right = (float)width / texWidth;
+    panel->subtex.bottom = 1.0f - (float)height / texHeight;
+
+    panel->width = width;
+    panel->height = height;
+    panel->background = background;
+    panel->draw = draw;
+    panel->user = user;
+    panel->dirty = true;
+    return true;
+}
+
+void panelExit(Panel* panel) {
+    if (!panel->target)
+        return;
+    C3D_RenderTargetDelete(panel->target);
+    C3D_TexDelete(&panel->texture);
+    panel->target = NULL;
+}
+
+void panelInvalidate(Panel* panel) {
+    panel->dirty = true;
+}
+
+void panelRender(Panel* panel) {
+    if (!panel->dirty || !panel->target)
+        return;
+
+    TRACE_SCOPE("panel render");
+    C2D_TargetClear(panel->target, panel->background);
+    C2D_SceneBegin(panel->target);
+    panel->draw(panel->user);
+    panel->dirty = false;
+}
+
+void panelDraw(Panel* panel, float x, float y) {
+    if (!panel->target)
+        return;
+
+    C2D_Image image = { &panel->texture, &panel->subtex };
+    C2D_DrawImageAt(image, x, y, 0, NULL, 1.0f, 1.0f);
+}
@@ -0,0 +1,35 @@
+#ifndef PANEL_H
+#define PANEL_H
+
+#include <citro2d.h>
+
+/* UI panel cached in an off-screen render target
+A panel's contents are drawn into its own VRAM texture only when marked
+dirty; every other frame it is composited as a single textured quad, so
+static text and shapes cost no parsing and almost no vertices.
+*/
+
+// Draws the panel's contents at (0, 0); the panel's target is already bound
+typedef void (*PanelDrawFunc)(void* user);
+
+typedef struct {
+    C3D_Tex texture;
+    C3D_RenderTarget* target;
+    Tex3DS_SubTexture subtex;
+    u16 width, height;
+    u32 background;  // clear colour, transparent to blend over the screen
+    bool dirty;
+    PanelDrawFunc draw;
+    void* user;
+} Panel;
+
+bool panelInit(Panel* panel, u16 width, u16 height, u32 background, PanelDrawFunc draw, void* user);
+void panelExit(Panel* panel);
+
+void panelInvalidate(Panel* panel);
+
+// Re-renders a dirty panel; call after C3D_FrameBegin and before drawing to the screens
+void panelRender(Panel* panel);
+void panelDraw(Panel* panel, float x, float y);
+
+#endif // PANEL_H
@@ -1,104 +1,360 @@
 #include "player.h"
-#include "track1.h"
-#include "track2.h"
-#include "track3.h"
+#include "assets.h"
+#include "boost.h"
+#include "cache.h"
+#include "collate.h"
+#include "effects.h"
+#include "filter.h"
+#include "history.h"
+#include "latency.h"
+#include "memory.h"
+#include "oggindex.h"
+#include "pack.h"
+#include "search.h"
+#include "stats.h"
+#include "trace.h"
 
 #include <3ds.h>
 #include <3ds/ndsp/ndsp.h>
-#include <malloc.h>
+#include <stdlib.h>
+#include <math.h>
 #include <string.h>
-#include "tremor/ivorbisfile.h"
+#include <time.h>
+#include "decoder.h"
 
-#define AUDIO_SAMPLE_RATE  44100
 #define AUDIO_CHANNELS     2
 #define AUDIO_BUFFER_SIZE  (1024 * AUDIO_CHANNELS)
+#define AUDIO_WAVEBUF_COUNT 4
+#define AUDIO_WAVEBUF_MIN   2  // queue length under critical memory pressure
+
+#define PLAYER_LIBRARY_PATH "sdmc:/3ds/3dXMMP/library.xpk"
+#define SEEK_CACHE_VERSION  1
 
 typedef struct {
-    const unsigned char* data;
+    const unsigned char* data;  // embedded track, NULL when streamed from the library pack
     unsigned int size;
-    size_t offset;
+    u32 packIndex;
+    u32 start;                  // first sample of the stream it plays; CUE tracks of one file share the stream
+    const PackSeekPoint* seek;  // embedded tracks only; packs carry their own
+    u32 seekCount;
+    bool seekOwned;             // loaded or built here rather than taken from the asset manifest
 } Track;
 
-static Track tracks[3];
+static Track* tracks = NULL;
+static int track_count = 0;
+
+// Library pack; when it loads it replaces the embedded tracks
+static Pack library;
+static bool library_loaded = false;
+
+// Per PlayerSort: track indices in order, and each track's position in it
+static const u32* sort_orders[PLAYER_SORT_COUNT];
+static const u32* sort_ranks[PLAYER_SORT_COUNT];
+static u32* sort_tables = NULL;  // identity order, then any orderings sorted here
+static const u32* sorting_ranks;  // for compare_ranks
 
-static OggVorbis_File vf;
+// Smart playlist columns; the tag ones point into the pack, the rest are owned here
+static FilterColumns filter_columns;
+static bool filter_columns_ready = false;
+static const char** column_names[FILTER_TEXT_COUNT];
+static u16* track_seconds = NULL;
+static u32* last_played = NULL;
+static u16* play_counts = NULL;
+
+static Decoder decoder;
 static bool playing = false;
+static bool paused = false;
 static bool audio_initialized = false;
 
+// Resume latency: set by playerPause, picked up by the callback once the channel moves again
+static struct {
+    u64 tick;
+    u32 position;
+    u16 sequence;
+    volatile bool pending;
+    volatile bool measured;
+    float ms;
+} resume;
+
+// Guards decoder between the NDSP callback thread and the control functions
+static LightLock decoder_lock;
+
+// wavebuf_count slices of AUDIO_BUFFER_SIZE samples, one per wave buffer
 static s16* audio_buffer = NULL;
+static int wavebuf_count = AUDIO_WAVEBUF_COUNT;
+static bool queue_reduced = false;  // memory pressure asked for AUDIO_WAVEBUF_MIN buffers
 static int current_track = -1;
 
-// === OGG CALLBACKS ===
-
-static size_t mem_read_func(void *ptr, size_t size, size_t nmemb, void *datasource) {
-    Track* track = (Track*)datasource;
-    size_t bytes_to_read = size * nmemb;
+// === NDSP CALLBACK ===
 
-    if (track->offset + bytes_to_read > track->size)
-        bytes_to_read = track->size - track->offset;
+static ndspWaveBuf waveBufs[AUDIO_WAVEBUF_COUNT];
+static u32 buffer_start[AUDIO_WAVEBUF_COUNT];  // stream sample each wave buffer begins at
+static u32 decode_position;                    // stream sample the next decoderRead returns
 
-    memcpy(ptr, track->data + track->offset, bytes_to_read);
-    track->offset += bytes_to_read;
+/* Decode into every wave buffer the DSP is done with and queue it again
+Keeping several buffers queued means the DSP always has the next one ready
+while this one is being refilled. From the callback, the decode time and
+how many buffers were still queued feed the clock boost controller.
+*/
+static void fill_wave_buffers(bool report) {
+    LightLock_Lock(&decoder_lock);
+    int queued = 0;
+    for (int i = 0; i < wavebuf_count; ++i)
+        queued += waveBufs[i].status == NDSP_WBUF_QUEUED || waveBufs[i].status == NDSP_WBUF_PLAYING;
+
+    u64 decodeTicks = 0;
+    u32 decodedSamples = 0;
+    for (int i = 0; i < wavebuf_count && playing; ++i) {
+        ndspWaveBuf* waveBuf = &waveBufs[i];
+        if (waveBuf->status != NDSP_WBUF_FREE && waveBuf->status != NDSP_WBUF_DONE)
+            continue;
+
+        s16* samples = audio_buffer + i * AUDIO_BUFFER_SIZE;
+        u64 start = svcGetSystemTick();
+        long bytesRead = decoderRead(&decoder, samples,
+                                     AUDIO_BUFFER_SIZE * sizeof(s16));
+        if (bytesRead <= 0) {
+            decodeTicks += svcGetSystemTick() - start;
+            playing = false;
+            break;
+        }
+
+        // Effects count as decoding, so the boost controller sees what they cost
+        u32 frames = bytesRead / sizeof(s16) / decoder.channels;
+        effectsProcess(samples, frames, decoder.channels);
+        decodeTicks += svcGetSystemTick() - start;
+
+        memset(waveBuf, 0, sizeof(ndspWaveBuf));
+        waveBuf->data_vaddr = samples;
+        waveBuf->nsamples = frames;
+        decodedSamples += waveBuf->nsamples;
+        buffer_start[i] = decode_position;
+        decode_position += frames;
+        waveBuf->looping = false;
+
+        latencyMarkBuffer(samples, waveBuf->nsamples, decoder.channels, decoder.rate);
+        DSP_FlushDataCache(samples, bytesRead);
+        ndspChnWaveBufAdd(0, waveBuf);
+    }
+    if (report) {
+        boostReport(decodeTicks, decodedSamples, decoder.rate, queued, wavebuf_count);
+        statsDecode(decodeTicks, decodedSamples, decoder.rate);
+        if (queued == 0)
+            statsUnderrun();
+    }
+    LightLock_Unlock(&decoder_lock);
+}
 
-    return bytes_to_read / size;
+// The DSP has played from where the channel was frozen: the resume is audible
+static void check_resume(void) {
+    if (!resume.pending || (ndspChnGetSamplePos(0) == resume.position && ndspChnGetWaveBufSeq(0) == resume.sequence))
+        return;
+    resume.ms = (svcGetSystemTick() - resume.tick) * 1000.0f / SYSCLOCK_ARM11;
+    resume.pending = false;
+    resume.measured = true;
 }
 
-static int mem_seek_func(void *datasource, ogg_int64_t offset, int whence) {
-    Track* track = (Track*)datasource;
+static void myNdspCallback(void* unused) {
+    latencyScanCapture();
+    check_resume();
+    if (!playing || paused)
+        return;
+
+    TRACE_THREAD("audio");
+    TRACE_SCOPE("ndsp callback");
+    fill_wave_buffers(true);
+}
 
-    switch (whence) {
-        case SEEK_SET:
-            if ((size_t)offset > track->size) return -1;
-            track->offset = offset;
-            break;
-        case SEEK_CUR:
-            if (track->offset + offset > track->size) return -1;
-            track->offset += offset;
-            break;
-        case SEEK_END:
-        if (offset > 0 || (size_t)(-offset) > track->size) return -1;
-            track->offset = track->size + offset;
-            break;
-        default:
-            return -1;
+/* Channel setup for the track that is about to play
+ndspChnReset in playerStop drops rate, format and mix, so this runs on every playerPlay.
+When the pack has loudness data the mix carries the track's gain, limited so its peak can't clip.
+*/
+static void configure_channel(int index) {
+    float gain = 1.0f;
+    if (library_loaded && library.loudness) {
+        const PackLoudness* loudness = &library.loudness[tracks[index].packIndex];
+        gain = powf(10.0f, loudness->gain / 2000.0f);
+        if (loudness->peak > 0 && gain * loudness->peak > 32767.0f)
+            gain = 32767.0f / loudness->peak;
     }
 
-    return 0;
+    ndspChnSetInterp(0, NDSP_INTERP_POLYPHASE);
+    ndspChnSetRate(0, decoder.rate);
+    ndspChnSetFormat(0, decoder.channels == 1 ? NDSP_FORMAT_MONO_PCM16 : NDSP_FORMAT_STEREO_PCM16);
+    float mix[12] = {gain, gain};
+    ndspChnSetMix(0, mix);
 }
 
-static int mem_close_func(void *datasource) {
-    return 0;
+// A cached table has to point inside the track, in stream order, or seeking would read garbage
+static bool seek_table_valid(const Track* track, const PackSeekPoint* points, u32 bytes) {
+    u32 count = bytes / sizeof(PackSeekPoint);
+    if (count == 0 || bytes % sizeof(PackSeekPoint) != 0)
+        return false;
+    for (u32 i = 0; i < count; ++i) {
+        if (points[i].offset >= track->size ||
+            (i > 0 && (points[i].offset <= points[i - 1].offset || points[i].sample < points[i - 1].sample)))
+            return false;
+    }
+    return true;
 }
 
-static long mem_tell_func(void *datasource) {
-    Track* track = (Track*)datasource;
-    return (long)track->offset;
+/* Seek table for an embedded track
+The asset manifest normally has one from build time. Without it, it is taken
+from the on-disk cache when a previous session built it, otherwise built
+from the Ogg pages and stored for next time. A cached table that doesn't fit
+the track is dropped from the cache and built again.
+*/
+static void load_seek_table(Track* track) {
+    if (track->seek)
+        return;
+
+    CacheKey key = cacheKeyForMemory(track->data, track->size);
+    u32 bytes = 0;
+    PackSeekPoint* points = (PackSeekPoint*)cacheLoad(CACHE_KIND_SEEK, SEEK_CACHE_VERSION, key, &bytes);
+    if (points && !seek_table_valid(track, points, bytes)) {
+        free(points);
+        points = NULL;
+        cacheRemove(CACHE_KIND_SEEK, key);
+    }
+    if (points) {
+        track->seek = points;
+        track->seekCount = bytes / sizeof(PackSeekPoint);
+        track->seekOwned = true;
+        statsMemory(STATS_MEMORY_LIBRARY, bytes);
+        return;
+    }
+
+    u32 totalSamples;
+    track->seekCount = oggBuildSeekTable(track->data, track->size, decoder.rate * OGG_SEEK_INTERVAL_SECONDS,
+                                         &points, &totalSamples);
+    track->seek = points;
+    track->seekOwned = true;
+    statsMemory(STATS_MEMORY_LIBRARY, track->seekCount * sizeof(PackSeekPoint));
+    if (points)
+        cacheStore(CACHE_KIND_SEEK, SEEK_CACHE_VERSION, key, points, track->seekCount * sizeof(PackSeekPoint));
 }
 
-// === NDSP CALLBACK ===
+// === MEMORY PRESSURE ===
+
+// Owned seek tables come back from the cache when their track plays again; the playing track keeps its own
+static u32 release_seek_tables(MemoryPressure pressure, void* unused) {
+    u32 freed = 0;
+    for (int i = 0; i < track_count; ++i) {
+        Track* track = &tracks[i];
+        if (!track->seekOwned || i == current_track)
+            continue;
+        u32 bytes = track->seekCount * sizeof(PackSeekPoint);
+        free((void*)track->seek);
+        track->seek = NULL;
+        track->seekCount = 0;
+        track->seekOwned = false;
+        statsMemory(STATS_MEMORY_LIBRARY, -(s32)bytes);
+        freed += bytes;
+    }
+    return freed;
+}
 
-static ndspWaveBuf waveBuf;
+/* Reallocates the wave buffers for a queue of `count`
+Only valid while none of them is queued: the channel has been reset or the
+track has run out. The new block is allocated before the old one is freed;
+a shrink that finds no room for both gives the old block back first so the
+smaller one fits in it, and takes the old size again if even that fails.
+Growing keeps the old queue if linear memory is short. Should the old block
+not come back either, the queue is left empty and playerPlay refuses to
+start until a later resize succeeds. Returns the bytes freed.
+*/
+static u32 resize_queue(int count) {
+    if (count == wavebuf_count)
+        return 0;
+
+    u32 oldBytes = wavebuf_count * AUDIO_BUFFER_SIZE * sizeof(s16);
+    u32 newBytes = count * AUDIO_BUFFER_SIZE * sizeof(s16);
+    LightLock_Lock(&decoder_lock);
+    s16* buffer = (s16*)linearAlloc(newBytes);
+    if (buffer) {
+        if (audio_buffer)
+            linearFree(audio_buffer);
+    } else if (count < wavebuf_count) {
+        linearFree(audio_buffer);
+        buffer = (s16*)linearAlloc(newBytes);
+        if (!buffer) {
+            audio_buffer = (s16*)linearAlloc(oldBytes);
+            if (!audio_buffer) {
+                wavebuf_count = 0;
+                memset(waveBufs, 0, sizeof(waveBufs));
+                statsMemory(STATS_MEMORY_AUDIO, -(s32)oldBytes);
+            }
+            LightLock_Unlock(&decoder_lock);
+            return audio_buffer ? 0 : oldBytes;
+        }
+    } else {
+        LightLock_Unlock(&decoder_lock);
+        return 0;
+    }
+    audio_buffer = buffer;
+    wavebuf_count = count;
+    memset(waveBufs, 0, sizeof(waveBufs));
+    LightLock_Unlock(&decoder_lock);
 
-static void myNdspCallback(void* unused) {
-    if (!playing || waveBuf.status != NDSP_WBUF_DONE)
-        return;
+    statsMemory(STATS_MEMORY_AUDIO, (s32)newBytes - (s32)oldBytes);
+    return oldBytes > newBytes ? oldBytes - newBytes : 0;
+}
 
-    int bitstream = 0;
-    long bytesRead = ov_read(&vf, (char*)audio_buffer,
-                              AUDIO_BUFFER_SIZE * sizeof(s16),
-                              &bitstream);
+/* The playback queue is the last thing to give memory back, and only when critical
+Fewer buffers still play gaplessly, with less slack for a slow decode.
+While a track plays its buffers are in use, so the shorter queue takes over
+at the next playerStop (every track change goes through it); stopped, it
+shrinks straight away. It grows back at the first stop without pressure.
+*/
+static u32 release_queue(MemoryPressure pressure, void* unused) {
+    if (pressure != MEMORY_PRESSURE_CRITICAL || queue_reduced)
+        return 0;
+    queue_reduced = true;
+    return playerIsPlaying() ? 0 : resize_queue(AUDIO_WAVEBUF_MIN);
+}
 
-    if (bytesRead <= 0) {
-        playing = false;
+static const char* track_field(u32 index, int field, void* unused) {
+    switch (field) {
+    case COLLATE_FIELD_ARTIST: return playerTrackArtist(index);
+    case COLLATE_FIELD_ALBUM:  return playerTrackAlbum(index);
+    default:                   return playerTrackTitle(index);
+    }
+}
+
+/* Orderings for the sort modes
+Packs from mkpack carry them presorted, so switching order is only picking
+another array. Embedded tracks and older packs sort here once instead; if
+that fails every mode falls back to library order.
+*/
+static void build_sort_orders(void) {
+    bool presorted = library_loaded && library.sortOrders;
+    u32 tables = presorted ? 1 : 1 + 2 * PACK_SORT_COUNT;
+    sort_tables = (u32*)malloc((track_count ? track_count : 1) * tables * sizeof(u32));
+    if (!sort_tables)
         return;
+    statsMemory(STATS_MEMORY_LIBRARY, (track_count ? track_count : 1) * tables * sizeof(u32));
+
+    for (int i = 0; i < track_count; ++i)
+        sort_tables[i] = i;
+    for (int sort = 0; sort < PLAYER_SORT_COUNT; ++sort) {
+        sort_orders[sort] = sort_tables;
+        sort_ranks[sort] = sort_tables;
     }
 
-    memset(&waveBuf, 0, sizeof(ndspWaveBuf));
-    waveBuf.data_vaddr = audio_buffer;
-    waveBuf.nsamples = bytesRead / sizeof(s16) / AUDIO_CHANNELS;
-    waveBuf.looping = false;
+    const u32* orders = library.sortOrders;
+    const u32* ranks = library.sortRanks;
+    if (!presorted) {
+        u32* sorted = sort_tables + track_count;
+        if (!collateBuildOrders(track_count, track_field, NULL, sorted, sorted + PACK_SORT_COUNT * track_count))
+            return;
+        orders = sorted;
+        ranks = sorted + PACK_SORT_COUNT * track_count;
+    }
 
-    ndspChnWaveBufAdd(0, &waveBuf);
+    for (int sort = 0; sort < PACK_SORT_COUNT; ++sort) {
+        sort_orders[PLAYER_SORT_TITLE + sort] = orders + sort * track_count;
+        sort_ranks[PLAYER_SORT_TITLE + sort] = ranks + sort * track_count;
+    }
 }
 
 /* === PLAYER CONTROL ===
@@ -107,9 +363,10 @@ This function should be called before any playback
 It initializes the NDSP library and sets up the audio buffer
 It also initializes the tracks array with the OGG data
 The tracks array is initialized at runtime to avoid static initialization issues
-The audio buffer is allocated with memalign to ensure proper alignment for the DSP
-The NDSP channel is set to stereo PCM16 format with a sample rate of 44100 Hz
+The audio buffers are allocated in linear memory so the DSP can read them
+The NDSP channel format and rate are set per track in playerPlay
 The NDSP callback is set to handle audio processing
+If a library pack is present on the SD card its tracks replace the embedded ones
 The audio_initialized flag is used to prevent re-initialization
 The playerInit function should be called once at the start of the program
 */
@@ -117,45 +374,149 @@ void playerInit(void) {
     if (audio_initialized)
         return;
 
+    LightLock_Init(&decoder_lock);
+    boostInit();
+    historyLoad(HISTORY_PATH);
+
     // Initialize tracks array at runtime
-    tracks[0].data = track1_ogg;
-    tracks[0].size = track1_ogg_len;
-    tracks[0].offset = 0;
-    tracks[1].data = track2_ogg;
-    tracks[1].size = track2_ogg_len;
-    tracks[1].offset = 0;
-    tracks[2].data = track3_ogg;
-    tracks[2].size = track3_ogg_len;
-    tracks[2].offset = 0;
+    library_loaded = packOpen(&library, PLAYER_LIBRARY_PATH) && library.trackCount > 0;
+    if (library_loaded) {
+        track_count = library.trackCount;
+        tracks = (Track*)calloc(track_count, sizeof(Track));
+        // A library too large for the heap leaves the embedded tracks to play
+        library_loaded = tracks != NULL;
+        for (int i = 0; i < track_count && tracks; ++i) {
+            tracks[i].size = library.tracks[i].dataSize;
+            tracks[i].packIndex = i;
+            tracks[i].start = library.cueStarts ? library.cueStarts[i] : 0;
+        }
+    }
+    if (!library_loaded) {
+        packClose(&library);
+        track_count = assetCount();
+        tracks = (Track*)calloc(track_count, sizeof(Track));
+        if (!tracks)
+            track_count = 0;
+        for (int i = 0; i < track_count; ++i) {
+            const EmbeddedAsset* asset = assetGet(i);
+            tracks[i].data = asset->data;
+            tracks[i].size = asset->size;
+            if (asset->seekCount) {
+                tracks[i].seek = assetSeekPoints() + asset->seekFirst;
+                tracks[i].seekCount = asset->seekCount;
+            }
+        }
+    }
+
+    statsMemory(STATS_MEMORY_LIBRARY, track_count * sizeof(Track));
+    build_sort_orders();
 
     ndspInit();
     ndspSetOutputMode(NDSP_OUTPUT_STEREO);
     ndspChnReset(0);
 
-    audio_buffer = (s16*)memalign(0x1000, AUDIO_BUFFER_SIZE * sizeof(s16));
-    memset(audio_buffer, 0, AUDIO_BUFFER_SIZE * sizeof(s16));
+    wavebuf_count = AUDIO_WAVEBUF_COUNT;
+    queue_reduced = false;
+    audio_buffer = (s16*)linearAlloc(AUDIO_WAVEBUF_COUNT * AUDIO_BUFFER_SIZE * sizeof(s16));
+    if (audio_buffer) {
+        memset(audio_buffer, 0, AUDIO_WAVEBUF_COUNT * AUDIO_BUFFER_SIZE * sizeof(s16));
+        statsMemory(STATS_MEMORY_AUDIO, AUDIO_WAVEBUF_COUNT * AUDIO_BUFFER_SIZE * sizeof(s16));
+    } else {
+        wavebuf_count = 0;  // playerPlay refuses to start without a queue
+    }
+    memorySubscribe(MEMORY_PRIORITY_TABLES, release_seek_tables, NULL);
+    memorySubscribe(MEMORY_PRIORITY_QUEUE, release_queue, NULL);
 
-    ndspChnSetInterp(0, NDSP_INTERP_POLYPHASE);
-    ndspChnSetRate(0, AUDIO_SAMPLE_RATE);
-    ndspChnSetFormat(0, NDSP_FORMAT_STEREO_PCM16);
-    float mix[12] = {1.0f, 1.0f}; // ✅ Full volume to left and right
-    ndspChnSetMix(0, mix);
     ndspSetCallback(myNdspCallback, NULL);
     audio_initialized = true;
 }
 
 void playerStop(void) {
-    if (!playing) return;
-
-    ov_clear(&vf);
-    ndspChnReset(0);
+    LightLock_Lock(&decoder_lock);
     playing = false;
+    decoderClose(&decoder);
+    LightLock_Unlock(&decoder_lock);
+    ndspChnReset(0);
+    paused = false;
+    resume.pending = false;
+
+    // With the channel reset the wave buffers are idle, so this is where the queue changes length
+    if (queue_reduced && memoryPressure() == MEMORY_PRESSURE_NONE)
+        queue_reduced = false;
+    resize_queue(queue_reduced ? AUDIO_WAVEBUF_MIN : AUDIO_WAVEBUF_COUNT);
+}
+
+// Moves the open stream to `sample`, counted from the start of the stream, through the track's seek index
+// Decoding forward to the sample uses the wave buffers as scratch, so none of them may be queued
+static bool seek_stream(Track* track, ogg_int64_t sample) {
+    const PackSeekPoint* point = NULL;
+    if (sample <= 0xFFFFFFFF) {
+        point = track->data
+            ? oggSeekLookup(track->seek, track->seekCount, (u32)sample)
+            : packSeekLookup(&library, track->packIndex, (u32)sample);
+    }
+
+    if (!decoderSeek(&decoder, sample, point, audio_buffer, AUDIO_BUFFER_SIZE * sizeof(s16)))
+        return false;
+    decode_position = (u32)sample;
+    return true;
+}
+
+// CUE tracks cut from the same file of the pack
+static bool same_file(int a, int b) {
+    return library_loaded && library.cueStarts &&
+           library.tracks[tracks[a].packIndex].dataOffset == library.tracks[tracks[b].packIndex].dataOffset;
+}
+
+// Counts a play in the session stats, the play history and the smart playlist columns
+static void record_play(int index) {
+    statsTrackPlayed();
+    u32 now = (u32)time(NULL);
+    historyRecordPlay(playerTrackCacheKey(index), now);
+    if (filter_columns_ready) {
+        last_played[index] = now;
+        if (play_counts[index] < 0xFFFF)
+            play_counts[index]++;
+    }
+}
+
+/* Jump to another CUE track of the file that is open
+The stream stays open and the seek index takes it straight to the track's
+start, so the jump costs one seek instead of reopening the stream and
+parsing its headers again. Only the audio queued from the old position is
+dropped; rate, format and gain stay, since every cut of a file shares them.
+*/
+static bool jump_within_file(int index) {
+    if (!decoder.open || current_track < 0 || !same_file(current_track, index))
+        return false;
+
+    LightLock_Lock(&decoder_lock);
+    ndspChnWaveBufClear(0);
+    memset(waveBufs, 0, sizeof(waveBufs));
+    bool sought = seek_stream(&tracks[index], tracks[index].start);
+    playing = sought;
+    if (sought) {
+        current_track = index;
+        effectsReset(decoder.rate);
+    }
+    LightLock_Unlock(&decoder_lock);
+    if (!sought)
+        return false;
+
+    paused = false;
+    resume.pending = false;
+    ndspChnSetPaused(0, false);
+    boostTrackStart(index);
+    record_play(index);
+    fill_wave_buffers(false);
+    return true;
 }
+
 /*Function to play a track by index
 This function stops any currently playing track, sets the current track index,
-opens the OGG file using the ov_open_callbacks function, and initializes the wave buffer
-The wave buffer is set to the audio buffer and marked as done
-The NDSP channel is set to play the wave buffer
+opens the OGG stream through the shared decoder, configures the channel, and primes the wave buffers
+Every wave buffer is decoded into and queued straight away
+so the DSP starts with a full queue
 The playing flag is set to true to indicate that playback is in progress
 The playerPlay function should be called with the index of the track to play
 The index should be between 0 and the number of tracks - 1
@@ -164,32 +525,368 @@ The playerExit function should be called to clean up resources.
 */
 // Function to start playback of a track by index
 // This function stops any currently playing track, sets the current track index,
-// opens the OGG file using the ov_open_callbacks function, and initializes the wave buffer.
+// opens the OGG stream through the shared decoder, and primes the wave buffers.
+// A CUE track of the file that is already open is jumped to on the open stream instead.
 void playerPlay(int index) {
-    if (playing) {
-        playerStop();
-    }
+    if (index < 0 || index >= track_count || (audio_buffer && jump_within_file(index)))
+        return;
 
-    current_track = index;
-    tracks[index].offset = 0;
+    // Also closes a track that finished by itself and resets the channel between tracks
+    playerStop();
 
-    ov_callbacks callbacks = {
-        .read_func = mem_read_func,
-        .seek_func = mem_seek_func,
-        .close_func = mem_close_func,
-        .tell_func = mem_tell_func
-    };
+    // A resize_queue that lost the queue is retried by playerStop; without one there is nothing to play into
+    if (!audio_buffer)
+        return;
+
+    current_track = index;
+    Track* track = &tracks[index];
+    boostTrackStart(index);
 
-    if (ov_open_callbacks(&tracks[index], &vf, NULL, 0, callbacks) < 0) {
+    bool opened = track->data
+        ? decoderOpenMemory(&decoder, track->data, track->size)
+        : decoderOpenFile(&decoder, library.file, library.tracks[track->packIndex].dataOffset, track->size);
+    if (!opened) {
         return; // Failed to open OGG
     }
+    configure_channel(index);
+    effectsReset(decoder.rate);
+    if (track->data && decoder.format == DECODER_VORBIS)
+        load_seek_table(track);
+
+    // A CUE track starts partway into its file
+    decode_position = 0;
+    if (track->start > 0 && !seek_stream(track, track->start)) {
+        decoderClose(&decoder);
+        return;
+    }
+    record_play(index);
 
-    memset(&waveBuf, 0, sizeof(ndspWaveBuf));
-    waveBuf.data_vaddr = audio_buffer;
-    waveBuf.status = NDSP_WBUF_DONE;
-
-    ndspChnWaveBufAdd(0, &waveBuf);
+    memset(waveBufs, 0, sizeof(waveBufs));
     playing = true;
+    fill_wave_buffers(false);
+}
+
+// True while the track is decoding or the DSP still has queued audio from it, paused or not
+bool playerIsPlaying(void) {
+    return playing || paused || ndspChnIsPlaying(0);
+}
+
+/* Pause without tearing anything down
+The channel is frozen where it is, so the queued wave buffers, the decoder
+and the seek position all stay as they were and the callback leaves them
+alone. Resuming only unfreezes the channel: the DSP plays on from the next
+frame with a full queue. How long that took is measured from here to the
+first callback that sees the channel's position move.
+*/
+void playerPause(bool pause) {
+    if (pause == paused || (pause && !playerIsPlaying()))
+        return;
+
+    if (!pause) {
+        resume.tick = svcGetSystemTick();
+        resume.position = ndspChnGetSamplePos(0);
+        resume.sequence = ndspChnGetWaveBufSeq(0);
+        resume.pending = true;
+    }
+    paused = pause;
+    ndspChnSetPaused(0, pause);
+}
+
+bool playerIsPaused(void) {
+    return paused;
+}
+
+/* The track being heard
+Decoding runs on from one CUE track into the next of the same file without
+a gap, so which one is audible follows the DSP: the sample it is playing is
+where the playing wave buffer began plus its position in that buffer. Once
+that crosses into the next track of the file, it becomes the current one
+for seeks and is counted as played.
+*/
+int playerCurrentTrack(void) {
+    if (current_track < 0 || !library_loaded || !library.cueStarts)
+        return current_track;
+
+    LightLock_Lock(&decoder_lock);
+    int heard = current_track;
+    u16 sequence = ndspChnGetWaveBufSeq(0);
+    for (int i = 0; i < wavebuf_count; ++i) {
+        if (waveBufs[i].status != NDSP_WBUF_PLAYING || waveBufs[i].sequence_id != sequence)
+            continue;
+        u32 position = buffer_start[i] + ndspChnGetSamplePos(0);
+        while (heard + 1 < track_count && same_file(heard, heard + 1) && position >= tracks[heard + 1].start)
+            heard++;
+        break;
+    }
+    bool changed = heard != current_track;
+    current_track = heard;
+    LightLock_Unlock(&decoder_lock);
+
+    if (changed) {
+        boostTrackStart(heard);
+        record_play(heard);
+    }
+    return heard;
+}
+
+bool playerPollResumeLatency(float* ms) {
+    if (!resume.measured)
+        return false;
+    *ms = resume.ms;
+    resume.measured = false;
+    return true;
+}
+
+/* Function to seek within the playing track
+Tracks jump straight to the nearest seek table page with ov_raw_seek
+and decode forward to the exact sample, so there is no bisection over the file.
+Without a table (cache write failed, say) it falls back to Tremor's own ov_pcm_seek.
+WAV tracks need no table; the decoder computes the offset.
+CUE tracks count `seconds` from their own start, not the file's.
+The queue is dropped first: its audio is from before the seek, and the
+decode up to the target sample goes through the wave buffers.
+*/
+void playerSeek(float seconds) {
+    if (!playing || seconds < 0.0f)
+        return;
+
+    LightLock_Lock(&decoder_lock);
+    ndspChnWaveBufClear(0);
+    memset(waveBufs, 0, sizeof(waveBufs));
+    Track* track = &tracks[current_track];
+    playing = seek_stream(track, track->start + (ogg_int64_t)(seconds * decoder.rate));
+    effectsReset(decoder.rate);
+    LightLock_Unlock(&decoder_lock);
+    fill_wave_buffers(false);
+}
+
+// Swapped under the decoder lock, so the callback never runs half a chain
+bool playerSetEffects(const EffectConfig* chain, u32 count, char* error, u32 errorSize) {
+    LightLock_Lock(&decoder_lock);
+    bool configured = effectsConfigure(chain, count, error, errorSize);
+    LightLock_Unlock(&decoder_lock);
+    return configured;
+}
+
+int playerTrackCount(void) {
+    return track_count;
+}
+
+const char* playerTrackTitle(int index) {
+    if (index < 0 || index >= track_count)
+        return "";
+    if (library_loaded)
+        return packString(&library, library.tracks[tracks[index].packIndex].title);
+    return assetGet(index)->name;
+}
+
+const char* playerTrackArtist(int index) {
+    if (index < 0 || index >= track_count || !library_loaded)
+        return "";
+    return packString(&library, library.tracks[tracks[index].packIndex].artist);
+}
+
+const char* playerTrackAlbum(int index) {
+    if (index < 0 || index >= track_count || !library_loaded)
+        return "";
+    return packString(&library, library.tracks[tracks[index].packIndex].album);
+}
+
+// Track length in seconds, or 0 if it isn't known without opening the track
+float playerTrackLength(int index) {
+    if (index < 0 || index >= track_count)
+        return 0.0f;
+
+    if (library_loaded) {
+        const PackTrack* entry = &library.tracks[tracks[index].packIndex];
+        return entry->sampleRate ? (float)entry->totalSamples / entry->sampleRate : 0.0f;
+    }
+    const EmbeddedAsset* asset = assetGet(index);
+    if (asset->sampleRate)
+        return (float)asset->totalSamples / asset->sampleRate;
+
+    float length = 0.0f;
+    LightLock_Lock(&decoder_lock);
+    if (playing && index == current_track)
+        length = (float)decoderTotalSamples(&decoder) / decoder.rate;
+    LightLock_Unlock(&decoder_lock);
+    return length;
+}
+
+/* Vorbis comment packet of a track, malloc'd
+Reads through its own file handle so it never disturbs the playing stream,
+which makes it safe to call from a background thread.
+*/
+u8* playerTrackComments(int index, u32* size) {
+    if (index < 0 || index >= track_count)
+        return NULL;
+
+    Track* track = &tracks[index];
+    if (track->data)
+        return oggReadHeaderPacket(track->data, track->size, 1, size, NULL);
+
+    const PackTrack* entry = &library.tracks[track->packIndex];
+    FILE* file = fopen(PLAYER_LIBRARY_PATH, "rb");
+    if (!file)
+        return NULL;
+
+    u8* headers = (u8*)malloc(entry->headerSize);
+    u8* packet = NULL;
+    if (headers && fseek(file, entry->dataOffset, SEEK_SET) == 0 &&
+        fread(headers, 1, entry->headerSize, file) == entry->headerSize)
+        packet = oggReadHeaderPacket(headers, entry->headerSize, 1, size, NULL);
+    free(headers);
+    fclose(file);
+    return packet;
+}
+
+/* Cache key identifying a track's content
+Embedded tracks hash their data. Pack tracks hash what the directory already
+knows about them (tags, length, sizes) so no track data has to be read.
+*/
+CacheKey playerTrackCacheKey(int index) {
+    if (index < 0 || index >= track_count)
+        return (CacheKey){ 0, 0 };
+
+    Track* track = &tracks[index];
+    if (track->data)
+        return cacheKeyForMemory(track->data, track->size);
+
+    const PackTrack* entry = &library.tracks[track->packIndex];
+    char identity[512];
+    int length = snprintf(identity, sizeof(identity), "%lu/%lu/%lu/%s/%s/%s",
+        (unsigned long)entry->totalSamples, (unsigned long)entry->dataSize, (unsigned long)entry->headerSize,
+        packString(&library, entry->title), packString(&library, entry->artist), packString(&library, entry->album));
+    if (length >= (int)sizeof(identity))
+        length = sizeof(identity) - 1;
+
+    CacheKey key = cacheKeyForMemory(identity, length);
+    key.size = entry->dataSize;
+    return key;
+}
+
+/* Library search
+Packs carry a trigram index, so a query only touches the posting lists of its
+trigrams. Embedded tracks are few enough to just compare every title.
+*/
+u32 playerSearch(const char* query, u32* results, u32 maxResults) {
+    if (library_loaded && library.trigrams)
+        return searchQuery(&library, query, results, maxResults);
+
+    u32 count = 0;
+    for (int i = 0; i < track_count && count < maxResults; ++i) {
+        const char* fields[3] = { playerTrackTitle(i), playerTrackArtist(i), playerTrackAlbum(i) };
+        if (searchMatches(query, fields, 3))
+            results[count++] = i;
+    }
+    return count;
+}
+
+// === SORTING ===
+
+const char* playerSortName(PlayerSort sort) {
+    static const char* const names[PLAYER_SORT_COUNT] = { "Library", "Title", "Artist", "Album" };
+    return sort >= 0 && sort < PLAYER_SORT_COUNT ? names[sort] : "";
+}
+
+const u32* playerSortOrder(PlayerSort sort) {
+    if (sort < 0 || sort >= PLAYER_SORT_COUNT)
+        sort = PLAYER_SORT_LIBRARY;
+    return sort_orders[sort];
+}
+
+u32 playerSortPosition(PlayerSort sort, int index) {
+    if (sort < 0 || sort >= PLAYER_SORT_COUNT || index < 0 || index >= track_count || !sort_ranks[sort])
+        return 0;
+    return sort_ranks[sort][index];
+}
+
+static int compare_ranks(const void* a, const void* b) {
+    u32 x = sorting_ranks[*(const u32*)a];
+    u32 y = sorting_ranks[*(const u32*)b];
+    return x < y ? -1 : x > y;
+}
+
+// Ranks are the precomputed sort keys, so this never compares strings
+void playerSortTracks(PlayerSort sort, u32* indices, u32 count) {
+    if (sort <= PLAYER_SORT_LIBRARY || sort >= PLAYER_SORT_COUNT || !sort_ranks[sort])
+        return;
+    sorting_ranks = sort_ranks[sort];
+    qsort(indices, count, sizeof(u32), compare_ranks);
+}
+
+// === SMART PLAYLIST COLUMNS ===
+
+_Static_assert((int)FILTER_TEXT_GENRE == (int)PACK_TEXT_GENRE && (int)FILTER_TEXT_ARTIST == (int)PACK_TEXT_ARTIST &&
+               (int)FILTER_TEXT_ALBUM == (int)PACK_TEXT_ALBUM, "column order mismatch");
+
+/* Columns for filter.h
+Tag columns exist only in packs built with them (PACK_SECTION_COLUMNS);
+lengths are known for every pack track and left at 0 (unknown) for embedded
+ones. Play history is looked up once per track here and kept current by
+playerPlay, so later playlist runs never touch the history file.
+*/
+const FilterColumns* playerFilterColumns(void) {
+    if (filter_columns_ready || !audio_initialized)
+        return &filter_columns;
+
+    u32 count = track_count;
+    filter_columns.trackCount = count;
+    track_seconds = (u16*)calloc(count ? count : 1, sizeof(u16));
+    last_played = (u32*)calloc(count ? count : 1, sizeof(u32));
+    play_counts = (u16*)calloc(count ? count : 1, sizeof(u16));
+    if (!track_seconds || !last_played || !play_counts) {
+        free(track_seconds);
+        free(last_played);
+        free(play_counts);
+        track_seconds = NULL;
+        last_played = NULL;
+        play_counts = NULL;
+        filter_columns.trackCount = 0;
+        return &filter_columns;
+    }
+    statsMemory(STATS_MEMORY_LIBRARY, (count ? count : 1) * (2 * sizeof(u16) + sizeof(u32)));
+
+    for (u32 i = 0; i < count; ++i) {
+        float seconds = playerTrackLength(i);
+        track_seconds[i] = seconds > 0xFFFF ? 0xFFFF : (u16)(seconds + 0.5f);
+
+        u32 plays;
+        historyLookup(playerTrackCacheKey(i), &last_played[i], &plays);
+        play_counts[i] = plays > 0xFFFF ? 0xFFFF : plays;
+    }
+    filter_columns.number[FILTER_NUMBER_LENGTH].values = track_seconds;
+    filter_columns.number[FILTER_NUMBER_PLAYS].values = play_counts;
+    filter_columns.number[FILTER_NUMBER_LASTPLAYED].values = last_played;
+    filter_columns.number[FILTER_NUMBER_LASTPLAYED].wide = true;
+
+    if (library_loaded && library.years) {
+        filter_columns.number[FILTER_NUMBER_YEAR].values = library.years;
+        for (int column = 0; column < FILTER_TEXT_COUNT; ++column) {
+            u32 names = library.columnNameCount[column];
+            column_names[column] = (const char**)malloc((names ? names : 1) * sizeof(char*));
+            if (!column_names[column])
+                continue;
+            statsMemory(STATS_MEMORY_LIBRARY, (names ? names : 1) * sizeof(char*));
+            for (u32 i = 0; i < names; ++i)
+                column_names[column][i] = packString(&library, library.columnNames[column][i]);
+            filter_columns.text[column].ids = library.columnIds[column];
+            filter_columns.text[column].names = column_names[column];
+            filter_columns.text[column].nameCount = names;
+        }
+    }
+
+    filter_columns_ready = true;
+    return &filter_columns;
+}
+
+_Static_assert(PLAYER_WAVEFORM_POINTS == PACK_WAVEFORM_POINTS, "waveform size mismatch");
+
+// Overview of the track's peaks, PLAYER_WAVEFORM_POINTS values, or NULL if the pack has none
+const unsigned char* playerTrackWaveform(int index) {
+    if (index < 0 || index >= track_count || !library_loaded || !library.waveforms)
+        return NULL;
+    return library.waveforms + tracks[index].packIndex * PACK_WAVEFORM_POINTS;
 }
 /* Function to exit the audio player
 This function stops any currently playing track, resets the NDSP channel,
@@ -199,15 +896,43 @@ The playerExit function should be called at the end of the program
 to clean up resources.
 */
 void playerExit(void) {
-    if (playing) {
-        playerStop();
-    }
-
     if (audio_initialized) {
-        ndspChnReset(0);
+        playerStop();
+        memoryUnsubscribe(release_seek_tables, NULL);
+        memoryUnsubscribe(release_queue, NULL);
+        boostExit();
         ndspExit();
-        free(audio_buffer);
+        linearFree(audio_buffer);
         audio_buffer = NULL;
+        for (int i = 0; i < track_count; ++i) {
+            if (tracks[i].seekOwned)
+                free((void*)tracks[i].seek);
+        }
+        free(tracks);
+        tracks = NULL;
+        free(sort_tables);
+        sort_tables = NULL;
+        for (int i = 0; i < FILTER_TEXT_COUNT; ++i) {
+            free(column_names[i]);
+            column_names[i] = NULL;
+        }
+        free(track_seconds);
+        free(last_played);
+        free(play_counts);
+        track_seconds = NULL;
+        last_played = NULL;
+        play_counts = NULL;
+        memset(&filter_columns, 0, sizeof(filter_columns));
+        filter_columns_ready = false;
+        historySave();
+        historyExit();
+        memset(sort_orders, 0, sizeof(sort_orders));
+        memset(sort_ranks, 0, sizeof(sort_ranks));
+        track_count = 0;
+        if (library_loaded) {
+            packClose(&library);
+            library_loaded = false;
+        }
         audio_initialized = false;
     }
 }
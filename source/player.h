@@ -1,8 +1,66 @@
 #ifndef PLAYER_H
 #define PLAYER_H
 
+#include <stdbool.h>
+#include "cache.h"
+#include "effects.h"
+#include "filter.h"
+
 void playerInit(void);
-void playerPlayTrack(int index);
+void playerPlay(int index);
+void playerStop(void);
+void playerSeek(float seconds);
 void playerExit(void);
+bool playerIsPlaying(void);
+
+// Freezes the channel in place; queued audio and the decoder stay warm so resuming is immediate
+void playerPause(bool paused);
+bool playerIsPaused(void);
+
+// Track being heard, which moves on by itself when a CUE track runs into the next one of its file; main thread only
+int playerCurrentTrack(void);
+
+// Milliseconds from the last resume until the DSP played again; true once per measured resume
+bool playerPollResumeLatency(float* ms);
+
+// Replaces the effects chain (see effects.h); false with the reason if it is invalid or over the CPU budget
+bool playerSetEffects(const EffectConfig* chain, u32 count, char* error, u32 errorSize);
+
+int playerTrackCount(void);
+const char* playerTrackTitle(int index);
+const char* playerTrackArtist(int index);
+const char* playerTrackAlbum(int index);
+float playerTrackLength(int index);
+
+#define PLAYER_WAVEFORM_POINTS 64
+const unsigned char* playerTrackWaveform(int index);
+
+u8* playerTrackComments(int index, u32* size);
+CacheKey playerTrackCacheKey(int index);
+
+// Tracks whose title, artist or album match `query` (see search.h), in library order; returns the count
+u32 playerSearch(const char* query, u32* results, u32 maxResults);
+
+typedef enum {
+    PLAYER_SORT_LIBRARY,  // order tracks were added to the pack
+    PLAYER_SORT_TITLE,
+    PLAYER_SORT_ARTIST,
+    PLAYER_SORT_ALBUM,
+    PLAYER_SORT_COUNT
+} PlayerSort;
+
+const char* playerSortName(PlayerSort sort);
+
+// Track indices in `sort` order, playerTrackCount() of them; valid until playerExit
+const u32* playerSortOrder(PlayerSort sort);
+
+// Where a track appears in `sort` order
+u32 playerSortPosition(PlayerSort sort, int index);
+
+// Reorders track indices (e.g. search results) into `sort` order
+void playerSortTracks(PlayerSort sort, u32* indices, u32 count);
+
+// Tag, length and play history columns for smart playlists; built on first use, valid until playerExit
+const FilterColumns* playerFilterColumns(void);
 
 #endif // PLAYER_H
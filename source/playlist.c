@@ -0,0 +1,93 @@
+#include "playlist.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define PLAYLIST_LINE_LENGTH 256
+
+typedef struct {
+    char name[PLAYLIST_NAME_LENGTH];
+    char error[PLAYLIST_ERROR_LENGTH];
+    FilterProgram program;
+    bool compiled;
+} Playlist;
+
+static struct {
+    Playlist lists[PLAYLIST_MAX];
+    int count;
+    const FilterColumns* columns;
+} playlists;
+
+static const char* const defaults[] = {
+    "Not played in 30 days: lastplayed >= 30",
+    "Most played: plays >= 5",
+    "Short tracks: length < 180",
+};
+
+static char* trim(char* text) {
+    while (*text == ' ' || *text == '\t')
+        text++;
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+        *--end = '\0';
+    return text;
+}
+
+static void add_playlist(const char* definition) {
+    char line[PLAYLIST_LINE_LENGTH];
+    snprintf(line, sizeof(line), "%s", definition);
+    char* text = trim(line);
+    char* colon = strchr(text, ':');
+    if (!*text || *text == '#' || !colon || playlists.count >= PLAYLIST_MAX)
+        return;
+
+    *colon = '\0';
+    Playlist* list = &playlists.lists[playlists.count++];
+    snprintf(list->name, sizeof(list->name), "%s", trim(text));
+    list->compiled = filterCompile(&list->program, trim(colon + 1), playlists.columns, list->error, sizeof(list->error));
+}
+
+int playlistLoad(const char* path, const FilterColumns* columns) {
+    playlistExit();
+    playlists.columns = columns;
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        for (u32 i = 0; i < sizeof(defaults) / sizeof(defaults[0]); ++i)
+            add_playlist(defaults[i]);
+        return playlists.count;
+    }
+
+    char line[PLAYLIST_LINE_LENGTH];
+    while (fgets(line, sizeof(line), file))
+        add_playlist(line);
+    fclose(file);
+    return playlists.count;
+}
+
+void playlistExit(void) {
+    for (int i = 0; i < playlists.count; ++i)
+        filterFree(&playlists.lists[i].program);
+    memset(&playlists, 0, sizeof(playlists));
+}
+
+int playlistCount(void) {
+    return playlists.count;
+}
+
+const char* playlistName(int index) {
+    return index >= 0 && index < playlists.count ? playlists.lists[index].name : "";
+}
+
+const char* playlistError(int index) {
+    if (index < 0 || index >= playlists.count)
+        return NULL;
+    return playlists.lists[index].compiled ? NULL : playlists.lists[index].error;
+}
+
+u32 playlistRun(int index, u32* results, u32 maxResults) {
+    if (index < 0 || index >= playlists.count || !playlists.lists[index].compiled)
+        return 0;
+    return filterRun(&playlists.lists[index].program, playlists.columns, (u32)time(NULL), results, maxResults);
+}
@@ -0,0 +1,32 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <3ds.h>
+#include "filter.h"
+
+/* Smart playlists
+Named queries (see filter.h) read from PLAYLIST_PATH, one per line as
+"Name: query", with blank lines and lines starting with # ignored. Each
+query is compiled once when loaded, so showing a playlist only runs its
+program over the columns. Without the file a few defaults are used.
+*/
+
+#define PLAYLIST_PATH         "sdmc:/3ds/3dXMMP/playlists.txt"
+#define PLAYLIST_MAX          16
+#define PLAYLIST_NAME_LENGTH  32
+#define PLAYLIST_ERROR_LENGTH 64
+
+// Returns how many playlists were loaded, including ones whose query didn't compile
+int playlistLoad(const char* path, const FilterColumns* columns);
+void playlistExit(void);
+
+int playlistCount(void);
+const char* playlistName(int index);
+
+// Why the playlist's query didn't compile, or NULL if it did
+const char* playlistError(int index);
+
+// Tracks currently in the playlist, in library order; returns the count written
+u32 playlistRun(int index, u32* results, u32 maxResults);
+
+#endif // PLAYLIST_H
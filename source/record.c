@@ -0,0 +1,68 @@
+#include "record.h"
+
+#include <stdio.h>
+
+#define RECORD_BUFFER_FRAMES 256  // about 4 s of frames per write
+
+static struct {
+    FILE* file;
+    RecordFrame buffer[RECORD_BUFFER_FRAMES];
+    u32 buffered;
+    u64 lastTick;
+} record;
+
+static bool flush_frames(void) {
+    bool ok = fwrite(record.buffer, sizeof(RecordFrame), record.buffered, record.file) == record.buffered;
+    record.buffered = 0;
+    return ok;
+}
+
+bool recordStart(const char* path) {
+    recordStop();
+    record.file = fopen(path, "wb");
+    if (!record.file)
+        return false;
+
+    RecordHeader header = { RECORD_MAGIC, RECORD_LAYOUT };
+    if (fwrite(&header, sizeof(header), 1, record.file) != 1) {
+        fclose(record.file);
+        record.file = NULL;
+        return false;
+    }
+    record.lastTick = svcGetSystemTick();
+    return true;
+}
+
+void recordStop(void) {
+    if (!record.file)
+        return;
+    if (record.buffered > 0)
+        flush_frames();
+    fclose(record.file);
+    record.file = NULL;
+}
+
+bool recordIsActive(void) {
+    return record.file != NULL;
+}
+
+void recordFrame(u32 down, u32 held, u32 up, u32 repeat, const touchPosition* touch) {
+    if (!record.file)
+        return;
+
+    u64 now = svcGetSystemTick();
+    u64 ticks = now - record.lastTick;
+    record.lastTick = now;
+
+    RecordFrame* frame = &record.buffer[record.buffered++];
+    frame->down = down;
+    frame->held = held;
+    frame->up = up;
+    frame->repeat = repeat;
+    frame->touchX = touch->px;
+    frame->touchY = touch->py;
+    frame->ticks = ticks > 0xFFFFFFFFu ? 0xFFFFFFFFu : (u32)ticks;
+
+    if (record.buffered == RECORD_BUFFER_FRAMES && !flush_frames())
+        recordStop();
+}
@@ -0,0 +1,42 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <3ds.h>
+
+/* Input recording
+Every main loop iteration's keys and touch point are appended to a file,
+along with the ticks since the previous iteration, so a session can be
+replayed frame for frame on a PC (tools/replay.c). Recording covers a
+whole session from launch: hold L+R while the app starts. Replays are only
+exact from the same starting point, so keep a copy of the SD card's
+3dXMMP directory as it was when the recording began.
+*/
+
+#define RECORD_PATH    "sdmc:/3ds/3dXMMP/input.rec"
+#define RECORD_MAGIC   0x52494D58u  // "XMIR"
+#define RECORD_LAYOUT  1
+
+typedef struct {
+    u32 magic;
+    u32 layout;
+} RecordHeader;
+
+// One per main loop iteration, as hidScanInput and hidTouchRead reported it
+typedef struct {
+    u32 down;
+    u32 held;
+    u32 up;
+    u32 repeat;
+    u16 touchX;
+    u16 touchY;
+    u32 ticks;  // since the previous frame, or since recordStart for the first
+} RecordFrame;
+
+bool recordStart(const char* path);
+void recordStop(void);
+bool recordIsActive(void);
+
+// Appends a frame; a write error stops the recording
+void recordFrame(u32 down, u32 held, u32 up, u32 repeat, const touchPosition* touch);
+
+#endif // RECORD_H
@@ -0,0 +1,302 @@
+#include "search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_FIELD_LENGTH 256  // longer fields are only matched on their first part
+#define SEARCH_MAX_FIELDS   3
+
+// U+00C0 to U+00FF without accents; the multiplication and division signs become spaces
+static const char latin1_fold[64] =
+    "aaaaaaaceeeeiiiidnooooo ouuuuyts"
+    "aaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+static u32 trigram_key(const char* p) {
+    return ((u32)(u8)p[0] << 16) | ((u32)(u8)p[1] << 8) | (u8)p[2];
+}
+
+u32 searchFold(const char* text, char* out, u32 size) {
+    const u8* p = (const u8*)text;
+    u32 length = 0;
+    bool space = true;  // drops leading spaces and collapses runs
+
+    while (*p && length + 1 < size) {
+        char c;
+        if (*p < 0x80) {
+            c = *p++;
+            if (c >= 'A' && c <= 'Z')
+                c += 'a' - 'A';
+            else if (!(c >= 'a' && c <= 'z') && !(c >= '0' && c <= '9'))
+                c = ' ';
+        } else if (*p == 0xC3 && p[1] >= 0x80 && p[1] <= 0xBF) {
+            c = latin1_fold[p[1] - 0x80];
+            p += 2;
+        } else {
+            // Other scripts are indexed byte for byte
+            out[length++] = *p++;
+            space = false;
+            continue;
+        }
+
+        if (c == ' ') {
+            if (space)
+                continue;
+            space = true;
+        } else {
+            space = false;
+        }
+        out[length++] = c;
+    }
+
+    if (length > 0 && out[length - 1] == ' ')
+        length--;
+    out[length] = '\0';
+    return length;
+}
+
+// Folds each field and joins them with SEARCH_FIELD_SEPARATOR; returns the length
+static u32 fold_fields(const char* const* fields, u32 fieldCount, char* out) {
+    u32 length = 0;
+    for (u32 i = 0; i < fieldCount && i < SEARCH_MAX_FIELDS; ++i) {
+        if (i > 0)
+            out[length++] = SEARCH_FIELD_SEPARATOR;
+        length += searchFold(fields[i], out + length, SEARCH_FIELD_LENGTH);
+    }
+    out[length] = '\0';
+    return length;
+}
+
+// === MATCHING ===
+
+// Short words match word starts only, so "be" finds "Beatles" but not "Abbey"
+static bool text_has_word(const char* text, const char* word, u32 length) {
+    for (const char* p = text; (p = strchr(p, word[0])) != NULL; ++p) {
+        if (strncmp(p, word, length) != 0)
+            continue;
+        if (length > 2 || p == text || p[-1] == ' ' || p[-1] == SEARCH_FIELD_SEPARATOR)
+            return true;
+    }
+    return false;
+}
+
+static bool matches_text(const char* query, const char* text) {
+    for (const char* word = query; *word;) {
+        u32 length = strcspn(word, " ");
+        if (!text_has_word(text, word, length))
+            return false;
+
+        word += length;
+        while (*word == ' ')
+            word++;
+    }
+    return true;
+}
+
+bool searchMatches(const char* query, const char* const* fields, u32 fieldCount) {
+    char folded[SEARCH_MAX_QUERY + 1];
+    char text[SEARCH_MAX_FIELDS * (SEARCH_FIELD_LENGTH + 1)];
+    searchFold(query, folded, sizeof(folded));
+    fold_fields(fields, fieldCount, text);
+    return matches_text(folded, text);
+}
+
+// === INDEX BUILDING ===
+
+static int compare_u64(const void* a, const void* b) {
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return x < y ? -1 : x > y;
+}
+
+u8* searchBuildIndex(const char* const* fields, u32 fieldsPerTrack, u32 trackCount, u32* size) {
+    // Every (trigram, track) pair as one sortable number, trigram in the high half
+    u32 pairCount = 0, pairCapacity = 1024;
+    u64* pairs = (u64*)malloc(pairCapacity * sizeof(u64));
+    if (fieldsPerTrack > SEARCH_MAX_FIELDS)
+        fieldsPerTrack = SEARCH_MAX_FIELDS;
+
+    // Folded text of every track, for checking candidates on device
+    u32* textOffsets = (u32*)malloc(trackCount * sizeof(u32) + 1);
+    u32 textSize = 0, textCapacity = 4096;
+    char* text = (char*)malloc(textCapacity);
+
+    char padded[SEARCH_FIELD_LENGTH + 2];
+    for (u32 track = 0; track < trackCount; ++track) {
+        if (textSize + SEARCH_MAX_FIELDS * (SEARCH_FIELD_LENGTH + 1) > textCapacity) {
+            textCapacity = textCapacity * 2 + SEARCH_MAX_FIELDS * (SEARCH_FIELD_LENGTH + 1);
+            text = (char*)realloc(text, textCapacity);
+        }
+        textOffsets[track] = textSize;
+        textSize += fold_fields(fields + track * fieldsPerTrack, fieldsPerTrack, text + textSize) + 1;
+
+        for (u32 f = 0; f < fieldsPerTrack; ++f) {
+            padded[0] = ' ';
+            u32 length = searchFold(fields[track * fieldsPerTrack + f], padded + 1, SEARCH_FIELD_LENGTH);
+            if (length == 0)
+                continue;
+            padded[length + 1] = ' ';
+            padded[length + 2] = '\0';
+
+            for (u32 i = 0; i + 3 <= length + 2; ++i) {
+                // Queries never contain spaces, so a space can only be useful at either end
+                if (padded[i + 1] == ' ')
+                    continue;
+                if (pairCount == pairCapacity) {
+                    pairCapacity *= 2;
+                    pairs = (u64*)realloc(pairs, pairCapacity * sizeof(u64));
+                }
+                pairs[pairCount++] = ((u64)trigram_key(padded + i) << 32) | track;
+            }
+        }
+    }
+    qsort(pairs, pairCount, sizeof(u64), compare_u64);
+
+    // Postings are the unique pairs; trigrams are the runs of equal keys
+    u32 postingCount = 0, trigramCount = 0;
+    for (u32 i = 0; i < pairCount; ++i) {
+        if (i > 0 && pairs[i] == pairs[i - 1])
+            continue;
+        if (postingCount == 0 || (pairs[i] >> 32) != (pairs[postingCount - 1] >> 32))
+            trigramCount++;
+        pairs[postingCount++] = pairs[i];
+    }
+
+    *size = sizeof(PackSearchHeader) + trigramCount * sizeof(PackTrigram) + (postingCount + trackCount) * sizeof(u32) +
+            textSize;
+    u8* section = (u8*)malloc(*size);
+    PackSearchHeader* header = (PackSearchHeader*)section;
+    PackTrigram* trigrams = (PackTrigram*)(header + 1);
+    u32* postings = (u32*)(trigrams + trigramCount);
+    header->trigramCount = trigramCount;
+    header->postingCount = postingCount;
+    header->textSize = textSize;
+    memcpy(postings + postingCount, textOffsets, trackCount * sizeof(u32));
+    memcpy(postings + postingCount + trackCount, text, textSize);
+
+    u32 t = 0;
+    for (u32 i = 0; i < postingCount; ++i) {
+        u32 key = (u32)(pairs[i] >> 32);
+        if (i == 0 || key != trigrams[t - 1].key) {
+            trigrams[t].key = key;
+            trigrams[t].first = i;
+            trigrams[t].count = 0;
+            t++;
+        }
+        trigrams[t - 1].count++;
+        postings[i] = (u32)pairs[i];
+    }
+
+    free(pairs);
+    free(textOffsets);
+    free(text);
+    return section;
+}
+
+// === QUERIES ===
+
+// First trigram with key >= `key`
+static u32 lower_bound(const Pack* pack, u32 key) {
+    u32 low = 0, high = pack->trigramCount;
+    while (low < high) {
+        u32 mid = (low + high) / 2;
+        if (pack->trigrams[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static const PackTrigram* find_trigram(const Pack* pack, u32 key) {
+    u32 i = lower_bound(pack, key);
+    return i < pack->trigramCount && pack->trigrams[i].key == key ? &pack->trigrams[i] : NULL;
+}
+
+static void set_postings(const Pack* pack, const PackTrigram* trigram, u32* bits) {
+    const u32* list = pack->postings + trigram->first;
+    for (u32 i = 0; i < trigram->count; ++i) {
+        if (list[i] < pack->trackCount)
+            bits[list[i] >> 5] |= 1u << (list[i] & 31);
+    }
+}
+
+/* Marks the tracks that can contain `word` in `bits`; exact for words up to three characters
+`scratch` is another bitmap of the same size. Each of a long word's trigrams is
+turned into a bitmap and ANDed in, which is linear in the posting lists rather
+than a lookup per candidate.
+*/
+static void match_word(const Pack* pack, const char* word, u32 length, u32* bits, u32* scratch, u32 words) {
+    if (length <= 2) {
+        char prefix[3] = { ' ', word[0], length == 2 ? word[1] : 0 };
+        u32 low = trigram_key(prefix);
+        u32 high = length == 2 ? low : low | 0xFF;
+        for (u32 i = lower_bound(pack, low); i < pack->trigramCount && pack->trigrams[i].key <= high; ++i)
+            set_postings(pack, &pack->trigrams[i], bits);
+        return;
+    }
+
+    for (u32 i = 0; i + 3 <= length; ++i) {
+        const PackTrigram* trigram = find_trigram(pack, trigram_key(word + i));
+        if (!trigram) {
+            memset(bits, 0, words * sizeof(u32));
+            return;
+        }
+        if (i == 0) {
+            set_postings(pack, trigram, bits);
+            continue;
+        }
+        memset(scratch, 0, words * sizeof(u32));
+        set_postings(pack, trigram, scratch);
+        for (u32 w = 0; w < words; ++w)
+            bits[w] &= scratch[w];
+    }
+}
+
+u32 searchQuery(const Pack* pack, const char* query, u32* results, u32 maxResults) {
+    char folded[SEARCH_MAX_QUERY + 1];
+    if (!pack->trigrams || searchFold(query, folded, sizeof(folded)) == 0)
+        return 0;
+
+    u32 words = (pack->trackCount + 31) / 32;
+    u32* matched = (u32*)malloc(words * sizeof(u32));
+    u32* wordBits = (u32*)malloc(words * sizeof(u32));
+    u32* scratch = (u32*)malloc(words * sizeof(u32));
+    if (!matched || !wordBits || !scratch) {
+        free(matched);
+        free(wordBits);
+        free(scratch);
+        return 0;
+    }
+    memset(matched, 0xFF, words * sizeof(u32));
+
+    bool verify = false;
+    for (const char* word = folded; *word;) {
+        u32 length = strcspn(word, " ");
+        verify |= length > 3;
+
+        memset(wordBits, 0, words * sizeof(u32));
+        match_word(pack, word, length, wordBits, scratch, words);
+        for (u32 i = 0; i < words; ++i)
+            matched[i] &= wordBits[i];
+
+        word += length;
+        while (*word == ' ')
+            word++;
+    }
+
+    u32 count = 0;
+    for (u32 i = 0; i < words && count < maxResults; ++i) {
+        for (u32 bits = matched[i]; bits && count < maxResults; bits &= bits - 1) {
+            u32 track = i * 32 + __builtin_ctz(bits);
+            if (track >= pack->trackCount)
+                break;
+            if (verify && !matches_text(folded, pack->searchText + pack->searchTextOffsets[track]))
+                continue;
+            results[count++] = track;
+        }
+    }
+
+    free(matched);
+    free(wordBits);
+    free(scratch);
+    return count;
+}
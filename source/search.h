@@ -0,0 +1,40 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <3ds.h>
+#include "pack.h"
+
+/* Library search over titles, artists and albums
+Text is folded first: ASCII and Latin-1 letters lose case and accents, and
+anything that isn't a letter or digit becomes a single space. mkpack stores
+the trigrams of every folded field, padded with a space on both sides so
+word starts get trigrams of their own, with the sorted list of tracks
+containing each one, plus every track's folded text (PACK_SECTION_SEARCH).
+
+A query is split into words and a track matches when every word does.
+One or two characters match the start of any word, through the " x?" and
+" xy" trigrams; three or more match anywhere, by intersecting the posting
+lists of the word's trigrams. Only words longer than a trigram need the
+candidates' stored text checked afterwards, which is a plain scan since it
+is already folded.
+*/
+
+#define SEARCH_MAX_QUERY       64
+#define SEARCH_FIELD_SEPARATOR '\x1f'  // joins a track's folded fields; never part of a query
+
+// Folds UTF-8 text into `out` (always NUL-terminated); returns the folded length
+u32 searchFold(const char* text, char* out, u32 size);
+
+// Whether a track with these fields matches the query, by folding and comparing text
+bool searchMatches(const char* query, const char* const* fields, u32 fieldCount);
+
+/* Builds the PACK_SECTION_SEARCH payload
+`fields` holds fieldsPerTrack strings for each track in order. Returns a
+malloc'd section and its size in *size.
+*/
+u8* searchBuildIndex(const char* const* fields, u32 fieldsPerTrack, u32 trackCount, u32* size);
+
+// Tracks matching `query` through the pack's index, in library order; returns how many were written
+u32 searchQuery(const Pack* pack, const char* query, u32* results, u32 maxResults);
+
+#endif // SEARCH_H
@@ -0,0 +1,161 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef __3DS__
+#include <malloc.h>
+#endif
+
+#define STATS_SAMPLE_EVERY 60  // frames between heap samples
+
+static const char* const memory_names[STATS_MEMORY_COUNT] = {
+    "heap", "linear", "audio", "library", "cache", "history", "art"
+};
+
+static struct {
+    u64 startTick;
+    time_t startTime;
+    u32 tracks;
+
+    u64 decodeTicks;
+    double decodedSeconds;
+    u32 realtime[STATS_REALTIME_BUCKETS];
+
+    u32 underruns;
+    float underrunTimes[STATS_MAX_UNDERRUNS];
+
+    s32 memory[STATS_MEMORY_COUNT];
+    s32 memoryPeak[STATS_MEMORY_COUNT];
+
+    u32 frames;
+    u32 frameBuckets[STATS_FRAME_BUCKETS];
+    u64 worstFrame;
+#ifdef __3DS__
+    u32 linearStart;  // free linear memory at statsStart
+#endif
+} stats;
+
+static float seconds_since_start(void) {
+    return (float)(svcGetSystemTick() - stats.startTick) / SYSCLOCK_ARM11;
+}
+
+void statsStart(void) {
+    memset(&stats, 0, sizeof(stats));
+    stats.startTick = svcGetSystemTick();
+    stats.startTime = time(NULL);
+#ifdef __3DS__
+    stats.linearStart = linearSpaceFree();
+#endif
+}
+
+void statsTrackPlayed(void) {
+    stats.tracks++;
+}
+
+void statsDecode(u64 ticks, u32 samples, u32 rate) {
+    if (samples == 0 || rate == 0)
+        return;
+
+    stats.decodeTicks += ticks;
+    double seconds = (double)samples / rate;
+    stats.decodedSeconds += seconds;
+
+    // Bucket 0 is below realtime, bucket n covers [2^(n-1), 2^n) times realtime
+    double realtime = ticks ? seconds * SYSCLOCK_ARM11 / ticks : 1e9;
+    int bucket = 0;
+    for (double limit = 1.0; realtime >= limit && bucket < STATS_REALTIME_BUCKETS - 1; limit *= 2.0)
+        bucket++;
+    stats.realtime[bucket]++;
+}
+
+void statsUnderrun(void) {
+    if (stats.underruns < STATS_MAX_UNDERRUNS)
+        stats.underrunTimes[stats.underruns] = seconds_since_start();
+    stats.underruns++;
+}
+
+void statsMemory(StatsMemory kind, s32 bytes) {
+    stats.memory[kind] += bytes;
+    if (stats.memory[kind] > stats.memoryPeak[kind])
+        stats.memoryPeak[kind] = stats.memory[kind];
+}
+
+// Whole-heap figures are sampled, not tracked per allocation
+static void sample_heaps(void) {
+#ifdef __3DS__
+    struct mallinfo info = mallinfo();
+    stats.memory[STATS_MEMORY_HEAP] = 0;
+    statsMemory(STATS_MEMORY_HEAP, (s32)info.uordblks);
+    stats.memory[STATS_MEMORY_LINEAR] = 0;
+    statsMemory(STATS_MEMORY_LINEAR, (s32)(stats.linearStart - linearSpaceFree()));
+#endif
+}
+
+void statsFrame(u64 ticks) {
+    if (stats.frames++ % STATS_SAMPLE_EVERY == 0)
+        sample_heaps();
+
+    u64 us = ticks * 1000000 / SYSCLOCK_ARM11;
+    u32 bucket = us / STATS_FRAME_BUCKET_US;
+    stats.frameBuckets[bucket < STATS_FRAME_BUCKETS ? bucket : STATS_FRAME_BUCKETS - 1]++;
+    if (ticks > stats.worstFrame)
+        stats.worstFrame = ticks;
+}
+
+// Upper edge of the bucket holding the given fraction of frames, in ms
+static float frame_percentile(float fraction) {
+    u32 rank = (u32)(stats.frames * fraction);
+    u32 seen = 0;
+    for (u32 i = 0; i < STATS_FRAME_BUCKETS; ++i) {
+        seen += stats.frameBuckets[i];
+        if (seen > rank)
+            return (i + 1) * STATS_FRAME_BUCKET_US / 1000.0f;
+    }
+    return STATS_FRAME_BUCKETS * STATS_FRAME_BUCKET_US / 1000.0f;
+}
+
+bool statsWrite(const char* path) {
+    FILE* file = fopen(path, "a");
+    if (!file)
+        return false;
+
+    sample_heaps();
+    char date[32] = "unknown";
+    struct tm* local = localtime(&stats.startTime);
+    if (local)
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", local);
+    fprintf(file, "session %s, %.0f s\n", date, seconds_since_start());
+
+    double cpu = (double)stats.decodeTicks / SYSCLOCK_ARM11;
+    fprintf(file, "tracks %lu, decoded %.1f s of audio in %.1f s CPU (%.1fx realtime)\n", (unsigned long)stats.tracks,
+        stats.decodedSeconds, cpu, cpu > 0.0 ? stats.decodedSeconds / cpu : 0.0);
+
+    fprintf(file, "batches by realtime:");
+    for (int i = 0; i < STATS_REALTIME_BUCKETS; ++i) {
+        if (i == 0)
+            fprintf(file, " <1x %lu", (unsigned long)stats.realtime[i]);
+        else if (i == STATS_REALTIME_BUCKETS - 1)
+            fprintf(file, ", >=%dx %lu", 1 << (i - 1), (unsigned long)stats.realtime[i]);
+        else
+            fprintf(file, ", %d-%dx %lu", 1 << (i - 1), 1 << i, (unsigned long)stats.realtime[i]);
+    }
+
+    fprintf(file, "\nunderruns %lu", (unsigned long)stats.underruns);
+    u32 kept = stats.underruns < STATS_MAX_UNDERRUNS ? stats.underruns : STATS_MAX_UNDERRUNS;
+    for (u32 i = 0; i < kept; ++i)
+        fprintf(file, "%s%.1f", i == 0 ? " at " : " ", stats.underrunTimes[i]);
+
+    fprintf(file, "\npeak KiB:");
+    for (int i = 0; i < STATS_MEMORY_COUNT; ++i)
+        fprintf(file, "%s %s %ld", i == 0 ? "" : ",", memory_names[i], (long)(stats.memoryPeak[i] + 1023) / 1024);
+
+    fprintf(file, "\nframes %lu", (unsigned long)stats.frames);
+    if (stats.frames)
+        fprintf(file, ", ms p50 %.2f p95 %.2f p99 %.2f max %.2f", frame_percentile(0.5f), frame_percentile(0.95f),
+            frame_percentile(0.99f), stats.worstFrame * 1000.0f / SYSCLOCK_ARM11);
+    fprintf(file, "\n\n");
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
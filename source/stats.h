@@ -0,0 +1,51 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <3ds.h>
+
+/* Session performance statistics
+Fixed counters filled in while the app runs and appended to STATS_PATH as
+a few lines of text when it exits, for debugging on someone else's 3DS:
+tracks played, decode CPU time and how far ahead of realtime each batch
+decoded, underruns with their times, peak memory per subsystem, and the
+distribution of UI frame times. Nothing allocates after startup; each
+counter is written from one thread (the NDSP callback for decode figures,
+the art job for its scratch memory, the main thread for the rest).
+*/
+
+#define STATS_PATH              "sdmc:/3ds/3dXMMP/stats.txt"
+#define STATS_MAX_UNDERRUNS     32    // times kept; the count goes on
+#define STATS_REALTIME_BUCKETS  8     // <1x, then doubling from 1x to >= 64x
+#define STATS_FRAME_BUCKET_US   250
+#define STATS_FRAME_BUCKETS     256   // up to 64 ms; longer frames land in the last one
+
+typedef enum {
+    STATS_MEMORY_HEAP,     // whole heap in use, sampled on the main thread
+    STATS_MEMORY_LINEAR,   // linear heap in use, sampled the same way
+    STATS_MEMORY_AUDIO,    // wave buffers and the latency capture
+    STATS_MEMORY_LIBRARY,  // track table, sort orders, smart playlist columns
+    STATS_MEMORY_CACHE,    // cache index
+    STATS_MEMORY_HISTORY,  // play history
+    STATS_MEMORY_ART,      // cover decoding scratch
+    STATS_MEMORY_COUNT
+} StatsMemory;
+
+// Marks the session's start; underrun times are counted from here
+void statsStart(void);
+
+void statsTrackPlayed(void);
+
+// From the decode path: ticks spent decoding `samples` frames at `rate`
+void statsDecode(u64 ticks, u32 samples, u32 rate);
+void statsUnderrun(void);
+
+// Bytes a subsystem allocated (positive) or freed (negative); the peak is kept
+void statsMemory(StatsMemory kind, s32 bytes);
+
+// CPU ticks the main thread spent on a rendered frame, leaving out the wait for vsync
+void statsFrame(u64 ticks);
+
+// Appends the session summary; false if the file can't be written
+bool statsWrite(const char* path);
+
+#endif // STATS_H
@@ -0,0 +1,141 @@
+#include "trace.h"
+
+#ifdef TRACE_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __3DS__
+#include <time.h>
+#endif
+
+typedef struct {
+    const char* name;
+    u64 start;
+    u64 end;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent* events;
+    volatile u32 count;  // published after the event is written
+    u32 dropped;
+    const char* name;
+} TraceBuffer;
+
+static struct {
+    TraceBuffer buffers[TRACE_MAX_THREADS];
+    volatile u32 claimed;  // slots taken, possibly beyond TRACE_MAX_THREADS
+} trace;
+
+static __thread TraceBuffer* thread_buffer;
+static __thread bool thread_refused;  // the table was full or the buffer couldn't be allocated
+
+/* Timestamps
+The system tick counter on the 3DS. Host builds may run the app on a
+virtual tick counter (tools/replay.c), so they read the real clock
+instead, scaled to the same units.
+*/
+static u64 trace_now(void) {
+#ifdef __3DS__
+    return svcGetSystemTick();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * SYSCLOCK_ARM11 + (u64)ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000ull;
+#endif
+}
+
+/* The calling thread's buffer, claiming a slot on first use
+Slots are claimed with an atomic increment rather than under a lock, since
+a thread may trace before anything could have set a lock up. A slot whose
+events aren't allocated yet just reads as empty.
+*/
+static TraceBuffer* thread_trace(void) {
+    if (thread_buffer || thread_refused)
+        return thread_buffer;
+
+    u32 slot = __sync_fetch_and_add(&trace.claimed, 1);
+    if (slot < TRACE_MAX_THREADS) {
+        TraceEvent* events = (TraceEvent*)malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+        if (events) {
+            trace.buffers[slot].events = events;
+            thread_buffer = &trace.buffers[slot];
+        }
+    }
+    thread_refused = !thread_buffer;
+    return thread_buffer;
+}
+
+TraceScope traceBegin(const char* name) {
+    TraceScope scope = { name, trace_now() };
+    return scope;
+}
+
+void traceEnd(TraceScope* scope) {
+    u64 end = trace_now();
+    TraceBuffer* buffer = thread_trace();
+    if (!buffer)
+        return;
+    if (buffer->count == TRACE_BUFFER_EVENTS) {
+        buffer->dropped++;
+        return;
+    }
+
+    TraceEvent* event = &buffer->events[buffer->count];
+    event->name = scope->name;
+    event->start = scope->start;
+    event->end = end;
+    __sync_synchronize();
+    buffer->count++;
+}
+
+void traceNameThread(const char* name) {
+    TraceBuffer* buffer = thread_trace();
+    if (buffer && !buffer->name)
+        buffer->name = name;
+}
+
+// Chrome trace times are microseconds; only differences matter, so they count from the first event
+static double ticks_to_us(u64 ticks, u64 origin) {
+    return (double)(ticks - origin) * 1000000.0 / SYSCLOCK_ARM11;
+}
+
+bool traceWrite(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    u32 bufferCount = trace.claimed < TRACE_MAX_THREADS ? trace.claimed : TRACE_MAX_THREADS;
+    u32 counts[TRACE_MAX_THREADS];
+    u32 dropped = 0;
+    u64 origin = (u64)-1;
+    for (u32 t = 0; t < bufferCount; ++t) {
+        counts[t] = trace.buffers[t].count;
+        dropped += trace.buffers[t].dropped;
+        __sync_synchronize();
+        if (counts[t] > 0 && trace.buffers[t].events[0].start < origin)
+            origin = trace.buffers[t].events[0].start;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (u32 t = 0; t < bufferCount; ++t) {
+        const TraceBuffer* buffer = &trace.buffers[t];
+        if (buffer->name) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", (unsigned long)t + 1, buffer->name);
+            first = false;
+        }
+        for (u32 i = 0; i < counts[t]; ++i) {
+            const TraceEvent* event = &buffer->events[i];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", event->name, (unsigned long)t + 1, ticks_to_us(event->start, origin),
+                ticks_to_us(event->end, event->start));
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\"otherData\":{\"droppedEvents\":\"%lu\"}}\n", (unsigned long)dropped);
+    return fclose(file) == 0;
+}
+
+#endif // TRACE_ENABLED
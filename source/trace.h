@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <3ds.h>
+
+/* Scope timers with Chrome trace export
+Built with TRACE_ENABLED defined, TRACE_SCOPE times the rest of the
+enclosing block and TRACE_BEGIN/TRACE_END a span within one. Each thread
+appends to its own buffer, so the only shared state is the buffer table
+taken once per thread. traceWrite saves everything as Chrome trace event
+JSON, which chrome://tracing and ui.perfetto.dev show as a timeline per
+thread. Without TRACE_ENABLED the macros expand to nothing.
+*/
+
+#define TRACE_PATH           "sdmc:/3ds/3dXMMP/trace.json"
+#define TRACE_MAX_THREADS    8
+#define TRACE_BUFFER_EVENTS  16384  // per thread; later events are dropped
+
+typedef struct {
+    const char* name;  // must outlive the trace: a string literal
+    u64 start;
+} TraceScope;
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(name) \
+    TraceScope TRACE_CONCAT(trace_scope_, __LINE__) __attribute__((cleanup(traceEnd))) = traceBegin(name)
+#define TRACE_BEGIN(var, name) TraceScope var = traceBegin(name)
+#define TRACE_END(var)         traceEnd(&var)
+#define TRACE_THREAD(name)     traceNameThread(name)
+
+TraceScope traceBegin(const char* name);
+void traceEnd(TraceScope* scope);
+
+// Labels the calling thread's row in the timeline; the first name given sticks
+void traceNameThread(const char* name);
+
+// Writes every thread's events so far; safe while other threads keep tracing
+bool traceWrite(const char* path);
+
+#else
+
+#define TRACE_SCOPE(name)      do { } while (0)
+#define TRACE_BEGIN(var, name) do { } while (0)
+#define TRACE_END(var)         do { } while (0)
+#define TRACE_THREAD(name)     do { } while (0)
+
+static inline bool traceWrite(const char* path) {
+    return false;
+}
+
+#endif // TRACE_ENABLED
+
+#endif // TRACE_H
@@ -0,0 +1,102 @@
+/* boostcheck - drives the clock boost controller through a decoding dip
+Usage: boostcheck [-t seconds]
+Build: cc -O2 -pthread -Itools/host -Isource -o boostcheck tools/boostcheck.c tools/host/ctru_host.c source/boost.c -lm
+
+No decoder is involved: each step reports one wave buffer's worth of
+decoding to source/boost.c the way the NDSP callback does, on the virtual
+clock, as a New 3DS. For every queue length the player can run with (the
+full queue and the one memory pressure leaves) decoding runs comfortably
+ahead, then falls behind with the queue draining, then recovers with every
+other buffer queued again. Speed measured while boosted is BOOST_SPEEDUP
+times faster, as on the device. Boost has to switch on during the dip and
+off again within the given seconds (default 30) of recovering; exits with 1
+if it doesn't.
+*/
+#include <3ds.h>
+#include "boost.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_RATE            32728
+#define CHECK_FRAMES          2048   // samples per reported buffer
+#define CHECK_FAST_REALTIME   10.0f  // unboosted decode speed while comfortably ahead
+#define CHECK_SLOW_REALTIME   0.9f   // and while falling behind
+#define CHECK_STEADY_SECONDS  10.0
+#define CHECK_DIP_SECONDS     2.0
+#define CHECK_DEFAULT_SECONDS 30.0
+
+static const int queue_lengths[] = { 4, 2 };
+
+typedef struct {
+    double on;   // seconds into the run boost last switched on, < 0 if never
+    double off;  // and off again after that
+} Switches;
+
+// Reports buffers for `seconds` of audio with `queued` others still queued each time
+static double run(double time, double seconds, float realtime, int queued, int capacity, Switches* switches) {
+    double step = (double)CHECK_FRAMES / CHECK_RATE;
+    for (double end = time + seconds; time < end; time += step) {
+        float speed = hostSpeedupEnabled() ? realtime * BOOST_SPEEDUP : realtime;
+        u64 ticks = (u64)(SYSCLOCK_ARM11 * step / speed);
+        hostClockAdvance((u64)(SYSCLOCK_ARM11 * step));
+        boostReport(ticks, CHECK_FRAMES, CHECK_RATE, queued, capacity);
+        boostUpdate();
+
+        BoostEvent event;
+        while (boostPollEvent(&event)) {
+            if (event.type == BOOST_EVENT_ON) {
+                switches->on = time;
+                switches->off = -1.0;
+            } else if (event.type == BOOST_EVENT_OFF) {
+                switches->off = time;
+            }
+        }
+    }
+    return time;
+}
+
+int main(int argc, char** argv) {
+    double limit = CHECK_DEFAULT_SECONDS;
+    if (argc == 3 && strcmp(argv[1], "-t") == 0) {
+        limit = atof(argv[2]);
+    } else if (argc != 1) {
+        fprintf(stderr, "usage: %s [-t seconds]\n", argv[0]);
+        return 1;
+    }
+
+    hostClockSetVirtual(true);
+    hostSetNew3DS(true);
+
+    bool failed = false;
+    for (int i = 0; i < (int)(sizeof(queue_lengths) / sizeof(queue_lengths[0])); ++i) {
+        int capacity = queue_lengths[i];
+        Switches switches = { -1.0, -1.0 };
+        boostInit();
+        boostTrackStart(0);
+
+        double time = run(0.0, CHECK_STEADY_SECONDS, CHECK_FAST_REALTIME, capacity - 1, capacity, &switches);
+        bool steadyOff = switches.on < 0.0;
+        double recovered = run(time, CHECK_DIP_SECONDS, CHECK_SLOW_REALTIME, 0, capacity, &switches);
+        bool dipOn = switches.on >= time;
+        run(recovered, limit, CHECK_FAST_REALTIME, capacity - 1, capacity, &switches);
+        bool recoveredOff = switches.off >= recovered && !boostIsEnabled();
+
+        printf("%d buffers: ", capacity);
+        if (dipOn)
+            printf("on at %.2fs in the dip, ", switches.on);
+        else
+            printf("not on in the dip, ");
+        if (recoveredOff)
+            printf("off %.2fs after recovering", switches.off - recovered);
+        else
+            printf("still on %.0fs after recovering", limit);
+        printf("%s\n", steadyOff ? "" : " (on before the dip)");
+
+        failed |= !steadyOff || !dipOn || !recoveredOff;
+        boostExit();
+    }
+    printf(failed ? "FAIL\n" : "ok\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/* faults - plays through the engine while the simulated system misbehaves
+Usage: faults [-t seconds] [-s seed] [scenario ...] track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -o faults tools/faults.c tools/host/ndsp_host.c tools/host/ctru_host.c
+       tools/host/assets_host.c source/latency.c source/memory.c source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c source/collate.c source/filter.c source/history.c source/stats.c -lvorbisidec -lm
+
+Each scenario plays tracks with random seeks and switches for the given
+virtual time (default 60 s) under one kind of fault: the DSP callback
+held back for a while at regular intervals, callbacks coming late at
+random (contention for the CPU), reads or seeks in the decoder's stream
+callbacks stalling while the DSP plays on, a share of allocations
+failing, or free memory under the critical mark, so the player plays on
+with its shortest queue. Faults follow fixed schedules and a seeded generator, so a run
+repeats exactly. Reported per scenario: underruns, how much audio was
+missing, and the time from the queue running dry to it being full again.
+Name scenarios (or a prefix) to run only those. Exits with 1 if the
+baseline, without faults, underruns at all.
+*/
+#include <3ds.h>
+#include "assets_host.h"
+#include "boost.h"
+#include "decoder.h"
+#include "memory.h"
+#include "player.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FAULTS_DEFAULT_SECONDS 60
+#define FAULTS_FRAME_SECONDS   (160 / NDSP_SAMPLE_RATE)
+#define FAULTS_MS(frames)      ((frames) * FAULTS_FRAME_SECONDS * 1000.0)
+#define FAULTS_FRAMES(ms)      ((u32)((ms) / 1000.0 / FAULTS_FRAME_SECONDS + 0.5))
+#define FAULTS_SEEK_EVERY      (60 * 8)  // most frames between seeks, about 4 s
+#define FAULTS_SWITCH_EVERY    (60 * 40) // most frames before switching tracks
+
+typedef struct {
+    const char* name;
+    hostNdspFaults ndsp;
+    u32 stallEvery;      // decoder reads between stalls, 0 = never
+    u32 stallMs;
+    u32 seekStallMs;     // every stream seek stalls this long
+    u32 allocFailEvery;  // every Nth allocation fails while the engine runs, 0 = never
+    u32 heapFree;        // free heap reported to memory.c, 0 = plenty
+} Scenario;
+
+typedef struct {
+    hostNdspStats stats;
+    u32 plays;
+    u32 failedPlays;
+    u32 failedAllocs;
+} Outcome;
+
+static Scenario scenarios[] = {
+    { .name = "baseline" },
+    { .name = "late-50ms",       .ndsp = { .delayEvery = 409, .delayFrames = 10 } },  // every 2 s
+    { .name = "late-250ms",      .ndsp = { .delayEvery = 1023, .delayFrames = 51 } }, // every 5 s
+    { .name = "contention",      .ndsp = { .jitterFrames = 3 } },
+    { .name = "contention-high", .ndsp = { .jitterFrames = 8 } },
+    { .name = "read-stall",      .stallEvery = 8, .stallMs = 100 },
+    { .name = "seek-stall",      .seekStallMs = 250 },
+    { .name = "alloc-fail",      .allocFailEvery = 40 },
+    { .name = "low-memory",      .heapFree = MEMORY_HEAP_CRITICAL / 2 },
+};
+#define SCENARIO_COUNT (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static const Scenario* active;
+static u32 reads;
+static u32 rng_state;
+
+static u32 next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// The DSP keeps playing for as long as the decoding thread would be stuck
+static void on_decoder_io(bool seek, u32 bytes, void* user) {
+    if (seek && active->seekStallMs)
+        hostNdspStall(FAULTS_FRAMES(active->seekStallMs));
+    if (!seek && active->stallEvery && ++reads % active->stallEvery == 0)
+        hostNdspStall(FAULTS_FRAMES(active->stallMs));
+}
+
+/* Allocation failures
+glibc lets a program replace its allocation functions; these forward to
+glibc's own, so free stays consistent with them. Tremor's allocations are
+covered too, since the shared library binds to the program's definitions.
+*/
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static bool alloc_armed = false;
+static u32 alloc_count = 0;
+static u32 alloc_failures = 0;
+
+static bool allocation_fails(void) {
+    if (!alloc_armed || !active->allocFailEvery || ++alloc_count % active->allocFailEvery != 0)
+        return false;
+    alloc_failures++;
+    return true;
+}
+
+void* malloc(size_t size) {
+    return allocation_fails() ? NULL : __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    return allocation_fails() ? NULL : __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    return allocation_fails() ? NULL : __libc_realloc(ptr, size);
+}
+#define ARM_ALLOCATIONS(armed) (alloc_armed = (armed))
+#else
+static u32 alloc_failures = 0;
+#define ARM_ALLOCATIONS(armed) ((void)(armed))
+#endif
+
+static void run_frames(u32 frames) {
+    for (u32 i = 0; i < frames; ++i) {
+        hostNdspFrame();
+        boostUpdate();
+        memoryUpdate();
+    }
+    BoostEvent event;
+    while (boostPollEvent(&event)) {
+    }
+}
+
+static Outcome run_scenario(const Scenario* scenario, u32 seconds, u32 seed) {
+    Outcome outcome = { 0 };
+    active = scenario;
+    reads = 0;
+    rng_state = seed ? seed : 1;
+    u32 failuresBefore = alloc_failures;
+
+    hostNdspFaults ndsp = scenario->ndsp;
+    ndsp.seed = seed;
+    hostNdspSetFaults(&ndsp);
+    hostNdspResetStats();
+    hostMemorySetFree(scenario->heapFree ? scenario->heapFree : HOST_HEAP_FREE, HOST_LINEAR_FREE);
+    memoryUpdate();
+
+    u32 total = (u32)(seconds / FAULTS_FRAME_SECONDS);
+    u32 nextSwitch = 0, nextSeek = 0;
+    int tracks = playerTrackCount();
+    ARM_ALLOCATIONS(true);
+    for (u32 frame = 0; frame < total; ++frame) {
+        int track = next_random() % tracks;
+        if (frame >= nextSwitch || !playerIsPlaying()) {
+            playerPlay(track);
+            outcome.plays++;
+            if (!playerIsPlaying())
+                outcome.failedPlays++;
+            nextSwitch = frame + 1 + next_random() % FAULTS_SWITCH_EVERY;
+        }
+        if (frame >= nextSeek) {
+            playerSeek(playerTrackLength(track) * (next_random() % 1000) / 1000.0f);
+            nextSeek = frame + 1 + next_random() % FAULTS_SEEK_EVERY;
+        }
+        run_frames(1);
+    }
+    ARM_ALLOCATIONS(false);
+    playerStop();
+
+    hostNdspSetFaults(NULL);
+    hostMemorySetFree(HOST_HEAP_FREE, HOST_LINEAR_FREE);
+    hostNdspGetStats(0, &outcome.stats);
+    outcome.failedAllocs = alloc_failures - failuresBefore;
+    return outcome;
+}
+
+static bool selected(const char* name, char** filters, int filterCount) {
+    if (filterCount == 0)
+        return true;
+    for (int i = 0; i < filterCount; ++i)
+        if (strncmp(name, filters[i], strlen(filters[i])) == 0)
+            return true;
+    return false;
+}
+
+static bool is_scenario(const char* arg) {
+    for (int i = 0; i < SCENARIO_COUNT; ++i)
+        if (strncmp(scenarios[i].name, arg, strlen(arg)) == 0)
+            return true;
+    return false;
+}
+
+int main(int argc, char** argv) {
+    u32 seconds = FAULTS_DEFAULT_SECONDS;
+    u32 seed = 1;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-t") == 0)
+            seconds = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else if (strcmp(argv[arg], "-s") == 0)
+            seed = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else
+            break;
+        arg += 2;
+    }
+    char** filters = argv + arg;
+    int filterCount = 0;
+    while (arg < argc && is_scenario(argv[arg])) {
+        arg++;
+        filterCount++;
+    }
+    if (arg >= argc || seconds == 0) {
+        fprintf(stderr, "usage: %s [-t seconds] [-s seed] [scenario ...] track.ogg [track.ogg ...]\nscenarios:", argv[0]);
+        for (int i = 0; i < SCENARIO_COUNT; ++i)
+            fprintf(stderr, " %s", scenarios[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    if (!hostAssetsLoad(argv + arg, argc - arg))
+        return 1;
+    playerInit();
+    decoderSetIoHook(on_decoder_io, NULL);
+
+    printf("%-16s %6s %9s %9s %11s %11s %7s %7s\n", "scenario", "plays", "failed", "underrun",
+        "missing ms", "recover ms", "worst", "allocs");
+    bool baselineClean = true;
+    for (int i = 0; i < SCENARIO_COUNT; ++i) {
+        if (!selected(scenarios[i].name, filters, filterCount))
+            continue;
+
+        Outcome outcome = run_scenario(&scenarios[i], seconds, seed);
+        const hostNdspStats* stats = &outcome.stats;
+        printf("%-16s %6u %9u %9u %11.0f %11.1f %7.0f %7u\n", scenarios[i].name, outcome.plays, outcome.failedPlays,
+            stats->underruns, FAULTS_MS(stats->starvedFrames),
+            stats->recoveries ? FAULTS_MS((double)stats->recoveryFrames / stats->recoveries) : 0.0,
+            FAULTS_MS(stats->worstRecoveryFrames), outcome.failedAllocs);
+        if (i == 0 && stats->underruns > 0)
+            baselineClean = false;
+    }
+
+    decoderSetIoHook(NULL, NULL);
+    playerExit();
+    hostAssetsFree();
+    if (!baselineClean)
+        printf("FAIL: underruns without faults\n");
+    return baselineClean ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file 3ds.h
+ * @brief Host stand-in for the libctru pieces that the player and shared sources use.
+ *
+ * Lets player.c, decoder.c and friends build unchanged on a PC. NDSP is simulated
+ * by ndsp_host.c on a virtual clock; see 3ds/ndsp/ndsp.h for the extra hooks.
+ * HID, APT and gfx (hid_host.c) are driven by the harness through the hooks
+ * at the end of this file, which is enough to run main.c itself.
+ */
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+typedef s32      Result;
+
+#include "3ds/os.h"
+
+#define BIT(n) (1U<<(n))
+
+/// Ticks of a monotonic host clock scaled to SYSCLOCK_ARM11, like the real tick counter.
+u64 svcGetSystemTick(void);
+void svcSleepThread(s64 ns);
+
+void* linearAlloc(size_t size);
+void linearFree(void* mem);
+u32 linearSpaceFree(void);
+Result DSP_FlushDataCache(const void* address, u32 size);
+
+/// Free heap for memory.c, which reads mallinfo on the 3DS; with linearSpaceFree, whatever hostMemorySetFree last set.
+u32 hostHeapFree(void);
+/// Defaults to HOST_HEAP_FREE and HOST_LINEAR_FREE, well clear of memory.h's marks.
+void hostMemorySetFree(u32 heap, u32 linear);
+#define HOST_HEAP_FREE   (16 * 1024 * 1024)
+#define HOST_LINEAR_FREE (8 * 1024 * 1024)
+
+/// Reports a New 3DS so the clock boost controller runs; osSetSpeedupEnable only records the state.
+Result APT_CheckNew3DS(bool* out);
+void osSetSpeedupEnable(bool enable);
+bool hostSpeedupEnabled(void);
+/// Sets the model APT_CheckNew3DS reports (New 3DS by default), for budgets that depend on it.
+void hostSetNew3DS(bool isNew);
+
+typedef pthread_mutex_t LightLock;
+
+static inline void LightLock_Init(LightLock* lock) { pthread_mutex_init(lock, NULL); }
+static inline void LightLock_Lock(LightLock* lock) { pthread_mutex_lock(lock); }
+static inline void LightLock_Unlock(LightLock* lock) { pthread_mutex_unlock(lock); }
+
+#include "3ds/ndsp/ndsp.h"
+
+///@name HID (subset of libctru's services/hid.h, same key bits)
+///@{
+enum
+{
+	KEY_A       = BIT(0),
+	KEY_B       = BIT(1),
+	KEY_SELECT  = BIT(2),
+	KEY_START   = BIT(3),
+	KEY_DRIGHT  = BIT(4),
+	KEY_DLEFT   = BIT(5),
+	KEY_DUP     = BIT(6),
+	KEY_DDOWN   = BIT(7),
+	KEY_R       = BIT(8),
+	KEY_L       = BIT(9),
+	KEY_X       = BIT(10),
+	KEY_Y       = BIT(11),
+	KEY_ZL      = BIT(14),
+	KEY_ZR      = BIT(15),
+	KEY_TOUCH   = BIT(20),
+	KEY_CSTICK_RIGHT = BIT(24),
+	KEY_CSTICK_LEFT  = BIT(25),
+	KEY_CSTICK_UP    = BIT(26),
+	KEY_CSTICK_DOWN  = BIT(27),
+	KEY_CPAD_RIGHT = BIT(28),
+	KEY_CPAD_LEFT  = BIT(29),
+	KEY_CPAD_UP    = BIT(30),
+	KEY_CPAD_DOWN  = BIT(31),
+	KEY_UP    = KEY_DUP    | KEY_CPAD_UP,
+	KEY_DOWN  = KEY_DDOWN  | KEY_CPAD_DOWN,
+	KEY_LEFT  = KEY_DLEFT  | KEY_CPAD_LEFT,
+	KEY_RIGHT = KEY_DRIGHT | KEY_CPAD_RIGHT,
+};
+
+typedef struct
+{
+	u16 px;
+	u16 py;
+} touchPosition;
+
+void hidScanInput(void);
+u32 hidKeysDown(void);
+u32 hidKeysHeld(void);
+u32 hidKeysUp(void);
+u32 hidKeysDownRepeat(void);
+void hidTouchRead(touchPosition* pos);
+void hidSetRepeatParameters(u32 delay, u32 interval);
+///@}
+
+///@name APT (subset of libctru's services/apt.h)
+///@{
+typedef enum
+{
+	APTHOOK_ONSUSPEND = 0,
+	APTHOOK_ONRESTORE,
+	APTHOOK_ONSLEEP,
+	APTHOOK_ONWAKEUP,
+	APTHOOK_ONEXIT,
+	APTHOOK_COUNT,
+} APT_HookType;
+
+typedef void (*aptHookFn)(APT_HookType hook, void* param);
+
+typedef struct tag_aptHookCookie
+{
+	struct tag_aptHookCookie* next;
+	aptHookFn callback;
+	void* param;
+} aptHookCookie;
+
+/// Returns what the frame hook returns; true forever if there is none.
+bool aptMainLoop(void);
+void aptHook(aptHookCookie* cookie, aptHookFn callback, void* param);
+void aptUnhook(aptHookCookie* cookie);
+///@}
+
+///@name gfx (no-ops; drawing goes through the citro2d stand-in)
+///@{
+typedef enum
+{
+	GFX_TOP = 0,
+	GFX_BOTTOM = 1,
+} gfxScreen_t;
+
+typedef enum
+{
+	GFX_LEFT = 0,
+	GFX_RIGHT = 1,
+} gfx3dSide_t;
+
+void gfxInitDefault(void);
+void gfxExit(void);
+void gfxSwapBuffers(void);
+void gfxFlushBuffers(void);
+///@}
+
+///@name Host simulation hooks
+///@{
+/// Called at the top of every aptMainLoop; returning false ends the app's main loop.
+typedef bool (*hostAptFrameHook)(void* data);
+void hostAptSetFrameHook(hostAptFrameHook hook, void* data);
+
+/// What the next hidScanInput reports, verbatim (no edge detection or key repeat here).
+void hostHidSetInput(u32 down, u32 held, u32 up, u32 repeat, u16 touchX, u16 touchY);
+
+/// Replaces the monotonic clock with one that only moves by hostClockAdvance; svcSleepThread returns at once.
+void hostClockSetVirtual(bool enable);
+void hostClockAdvance(u64 ticks);
+///@}
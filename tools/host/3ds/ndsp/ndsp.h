@@ -0,0 +1,99 @@
+/**
+ * @file ndsp.h
+ * @brief Host stand-in for NDSP: the shared interface plus the channel calls the player uses.
+ *
+ * Nothing runs by itself here. Each hostNdspFrame() call plays one DSP frame
+ * (160 output samples at NDSP_SAMPLE_RATE) on a virtual clock and then invokes
+ * the frame callback, so a harness can run the engine as fast as the CPU allows.
+ */
+#pragma once
+
+#include <ndsp.h>
+
+///@name Channel interface (subset of libctru's ndsp/channel.h)
+///@{
+enum
+{
+	NDSP_ENCODING_PCM8 = 0,
+	NDSP_ENCODING_PCM16,
+	NDSP_ENCODING_ADPCM,
+};
+
+#define NDSP_CHANNELS(n)  ((u32)(n) & 3)
+#define NDSP_ENCODING(n) (((u32)(n) & 3) << 2)
+
+enum
+{
+	NDSP_FORMAT_MONO_PCM8    = NDSP_CHANNELS(1) | NDSP_ENCODING(NDSP_ENCODING_PCM8),
+	NDSP_FORMAT_MONO_PCM16   = NDSP_CHANNELS(1) | NDSP_ENCODING(NDSP_ENCODING_PCM16),
+	NDSP_FORMAT_MONO_ADPCM   = NDSP_CHANNELS(1) | NDSP_ENCODING(NDSP_ENCODING_ADPCM),
+	NDSP_FORMAT_STEREO_PCM8  = NDSP_CHANNELS(2) | NDSP_ENCODING(NDSP_ENCODING_PCM8),
+	NDSP_FORMAT_STEREO_PCM16 = NDSP_CHANNELS(2) | NDSP_ENCODING(NDSP_ENCODING_PCM16),
+};
+
+typedef enum
+{
+	NDSP_INTERP_POLYPHASE = 0,
+	NDSP_INTERP_LINEAR    = 1,
+	NDSP_INTERP_NONE      = 2,
+} ndspInterpType;
+
+void ndspChnReset(int id);
+bool ndspChnIsPlaying(int id);
+u32  ndspChnGetSamplePos(int id);
+u16  ndspChnGetWaveBufSeq(int id);
+bool ndspChnIsPaused(int id);
+void ndspChnSetPaused(int id, bool paused);
+void ndspChnSetFormat(int id, u16 format);
+void ndspChnSetInterp(int id, ndspInterpType type);
+void ndspChnSetRate(int id, float rate);
+void ndspChnSetMix(int id, float mix[12]);
+void ndspChnWaveBufClear(int id);
+void ndspChnWaveBufAdd(int id, ndspWaveBuf* buf);
+///@}
+
+///@name Host simulation hooks
+///@{
+/// Receives the PCM of each wave buffer as the simulated DSP consumes it.
+typedef void (*hostNdspSink)(int id, const s16* samples, u32 frames, int channels, float rate, void* data);
+
+/// Plays one DSP frame on every channel, then calls the frame callback.
+void hostNdspFrame(void);
+
+/// Virtual time in seconds since ndspInit.
+double hostNdspTime(void);
+
+/// Sets where consumed PCM goes (NULL to discard).
+void hostNdspSetSink(hostNdspSink sink, void* data);
+
+/// Gaps in playback: frames where the queue ran dry and more audio arrived afterwards.
+u32 hostNdspUnderruns(int id);
+
+/// Faults the simulated DSP applies to its callback; all zero is a well-behaved system.
+typedef struct
+{
+	u32 delayEvery;   ///< Frames between callback delays (0 = never), like a higher-priority thread taking over.
+	u32 delayFrames;  ///< Frames the callback is held back each time.
+	u32 jitterFrames; ///< CPU contention: after each callback the next one comes 0..jitterFrames frames late.
+	u32 seed;         ///< Seeds the jitter so runs repeat exactly.
+} hostNdspFaults;
+
+/// Sets the callback faults (NULL clears them).
+void hostNdspSetFaults(const hostNdspFaults* faults);
+
+/// Plays frames with the callback blocked, as while the decoding thread is stuck in a read.
+void hostNdspStall(u32 frames);
+
+/// Per-channel playback health since the last hostNdspResetStats.
+typedef struct
+{
+	u32 underruns;
+	u32 starvedFrames;        ///< Frames with nothing to play that were followed by more audio.
+	u32 recoveries;           ///< Underruns after which the queue got back to its full depth.
+	u32 recoveryFrames;       ///< Total frames from running dry to full depth again.
+	u32 worstRecoveryFrames;
+} hostNdspStats;
+
+void hostNdspGetStats(int id, hostNdspStats* out);
+void hostNdspResetStats(void);
+///@}
@@ -0,0 +1,8 @@
+/**
+ * @file os.h
+ * @brief Host stand-in for libctru's clock constants.
+ */
+#pragma once
+
+#define SYSCLOCK_SOC   (16756991)
+#define SYSCLOCK_ARM11 (SYSCLOCK_SOC * 16)
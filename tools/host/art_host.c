@@ -0,0 +1,19 @@
+// Host stand-in for art.c: covers aren't decoded on a PC, so no track has art
+#include "art.h"
+
+void artInit(void) {
+}
+
+void artExit(void) {
+}
+
+void artRequest(int track) {
+}
+
+bool artUpdate(void) {
+    return false;
+}
+
+bool artGetImage(C2D_Image* image) {
+    return false;
+}
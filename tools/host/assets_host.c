@@ -0,0 +1,94 @@
+// Host replacement for source/assets.c: "embedded" tracks are files loaded at startup
+#include "assets.h"
+#include "assets_host.h"
+#include "oggindex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static EmbeddedAsset* assets = NULL;
+static int asset_count = 0;
+static PackSeekPoint* seek_points = NULL;
+static u32 seek_point_count = 0;
+
+// What tools/mkmanifest.c would have put in the manifest; left at zero if the headers don't parse
+static void describe_asset(EmbeddedAsset* asset) {
+    u32 size;
+    const u8* id = oggReadHeaderPacket(asset->data, asset->size, 0, &size, NULL);
+    if (id && size >= 16 && id[0] == 1 && memcmp(id + 1, "vorbis", 6) == 0) {
+        asset->channels = id[11];
+        asset->sampleRate = id[12] | (id[13] << 8) | (id[14] << 16) | ((u32)id[15] << 24);
+    }
+    free((void*)id);
+    if (asset->sampleRate == 0)
+        return;
+
+    PackSeekPoint* points;
+    u32 count = oggBuildSeekTable(asset->data, asset->size, asset->sampleRate * OGG_SEEK_INTERVAL_SECONDS, &points,
+                                  &asset->totalSamples);
+    PackSeekPoint* all = (PackSeekPoint*)realloc(seek_points, (seek_point_count + count + 1) * sizeof(PackSeekPoint));
+    if (all && points) {
+        memcpy(all + seek_point_count, points, count * sizeof(PackSeekPoint));
+        asset->seekFirst = seek_point_count;
+        asset->seekCount = count;
+        seek_point_count += count;
+    }
+    if (all)
+        seek_points = all;
+    free(points);
+}
+
+bool hostAssetsLoad(char** paths, int count) {
+    assets = (EmbeddedAsset*)calloc(count, sizeof(EmbeddedAsset));
+    for (int i = 0; i < count; ++i) {
+        FILE* file = fopen(paths[i], "rb");
+        if (!file) {
+            fprintf(stderr, "%s: cannot open\n", paths[i]);
+            return false;
+        }
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        unsigned char* data = (unsigned char*)malloc(size > 0 ? size : 1);
+        bool ok = size > 0 && fread(data, 1, size, file) == (size_t)size;
+        fclose(file);
+        if (!ok) {
+            fprintf(stderr, "%s: cannot read\n", paths[i]);
+            free(data);
+            return false;
+        }
+
+        const char* name = strrchr(paths[i], '/');
+        assets[i] = (EmbeddedAsset){ .data = data, .size = (unsigned int)size, .name = name ? name + 1 : paths[i] };
+        describe_asset(&assets[i]);
+        asset_count = i + 1;
+    }
+    return true;
+}
+
+void hostAssetsFree(void) {
+    for (int i = 0; i < asset_count; ++i)
+        free((void*)assets[i].data);
+    free(assets);
+    assets = NULL;
+    asset_count = 0;
+    free(seek_points);
+    seek_points = NULL;
+    seek_point_count = 0;
+}
+
+int assetCount(void) {
+    return asset_count;
+}
+
+const EmbeddedAsset* assetGet(int index) {
+    if (index < 0 || index >= asset_count)
+        return NULL;
+    return &assets[index];
+}
+
+const PackSeekPoint* assetSeekPoints(void) {
+    return seek_points;
+}
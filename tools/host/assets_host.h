@@ -0,0 +1,10 @@
+#ifndef ASSETS_HOST_H
+#define ASSETS_HOST_H
+
+#include <stdbool.h>
+
+// Loads files to stand in for the embedded tracks; call before playerInit
+bool hostAssetsLoad(char** paths, int count);
+void hostAssetsFree(void);
+
+#endif // ASSETS_HOST_H
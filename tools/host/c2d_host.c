@@ -0,0 +1,237 @@
+// Host implementations of the citro2d and citro3d calls declared in citro2d.h; nothing reaches a screen
+#include <citro2d.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_GLYPH_WIDTH 12.0f  // advance of every glyph at scale 1, near the system font's average
+#define HOST_LINE_HEIGHT 30.0f
+#define HOST_QUAD_VERTICES 6
+
+// Stand-in for the system font's glyph sheets when tracking texture switches
+static const C3D_Tex font_sheet;
+
+struct C3D_RenderTarget_tag {
+    C3D_Tex* tex;
+};
+
+struct C2D_TextBuf_s {
+    size_t capacity;  // glyphs
+    size_t used;
+};
+
+static u32 frames_begun = 0;
+
+// Per-frame counters: `frame` fills up until C3D_FrameEnd copies it to `last`
+static struct {
+    hostC2DStats frame;
+    hostC2DStats last;
+    u32 maxVertices;
+    const void* source;  // texture the current batch samples, NULL for solid colour
+    bool inBatch;
+    double beginUs;
+} counters;
+
+static double thread_cpu_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Reserves a draw's quads in the frame's vertex buffer; false (and not drawn) when it is full, as in citro2d
+static bool draw_quads(const void* source, u32 quads) {
+    counters.frame.drawCalls++;
+    u32 vertices = quads * HOST_QUAD_VERTICES;
+    if (counters.frame.vertices + vertices > counters.maxVertices) {
+        counters.frame.dropped++;
+        return false;
+    }
+    if (!counters.inBatch || source != counters.source) {
+        counters.frame.batches++;
+        counters.source = source;
+        counters.inBatch = true;
+    }
+    counters.frame.vertices += vertices;
+    return true;
+}
+
+static size_t texture_bytes(u16 width, u16 height, GPU_TEXCOLOR format) {
+    size_t pixels = (size_t)width * height;
+    switch (format) {
+    case GPU_RGBA8:
+        return pixels * 4;
+    case GPU_RGB8:
+        return pixels * 3;
+    default:
+        return pixels * 2;
+    }
+}
+
+bool C3D_Init(size_t cmdBufSize) {
+    frames_begun = 0;
+    memset(&counters, 0, sizeof(counters));
+    return true;
+}
+
+void C3D_Fini(void) {
+}
+
+bool C3D_FrameBegin(u8 flags) {
+    frames_begun++;
+    counters.beginUs = thread_cpu_us();
+    return true;
+}
+
+void C3D_FrameEnd(u8 flags) {
+    counters.frame.drawUs = thread_cpu_us() - counters.beginUs;
+    counters.last = counters.frame;
+    memset(&counters.frame, 0, sizeof(counters.frame));
+    counters.inBatch = false;
+}
+
+bool C3D_TexInit(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format) {
+    tex->size = texture_bytes(width, height, format);
+    tex->data = linearAlloc(tex->size);
+    tex->fmt = format;
+    tex->width = width;
+    tex->height = height;
+    return tex->data != NULL;
+}
+
+bool C3D_TexInitVRAM(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format) {
+    return C3D_TexInit(tex, width, height, format);
+}
+
+void C3D_TexUpload(C3D_Tex* tex, const void* data) {
+    memcpy(tex->data, data, tex->size);
+}
+
+void C3D_TexFlush(C3D_Tex* tex) {
+}
+
+void C3D_TexSetFilter(C3D_Tex* tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter) {
+}
+
+void C3D_TexDelete(C3D_Tex* tex) {
+    linearFree(tex->data);
+    tex->data = NULL;
+}
+
+C3D_RenderTarget* C3D_RenderTargetCreateFromTex(C3D_Tex* tex, GPU_TEXFACE face, int level, int depthFmt) {
+    C3D_RenderTarget* target = (C3D_RenderTarget*)calloc(1, sizeof(C3D_RenderTarget));
+    if (target)
+        target->tex = tex;
+    return target;
+}
+
+void C3D_RenderTargetDelete(C3D_RenderTarget* target) {
+    free(target);
+}
+
+u32 hostC3DFrameCount(void) {
+    return frames_begun;
+}
+
+void hostC2DGetFrameStats(hostC2DStats* out) {
+    *out = counters.last;
+}
+
+bool C2D_Init(size_t maxObjects) {
+    counters.maxVertices = maxObjects * HOST_QUAD_VERTICES;
+    return true;
+}
+
+void C2D_Fini(void) {
+}
+
+void C2D_Prepare(void) {
+}
+
+void C2D_Flush(void) {
+}
+
+// Screen targets live until exit, as in citro2d
+C3D_RenderTarget* C2D_CreateScreenTarget(gfxScreen_t screen, gfx3dSide_t side) {
+    static C3D_RenderTarget screens[2];
+    return &screens[screen == GFX_BOTTOM];
+}
+
+void C2D_TargetClear(C3D_RenderTarget* target, u32 color) {
+}
+
+// A new target always starts a new batch
+void C2D_SceneBegin(C3D_RenderTarget* target) {
+    counters.inBatch = false;
+}
+
+C2D_TextBuf C2D_TextBufNew(size_t maxGlyphs) {
+    C2D_TextBuf buf = (C2D_TextBuf)calloc(1, sizeof(struct C2D_TextBuf_s));
+    if (buf)
+        buf->capacity = maxGlyphs;
+    return buf;
+}
+
+void C2D_TextBufDelete(C2D_TextBuf buf) {
+    free(buf);
+}
+
+void C2D_TextBufClear(C2D_TextBuf buf) {
+    buf->used = 0;
+}
+
+// One glyph per UTF-8 code point, up to what the buffer has room for, like citro2d
+const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str) {
+    text->buf = buf;
+    text->begin = buf->used;
+    text->lines = 1;
+    text->words = 0;
+    text->font = NULL;
+
+    bool inWord = false;
+    const char* p = str;
+    for (; *p && buf->used < buf->capacity; ++p) {
+        if (((u8)*p & 0xC0) == 0x80)
+            continue;
+        if (*p == '\n') {
+            text->lines++;
+            inWord = false;
+            continue;
+        }
+        bool space = *p == ' ';
+        if (!space && !inWord)
+            text->words++;
+        inWord = !space;
+        buf->used++;
+    }
+    text->end = buf->used;
+    text->width = (text->end - text->begin) * HOST_GLYPH_WIDTH;
+    counters.frame.textParses++;
+    counters.frame.glyphsParsed += text->end - text->begin;
+    return p;
+}
+
+void C2D_TextOptimize(const C2D_Text* text) {
+}
+
+void C2D_TextGetDimensions(const C2D_Text* text, float scaleX, float scaleY, float* outWidth, float* outHeight) {
+    if (outWidth)
+        *outWidth = text->width * scaleX;
+    if (outHeight)
+        *outHeight = HOST_LINE_HEIGHT * scaleY * text->lines;
+}
+
+// One quad per glyph, all from the font's sheets
+void C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...) {
+    u32 glyphs = text->end - text->begin;
+    if (draw_quads(&font_sheet, glyphs))
+        counters.frame.glyphsDrawn += glyphs;
+}
+
+bool C2D_DrawRectSolid(float x, float y, float z, float w, float h, u32 clr) {
+    return draw_quads(NULL, 1);
+}
+
+bool C2D_DrawImageAt(C2D_Image img, float x, float y, float depth, const C2D_ImageTint* tint, float scaleX, float scaleY) {
+    return draw_quads(img.tex, 1);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file citro2d.h
+ * @brief Host stand-in for the citro2d and citro3d calls the UI makes.
+ *
+ * Nothing is drawn: textures, render targets and text buffers are plain heap
+ * objects, and the draw calls only do the bookkeeping citro2d would do on the
+ * CPU side. This is enough to run main.c's frame logic on a PC (c2d_host.c).
+ * Each frame's calls, glyphs and vertices are counted so a harness can see
+ * what the GPU would have been given (hostC2DGetFrameStats).
+ */
+#pragma once
+
+#include <3ds.h>
+
+///@name citro3d (subset)
+///@{
+#define C3D_DEFAULT_CMDBUF_SIZE 0x40000
+#define C3D_FRAME_SYNCDRAW BIT(0)
+#define C3D_FRAME_NONBLOCK BIT(1)
+
+typedef enum
+{
+	GPU_RGBA8  = 0x0,
+	GPU_RGB8   = 0x1,
+	GPU_RGB565 = 0x3,
+	GPU_RGBA4  = 0x4,
+} GPU_TEXCOLOR;
+
+typedef enum
+{
+	GPU_NEAREST = 0x0,
+	GPU_LINEAR  = 0x1,
+} GPU_TEXTURE_FILTER_PARAM;
+
+typedef enum
+{
+	GPU_TEXFACE_2D = 0,
+} GPU_TEXFACE;
+
+typedef struct
+{
+	void* data;
+	GPU_TEXCOLOR fmt;
+	size_t size;
+	u16 width;
+	u16 height;
+} C3D_Tex;
+
+typedef struct C3D_RenderTarget_tag C3D_RenderTarget;
+
+bool C3D_Init(size_t cmdBufSize);
+void C3D_Fini(void);
+bool C3D_FrameBegin(u8 flags);
+void C3D_FrameEnd(u8 flags);
+
+bool C3D_TexInit(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format);
+bool C3D_TexInitVRAM(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format);
+void C3D_TexUpload(C3D_Tex* tex, const void* data);
+void C3D_TexFlush(C3D_Tex* tex);
+void C3D_TexSetFilter(C3D_Tex* tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter);
+void C3D_TexDelete(C3D_Tex* tex);
+
+C3D_RenderTarget* C3D_RenderTargetCreateFromTex(C3D_Tex* tex, GPU_TEXFACE face, int level, int depthFmt);
+void C3D_RenderTargetDelete(C3D_RenderTarget* target);
+///@}
+
+///@name citro2d (subset)
+///@{
+#define C2D_DEFAULT_MAX_OBJECTS 4096
+
+enum
+{
+	C2D_AtBaseline  = BIT(0),
+	C2D_WithColor   = BIT(1),
+	C2D_AlignLeft   = 0 << 2,
+	C2D_AlignRight  = 1 << 2,
+	C2D_AlignCenter = 2 << 2,
+	C2D_AlignJustified = 3 << 2,
+	C2D_WordWrap    = BIT(4),
+};
+
+typedef struct
+{
+	u16 width;
+	u16 height;
+	float left;
+	float top;
+	float right;
+	float bottom;
+} Tex3DS_SubTexture;
+
+typedef struct
+{
+	C3D_Tex* tex;
+	const Tex3DS_SubTexture* subtex;
+} C2D_Image;
+
+typedef struct C2D_ImageTint C2D_ImageTint;
+typedef struct C2D_TextBuf_s* C2D_TextBuf;
+typedef struct C2D_Font_s* C2D_Font;
+
+typedef struct
+{
+	C2D_TextBuf buf;
+	size_t begin;
+	size_t end;
+	float width;
+	u32 lines;
+	u32 words;
+	C2D_Font font;
+} C2D_Text;
+
+static inline u32 C2D_Color32(u8 r, u8 g, u8 b, u8 a)
+{
+	return r | (g << (u32)8) | (b << (u32)16) | (a << (u32)24);
+}
+
+bool C2D_Init(size_t maxObjects);
+void C2D_Fini(void);
+void C2D_Prepare(void);
+void C2D_Flush(void);
+
+C3D_RenderTarget* C2D_CreateScreenTarget(gfxScreen_t screen, gfx3dSide_t side);
+void C2D_TargetClear(C3D_RenderTarget* target, u32 color);
+void C2D_SceneBegin(C3D_RenderTarget* target);
+
+C2D_TextBuf C2D_TextBufNew(size_t maxGlyphs);
+void C2D_TextBufDelete(C2D_TextBuf buf);
+void C2D_TextBufClear(C2D_TextBuf buf);
+const char* C2D_TextParse(C2D_Text* text, C2D_TextBuf buf, const char* str);
+void C2D_TextOptimize(const C2D_Text* text);
+void C2D_TextGetDimensions(const C2D_Text* text, float scaleX, float scaleY, float* outWidth, float* outHeight);
+void C2D_DrawText(const C2D_Text* text, u32 flags, float x, float y, float z, float scaleX, float scaleY, ...);
+
+bool C2D_DrawRectSolid(float x, float y, float z, float w, float h, u32 clr);
+bool C2D_DrawImageAt(C2D_Image img, float x, float y, float depth, const C2D_ImageTint* tint, float scaleX, float scaleY);
+///@}
+
+///@name Host simulation hooks
+///@{
+/// Frames started with C3D_FrameBegin since C3D_Init.
+u32 hostC3DFrameCount(void);
+
+/// What one frame handed to citro2d, from one C3D_FrameEnd to the next.
+typedef struct
+{
+	u32 drawCalls;    ///< C2D_Draw* calls, text counted once per call
+	u32 batches;      ///< Vertex runs citro2d would submit: split by scenes and by switching between solid colour, font and image textures
+	u32 textParses;
+	u32 glyphsParsed;
+	u32 glyphsDrawn;
+	u32 vertices;     ///< Six per quad, as citro2d emits them
+	u32 dropped;      ///< Draws refused because the frame's vertex buffer (C2D_Init's maxObjects quads) was full
+	double drawUs;    ///< Thread CPU time from C3D_FrameBegin to C3D_FrameEnd
+} hostC2DStats;
+
+/// Counters of the last frame ended with C3D_FrameEnd.
+void hostC2DGetFrameStats(hostC2DStats* out);
+///@}
@@ -0,0 +1,80 @@
+// Host implementations of the libctru system calls declared in 3ds.h
+#include <3ds.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+static bool virtual_clock = false;
+static u64 virtual_ticks = 0;
+
+u64 svcGetSystemTick(void) {
+    if (virtual_clock)
+        return virtual_ticks;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * SYSCLOCK_ARM11 + (u64)ts.tv_nsec * SYSCLOCK_ARM11 / 1000000000ull;
+}
+
+void svcSleepThread(s64 ns) {
+    if (virtual_clock)
+        return;
+    struct timespec ts = { ns / 1000000000, ns % 1000000000 };
+    nanosleep(&ts, NULL);
+}
+
+void hostClockSetVirtual(bool enable) {
+    virtual_clock = enable;
+}
+
+void hostClockAdvance(u64 ticks) {
+    virtual_ticks += ticks;
+}
+
+void* linearAlloc(size_t size) {
+    // Same 0x80 alignment libctru's linear heap gives
+    return aligned_alloc(0x80, (size + 0x7F) & ~(size_t)0x7F);
+}
+
+void linearFree(void* mem) {
+    free(mem);
+}
+
+static u32 heap_free = HOST_HEAP_FREE;
+static u32 linear_free = HOST_LINEAR_FREE;
+
+u32 linearSpaceFree(void) {
+    return linear_free;
+}
+
+u32 hostHeapFree(void) {
+    return heap_free;
+}
+
+void hostMemorySetFree(u32 heap, u32 linear) {
+    heap_free = heap;
+    linear_free = linear;
+}
+
+Result DSP_FlushDataCache(const void* address, u32 size) {
+    return 0;
+}
+
+static bool speedup = false;
+static bool new3ds = true;
+
+Result APT_CheckNew3DS(bool* out) {
+    *out = new3ds;
+    return 0;
+}
+
+void hostSetNew3DS(bool isNew) {
+    new3ds = isNew;
+}
+
+void osSetSpeedupEnable(bool enable) {
+    speedup = enable;
+}
+
+bool hostSpeedupEnabled(void) {
+    return speedup;
+}
@@ -0,0 +1,76 @@
+// Host implementations of HID, APT and gfx; the harness supplies input and decides when the main loop ends
+#include <3ds.h>
+
+static struct {
+    u32 down, held, up, repeat;
+    touchPosition touch;
+} pending, current;
+
+static hostAptFrameHook frame_hook = NULL;
+static void* frame_hook_data = NULL;
+
+void hidScanInput(void) {
+    current = pending;
+}
+
+u32 hidKeysDown(void) {
+    return current.down;
+}
+
+u32 hidKeysHeld(void) {
+    return current.held;
+}
+
+u32 hidKeysUp(void) {
+    return current.up;
+}
+
+u32 hidKeysDownRepeat(void) {
+    return current.repeat;
+}
+
+void hidTouchRead(touchPosition* pos) {
+    *pos = current.touch;
+}
+
+void hidSetRepeatParameters(u32 delay, u32 interval) {
+}
+
+void hostHidSetInput(u32 down, u32 held, u32 up, u32 repeat, u16 touchX, u16 touchY) {
+    pending.down = down;
+    pending.held = held;
+    pending.up = up;
+    pending.repeat = repeat;
+    pending.touch.px = touchX;
+    pending.touch.py = touchY;
+}
+
+bool aptMainLoop(void) {
+    return frame_hook ? frame_hook(frame_hook_data) : true;
+}
+
+void aptHook(aptHookCookie* cookie, aptHookFn callback, void* param) {
+    cookie->next = NULL;
+    cookie->callback = callback;
+    cookie->param = param;
+}
+
+void aptUnhook(aptHookCookie* cookie) {
+}
+
+void hostAptSetFrameHook(hostAptFrameHook hook, void* data) {
+    frame_hook = hook;
+    frame_hook_data = data;
+}
+
+void gfxInitDefault(void) {
+}
+
+void gfxExit(void) {
+}
+
+void gfxSwapBuffers(void) {
+}
+
+void gfxFlushBuffers(void) {
+}
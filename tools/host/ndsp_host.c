@@ -0,0 +1,330 @@
+// NDSP stand-in: plays wave buffers on a virtual clock, one hostNdspFrame() at a time
+#include <3ds.h>
+
+#include <string.h>
+
+#define HOST_NDSP_CHANNELS      24
+#define HOST_NDSP_FRAME_SAMPLES 160
+#define HOST_NDSP_MAX_FRAME_INPUT 1024  // input frames one output frame can consume, enough for 192 kHz
+
+typedef struct {
+    ndspWaveBuf* head;
+    ndspWaveBuf* tail;
+    float rate;
+    u16 format;
+    u16 sequence;
+    float mix[2];        // front left and right gains; the other outputs aren't simulated
+    bool paused;
+    double due;          // input samples owed to the output, carried between frames
+    u32 position;        // samples of head already played
+    u32 starvedFrames;   // frames since the queue ran dry
+    u32 depth;           // wave buffers queued
+    u32 fullDepth;       // deepest the queue has been, what recovery means getting back to
+    bool recovering;
+    u32 dryFrame;        // frame_count when the queue ran dry
+    u32 underruns;
+    hostNdspStats stats;
+} HostChannel;
+
+static HostChannel channels[HOST_NDSP_CHANNELS];
+static ndspCallback frame_callback;
+static void* frame_callback_data;
+static hostNdspSink sink;
+static void* sink_data;
+static u32 frame_count;
+static float master_volume = 1.0f;
+static ndspWaveBuf* capture;
+static s32 frame_mix[HOST_NDSP_FRAME_SAMPLES * 2];
+static s16 frame_input[HOST_NDSP_MAX_FRAME_INPUT * 2];
+static hostNdspFaults faults;
+static u32 fault_rng;
+static u32 callback_hold;  // the callback doesn't run before this frame
+static ndspOutputMode output_mode = NDSP_OUTPUT_STEREO;
+
+static int channel_count(const HostChannel* chn) {
+    return NDSP_CHANNELS(chn->format) ? NDSP_CHANNELS(chn->format) : 1;
+}
+
+// === SYSTEM ===
+
+Result ndspInit(void) {
+    memset(channels, 0, sizeof(channels));
+    for (int i = 0; i < HOST_NDSP_CHANNELS; ++i)
+        ndspChnReset(i);
+    frame_count = 0;
+    return 0;
+}
+
+void ndspExit(void) {
+    frame_callback = NULL;
+}
+
+u32 ndspGetDroppedFrames(void) {
+    return 0;
+}
+
+u32 ndspGetFrameCount(void) {
+    return frame_count;
+}
+
+void ndspSetMasterVol(float volume) {
+    master_volume = volume;
+}
+
+float ndspGetMasterVol(void) {
+    return master_volume;
+}
+
+void ndspSetOutputMode(ndspOutputMode mode) {
+    output_mode = mode;
+}
+
+ndspOutputMode ndspGetOutputMode(void) {
+    return output_mode;
+}
+
+void ndspSetCapture(ndspWaveBuf* buf) {
+    capture = buf;
+}
+
+void ndspSetCallback(ndspCallback callback, void* data) {
+    frame_callback = callback;
+    frame_callback_data = data;
+}
+
+// === CHANNELS ===
+
+void ndspChnReset(int id) {
+    ndspChnWaveBufClear(id);
+    HostChannel* chn = &channels[id];
+    chn->rate = 1.0f;
+    chn->format = NDSP_FORMAT_MONO_PCM16;
+    chn->mix[0] = chn->mix[1] = 1.0f;
+    chn->paused = false;
+}
+
+bool ndspChnIsPlaying(int id) {
+    return channels[id].head != NULL;
+}
+
+u32 ndspChnGetSamplePos(int id) {
+    return channels[id].position;
+}
+
+u16 ndspChnGetWaveBufSeq(int id) {
+    return channels[id].head ? channels[id].head->sequence_id : 0;
+}
+
+bool ndspChnIsPaused(int id) {
+    return channels[id].paused;
+}
+
+void ndspChnSetPaused(int id, bool paused) {
+    channels[id].paused = paused;
+}
+
+void ndspChnSetFormat(int id, u16 format) {
+    channels[id].format = format;
+}
+
+void ndspChnSetInterp(int id, ndspInterpType type) {
+}
+
+void ndspChnSetRate(int id, float rate) {
+    channels[id].rate = rate;
+}
+
+void ndspChnSetMix(int id, float mix[12]) {
+    channels[id].mix[0] = mix[0];
+    channels[id].mix[1] = mix[1];
+}
+
+void ndspChnWaveBufClear(int id) {
+    HostChannel* chn = &channels[id];
+    for (ndspWaveBuf* buf = chn->head; buf; buf = buf->next)
+        buf->status = NDSP_WBUF_FREE;
+    chn->head = chn->tail = NULL;
+    chn->position = 0;
+    chn->due = 0.0;
+    chn->starvedFrames = 0;
+    chn->depth = 0;
+    chn->recovering = false;
+}
+
+void ndspChnWaveBufAdd(int id, ndspWaveBuf* buf) {
+    HostChannel* chn = &channels[id];
+    buf->status = NDSP_WBUF_QUEUED;
+    buf->sequence_id = ++chn->sequence;
+    buf->next = NULL;
+    if (chn->tail)
+        chn->tail->next = buf;
+    else
+        chn->head = buf;
+    chn->tail = buf;
+    if (++chn->depth > chn->fullDepth)
+        chn->fullDepth = chn->depth;
+
+    // Audio arriving after the queue ran dry means there was an audible gap
+    if (chn->starvedFrames > 0) {
+        chn->underruns++;
+        chn->stats.underruns++;
+        chn->stats.starvedFrames += chn->starvedFrames;
+        chn->starvedFrames = 0;
+    }
+    if (chn->recovering && chn->depth >= chn->fullDepth) {
+        u32 frames = frame_count - chn->dryFrame;
+        chn->recovering = false;
+        chn->stats.recoveries++;
+        chn->stats.recoveryFrames += frames;
+        if (frames > chn->stats.worstRecoveryFrames)
+            chn->stats.worstRecoveryFrames = frames;
+    }
+}
+
+// === SIMULATION ===
+
+/* Adds what a channel played this frame to the output mix
+Nearest-neighbour resampling from the channel rate to the DSP rate, with the
+channel's front gains: enough for captured output to show where each
+buffer's audio landed, not a model of the DSP's interpolation.
+*/
+static void mix_channel(const HostChannel* chn, u32 consumed, double owed) {
+    int count = channel_count(chn);
+    for (u32 j = 0; j < HOST_NDSP_FRAME_SAMPLES; ++j) {
+        u32 index = (u32)(j * owed / HOST_NDSP_FRAME_SAMPLES);
+        if (index >= consumed)
+            break;
+        const s16* frame = frame_input + index * count;
+        frame_mix[j * 2] += (s32)(frame[0] * chn->mix[0]);
+        frame_mix[j * 2 + 1] += (s32)(frame[count - 1] * chn->mix[1]);
+    }
+}
+
+// The mix goes out in 160-frame steps, wrapping at the end of the buffer like the DSP's capture
+static void write_capture(void) {
+    for (u32 j = 0; j < HOST_NDSP_FRAME_SAMPLES * 2; ++j) {
+        s32 sample = (s32)(frame_mix[j] * master_volume);
+        capture->data_pcm16[capture->offset * 2 + j % 2] = sample > 32767 ? 32767 : sample < -32768 ? -32768 : sample;
+        if (j % 2 == 1 && ++capture->offset >= capture->nsamples)
+            capture->offset = 0;
+    }
+}
+
+static void play_channel(int id, HostChannel* chn) {
+    if (chn->paused || (!chn->head && chn->starvedFrames == 0))
+        return;
+
+    chn->due += HOST_NDSP_FRAME_SAMPLES * chn->rate / NDSP_SAMPLE_RATE;
+    double owed = chn->due;
+    u32 consumed = 0;
+    while (chn->due >= 1.0 && chn->head) {
+        ndspWaveBuf* buf = chn->head;
+        buf->status = NDSP_WBUF_PLAYING;
+
+        u32 frames = buf->nsamples - chn->position;
+        if (frames > (u32)chn->due)
+            frames = (u32)chn->due;
+        const s16* samples = buf->data_pcm16 + chn->position * channel_count(chn);
+        if (sink && frames > 0)
+            sink(id, samples, frames, channel_count(chn), chn->rate, sink_data);
+        if (capture && consumed + frames <= HOST_NDSP_MAX_FRAME_INPUT) {
+            memcpy(frame_input + consumed * channel_count(chn), samples, frames * channel_count(chn) * sizeof(s16));
+            consumed += frames;
+        }
+
+        chn->position += frames;
+        chn->due -= frames;
+        if (chn->position >= buf->nsamples) {
+            buf->status = NDSP_WBUF_DONE;
+            chn->head = buf->next;
+            if (!chn->head)
+                chn->tail = NULL;
+            chn->position = 0;
+            chn->depth--;
+        }
+    }
+
+    if (capture)
+        mix_channel(chn, consumed, owed);
+
+    if (chn->due >= 1.0) {
+        if (chn->starvedFrames++ == 0 && !chn->recovering) {
+            chn->recovering = true;
+            chn->dryFrame = frame_count;
+        }
+        chn->due = 0.0;
+    }
+}
+
+static void play_frame(void) {
+    if (capture)
+        memset(frame_mix, 0, sizeof(frame_mix));
+    for (int i = 0; i < HOST_NDSP_CHANNELS; ++i)
+        play_channel(i, &channels[i]);
+    if (capture)
+        write_capture();
+    frame_count++;
+}
+
+static u32 next_fault_random(void) {
+    fault_rng ^= fault_rng << 13;
+    fault_rng ^= fault_rng >> 17;
+    fault_rng ^= fault_rng << 5;
+    return fault_rng;
+}
+
+/* Whether the callback thread gets to run this frame
+On the 3DS a late callback thread misses the frames in between and runs
+once when it wakes, which is what holding it back here amounts to.
+*/
+static bool callback_runs(void) {
+    if (faults.delayEvery && frame_count % faults.delayEvery == 0)
+        callback_hold = frame_count + faults.delayFrames;
+    if (frame_count < callback_hold)
+        return false;
+    if (faults.jitterFrames)
+        callback_hold = frame_count + 1 + next_fault_random() % (faults.jitterFrames + 1);
+    return true;
+}
+
+void hostNdspFrame(void) {
+    play_frame();
+    if (frame_callback && callback_runs())
+        frame_callback(frame_callback_data);
+}
+
+void hostNdspStall(u32 frames) {
+    for (u32 i = 0; i < frames; ++i)
+        play_frame();
+}
+
+void hostNdspSetFaults(const hostNdspFaults* newFaults) {
+    if (newFaults)
+        faults = *newFaults;
+    else
+        memset(&faults, 0, sizeof(faults));
+    fault_rng = faults.seed ? faults.seed : 1;
+    callback_hold = 0;
+}
+
+double hostNdspTime(void) {
+    return frame_count * (double)HOST_NDSP_FRAME_SAMPLES / NDSP_SAMPLE_RATE;
+}
+
+void hostNdspSetSink(hostNdspSink newSink, void* data) {
+    sink = newSink;
+    sink_data = data;
+}
+
+u32 hostNdspUnderruns(int id) {
+    return channels[id].underruns;
+}
+
+void hostNdspGetStats(int id, hostNdspStats* out) {
+    *out = channels[id].stats;
+}
+
+void hostNdspResetStats(void) {
+    for (int i = 0; i < HOST_NDSP_CHANNELS; ++i)
+        memset(&channels[i].stats, 0, sizeof(hostNdspStats));
+}
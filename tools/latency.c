@@ -0,0 +1,183 @@
+/* latency - measures output latency through the simulated DSP's capture
+Usage: latency [-n measurements] [-s seed] track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -o latency tools/latency.c tools/host/ndsp_host.c tools/host/ctru_host.c
+       tools/host/assets_host.c source/latency.c source/memory.c source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c source/collate.c source/filter.c source/history.c source/stats.c -lvorbisidec -lm
+
+The host counterpart of the app's latency mode, with the same markers and
+capture scanning (source/latency.c). The tick counter follows the DSP's
+virtual clock, so results are in DSP time and show what the queue and its
+handling cost. Enqueue-to-output markers are taken during steady playback;
+"presses" switch tracks or seek at a random display frame and are measured
+from that frame to the first audio they produce. Time between a physical
+press and the frame that reads it (up to one display frame on the 3DS) and
+the DSP's own output pipeline aren't part of the simulation. Resumes are
+timed by the player itself, from playerPause(false) to the first callback
+after the channel has moved, since their audio is already queued.
+*/
+#include <3ds.h>
+#include "assets_host.h"
+#include "boost.h"
+#include "latency.h"
+#include "player.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LATENCY_DEFAULT_MEASUREMENTS 60
+#define LATENCY_MAX_WAIT_FRAMES      2000  // DSP frames before a marker counts as lost
+#define LATENCY_DISPLAY_FRAME        (SYSCLOCK_ARM11 / 60)
+
+typedef enum {
+    TEST_ENQUEUE,
+    TEST_SWITCH,
+    TEST_SEEK,
+    TEST_RESUME,
+    TEST_COUNT
+} Test;
+
+static const char* const test_names[TEST_COUNT] = {
+    "enqueue->output", "press->audible (switch)", "press->audible (seek)", "press->audible (resume)"
+};
+
+typedef struct {
+    u32 count;
+    u32 lost;
+    float total;
+    float least;
+    float worst;
+} Stats;
+
+static u32 rng_state;
+static u64 frame_ticks;
+
+static u32 next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void run_frame(void) {
+    hostClockAdvance(frame_ticks);
+    hostNdspFrame();
+    boostUpdate();
+}
+
+// Plays on until the marker's result arrives
+static bool wait_result(LatencyResult* result) {
+    for (u32 i = 0; i < LATENCY_MAX_WAIT_FRAMES; ++i) {
+        run_frame();
+        if (latencyPollResult(result))
+            return true;
+    }
+    return false;
+}
+
+static bool wait_resume(LatencyResult* result) {
+    for (u32 i = 0; i < LATENCY_MAX_WAIT_FRAMES; ++i) {
+        run_frame();
+        if (playerPollResumeLatency(&result->ms))
+            return true;
+    }
+    return false;
+}
+
+static void add(Stats* stats, bool found, float ms) {
+    if (!found) {
+        stats->lost++;
+        return;
+    }
+    if (stats->count == 0 || ms < stats->least)
+        stats->least = ms;
+    if (ms > stats->worst)
+        stats->worst = ms;
+    stats->total += ms;
+    stats->count++;
+}
+
+int main(int argc, char** argv) {
+    u32 measurements = LATENCY_DEFAULT_MEASUREMENTS;
+    u32 seed = 1;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-n") == 0)
+            measurements = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else if (strcmp(argv[arg], "-s") == 0)
+            seed = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else
+            break;
+        arg += 2;
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "usage: %s [-n measurements] [-s seed] track.ogg [track.ogg ...]\n", argv[0]);
+        return 1;
+    }
+    rng_state = seed ? seed : 1;
+
+    if (!hostAssetsLoad(argv + arg, argc - arg))
+        return 1;
+    frame_ticks = (u64)(SYSCLOCK_ARM11 * 160.0 / NDSP_SAMPLE_RATE);
+    hostClockSetVirtual(true);
+    playerInit();
+    if (!latencyStart()) {
+        fprintf(stderr, "cannot allocate the capture buffer\n");
+        return 1;
+    }
+
+    int tracks = playerTrackCount();
+    Stats stats[TEST_COUNT] = { { 0 } };
+    for (u32 i = 0; i < measurements; ++i) {
+        Test test = (Test)(i % TEST_COUNT);
+        int track = next_random() % tracks;
+        if (!playerIsPlaying())
+            playerPlay(track);
+        if (test == TEST_RESUME)
+            playerPause(true);
+
+        // Settle into steady playback, then line up with a display frame the way the main loop reads input
+        for (u32 f = 0, settle = 100 + next_random() % 200; f < settle; ++f)
+            run_frame();
+        u64 now = svcGetSystemTick();
+        for (u64 frameStart = (now / LATENCY_DISPLAY_FRAME + 1) * LATENCY_DISPLAY_FRAME; now < frameStart;
+             now = svcGetSystemTick())
+            run_frame();
+
+        // A lost marker may have been queued by a later play; its result belongs to no test
+        LatencyResult result;
+        while (latencyPollResult(&result)) {
+        }
+        switch (test) {
+        case TEST_ENQUEUE:
+            latencyArm(LATENCY_ENQUEUE, 0);
+            break;
+        case TEST_SWITCH:
+            latencyArm(LATENCY_PRESS, now);
+            playerPlay(track);
+            break;
+        case TEST_SEEK:
+            latencyArm(LATENCY_PRESS, now);
+            playerSeek(playerTrackLength(track) * (next_random() % 900) / 1000.0f);
+            break;
+        case TEST_RESUME:
+            playerPause(false);
+            break;
+        default:
+            break;
+        }
+        bool found = test == TEST_RESUME ? wait_resume(&result) : wait_result(&result);
+        add(&stats[test], found, result.ms);
+    }
+
+    printf("%-26s %6s %8s %8s %8s %5s\n", "", "count", "min ms", "mean ms", "max ms", "lost");
+    for (int t = 0; t < TEST_COUNT; ++t) {
+        const Stats* s = &stats[t];
+        printf("%-26s %6u %8.1f %8.1f %8.1f %5u\n", test_names[t], s->count, s->least,
+            s->count ? s->total / s->count : 0.0f, s->worst, s->lost);
+    }
+
+    latencyStop();
+    playerExit();
+    hostAssetsFree();
+    return 0;
+}
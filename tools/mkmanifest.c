@@ -0,0 +1,273 @@
+/* mkmanifest - generates the embedded track table (assets_manifest.c) from Ogg Vorbis files
+Usage: mkmanifest assets_manifest.c <track.ogg | directory> ...
+Build: cc -O2 -Itools/host -Isource -o mkmanifest tools/mkmanifest.c source/oggindex.c
+
+Run by the build over assets/ so that whatever is there is embedded, in
+file name order, without code changes. Each file's bytes are pulled in with
+.incbin and described by an EmbeddedAsset (source/assets.h): size, name
+(the TITLE comment, else the file name), sample rate, channel count, length
+in samples and its slice of one shared seek table built with the same
+oggindex.c code the player would otherwise run on device. The output only
+changes when the tracks do, so it can sit behind a make dependency on them.
+*/
+#include "assets.h"
+#include "oggindex.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+typedef struct {
+    const char* path;
+    char fullPath[PATH_MAX];
+    u8* data;
+    u32 size;
+    char* title;
+    u32 sampleRate;
+    u16 channels;
+    u32 totalSamples;
+    PackSeekPoint* seek;
+    u32 seekCount;
+} Input;
+
+static u32 read_u32(const u8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static char* dup_range(const char* s, u32 len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+// TITLE from the Vorbis comment packet, if there is one
+static char* parse_title(const u8* packet, u32 size) {
+    if (size < 7 + 4 || packet[0] != 3 || memcmp(packet + 1, "vorbis", 6) != 0)
+        return NULL;
+
+    u32 pos = 7;
+    u32 vendorLen = read_u32(packet + pos);
+    pos += 4;
+    if (vendorLen > size - pos || size - pos - vendorLen < 4)
+        return NULL;
+    pos += vendorLen;
+
+    u32 count = read_u32(packet + pos);
+    pos += 4;
+    for (u32 i = 0; i < count && size - pos >= 4; ++i) {
+        u32 len = read_u32(packet + pos);
+        pos += 4;
+        if (len > size - pos)
+            return NULL;
+
+        const char* comment = (const char*)packet + pos;
+        pos += len;
+        if (len > 6 && strncasecmp(comment, "TITLE=", 6) == 0)
+            return dup_range(comment + 6, len - 6);
+    }
+    return NULL;
+}
+
+// File name without directory or extension
+static char* file_stem(const char* path) {
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    const char* dot = strrchr(name, '.');
+    return dup_range(name, dot && dot != name ? (u32)(dot - name) : (u32)strlen(name));
+}
+
+static bool load_input(Input* in) {
+    FILE* file = fopen(in->path, "rb");
+    if (!file || !realpath(in->path, in->fullPath)) {
+        if (file)
+            fclose(file);
+        fprintf(stderr, "%s: cannot open\n", in->path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    in->data = malloc(size > 0 ? size : 1);
+    bool ok = size > 0 && fread(in->data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "%s: cannot read\n", in->path);
+        return false;
+    }
+    in->size = (u32)size;
+
+    u32 packetSize;
+    u8* packet = oggReadHeaderPacket(in->data, in->size, 0, &packetSize, NULL);
+    if (packet && packetSize >= 16 && packet[0] == 1 && memcmp(packet + 1, "vorbis", 6) == 0) {
+        in->channels = packet[11];
+        in->sampleRate = read_u32(packet + 12);
+    }
+    free(packet);
+
+    packet = oggReadHeaderPacket(in->data, in->size, 1, &packetSize, NULL);
+    if (packet)
+        in->title = parse_title(packet, packetSize);
+    free(packet);
+    if (!in->title)
+        in->title = file_stem(in->path);
+
+    if (in->sampleRate == 0 || in->channels == 0) {
+        fprintf(stderr, "%s: not Ogg Vorbis\n", in->path);
+        return false;
+    }
+    in->seekCount = oggBuildSeekTable(in->data, in->size, in->sampleRate * OGG_SEEK_INTERVAL_SECONDS,
+                                      &in->seek, &in->totalSamples);
+    return true;
+}
+
+static bool has_ogg_extension(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && strcasecmp(name + len - 4, ".ogg") == 0;
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Expands directories to the .ogg files directly inside them, sorted so the table is reproducible
+static char** collect_paths(char** args, int count, u32* outCount) {
+    u32 total = 0, capacity = 64;
+    char** paths = malloc(capacity * sizeof(char*));
+
+    for (int i = 0; i < count; ++i) {
+        struct stat st;
+        DIR* dir = (stat(args[i], &st) == 0 && S_ISDIR(st.st_mode)) ? opendir(args[i]) : NULL;
+        if (!dir) {
+            if (total == capacity)
+                paths = realloc(paths, (capacity *= 2) * sizeof(char*));
+            paths[total++] = strdup(args[i]);
+            continue;
+        }
+
+        u32 first = total;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (!has_ogg_extension(entry->d_name))
+                continue;
+            if (total == capacity)
+                paths = realloc(paths, (capacity *= 2) * sizeof(char*));
+            size_t len = strlen(args[i]) + strlen(entry->d_name) + 2;
+            paths[total] = malloc(len);
+            snprintf(paths[total++], len, "%s/%s", args[i], entry->d_name);
+        }
+        closedir(dir);
+        qsort(paths + first, total - first, sizeof(char*), compare_paths);
+    }
+
+    *outCount = total;
+    return paths;
+}
+
+// A C string literal; `nested` escapes once more for a string inside the assembler text of __asm__
+static void write_string(FILE* out, const char* s, bool nested) {
+    fputc('"', out);
+    if (nested)
+        fputs("\\\"", out);
+    for (; *s; ++s) {
+        u8 c = (u8)*s;
+        if (c == '"' || c == '\\')
+            fputs(nested ? "\\\\\\" : "\\", out);
+        if (c < 0x20)
+            fprintf(out, "\\%03o", c);
+        else
+            fputc(c, out);
+    }
+    if (nested)
+        fputs("\\\"", out);
+    fputc('"', out);
+}
+
+static bool write_manifest(const char* path, const Input* inputs, u32 count) {
+    FILE* out = fopen(path, "w");
+    if (!out)
+        return false;
+
+    fprintf(out, "// Generated by tools/mkmanifest.c from %u track%s; do not edit\n", count, count == 1 ? "" : "s");
+    fprintf(out, "#include \"assets.h\"\n\n");
+
+    if (count > 0) {
+        fprintf(out, "__asm__(\n    \"    .section .rodata\\n\"\n");
+        for (u32 i = 0; i < count; ++i) {
+            fprintf(out, "    \"    .balign 4\\n\"\n    \"assetManifestData%u:\\n\"\n    \"    .incbin \" ", i);
+            write_string(out, inputs[i].fullPath, true);
+            fprintf(out, " \"\\n\"\n");
+        }
+        fprintf(out, "    \"    .previous\\n\");\n\n");
+        for (u32 i = 0; i < count; ++i)
+            fprintf(out, "extern const unsigned char assetManifestData%u[];\n", i);
+        fprintf(out, "\n");
+    }
+
+    // Empty arrays aren't valid C, so a track-less build gets a zero entry and a count of 0
+    u32 totalPoints = 0;
+    fprintf(out, "const PackSeekPoint assetManifestSeekPoints[] = {\n");
+    for (u32 i = 0; i < count; ++i) {
+        fprintf(out, "    // %s\n", inputs[i].path);
+        for (u32 p = 0; p < inputs[i].seekCount; ++p)
+            fprintf(out, "    { %u, %u },\n", inputs[i].seek[p].sample, inputs[i].seek[p].offset);
+        totalPoints += inputs[i].seekCount;
+    }
+    if (totalPoints == 0)
+        fprintf(out, "    { 0, 0 },\n");
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const EmbeddedAsset assetManifest[] = {\n");
+    u32 first = 0;
+    for (u32 i = 0; i < count; ++i) {
+        const Input* in = &inputs[i];
+        fprintf(out, "    { assetManifestData%u, %u, ", i, in->size);
+        write_string(out, in->title, false);
+        fprintf(out, ", %u, %u, %u, %u, %u },\n", in->totalSamples, in->sampleRate, in->channels, first, in->seekCount);
+        first += in->seekCount;
+    }
+    if (count == 0)
+        fprintf(out, "    { 0 },\n");
+    fprintf(out, "};\n\nconst int assetManifestCount = %u;\n", count);
+
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s assets_manifest.c <track.ogg | directory> ...\n", argv[0]);
+        return 1;
+    }
+
+    u32 count;
+    char** paths = collect_paths(argv + 2, argc - 2, &count);
+    Input* inputs = calloc(count ? count : 1, sizeof(Input));
+    bool ok = true;
+    for (u32 i = 0; i < count && ok; ++i) {
+        inputs[i].path = paths[i];
+        ok = load_input(&inputs[i]);
+        if (ok)
+            printf("%-32s %3u:%02u  %5u Hz  %u ch  %4u seek points\n", inputs[i].title,
+                inputs[i].totalSamples / inputs[i].sampleRate / 60, inputs[i].totalSamples / inputs[i].sampleRate % 60,
+                inputs[i].sampleRate, inputs[i].channels, inputs[i].seekCount);
+    }
+    if (ok && !write_manifest(argv[1], inputs, count)) {
+        fprintf(stderr, "%s: cannot write\n", argv[1]);
+        ok = false;
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        free(inputs[i].data);
+        free(inputs[i].title);
+        free(inputs[i].seek);
+        free(paths[i]);
+    }
+    free(inputs);
+    free(paths);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,919 @@
+/* mkpack - builds a library pack (.xpk) from Ogg Vorbis and WAV files
+Usage: mkpack [-j threads] library.xpk <track.ogg | track.wav | directory> ...
+Build: cc -O2 -pthread -Itools/host -Isource -o mkpack tools/mkpack.c source/decoder.c source/oggindex.c source/pack.c source/search.c source/collate.c -lvorbisidec
+Copy the result to sdmc:/3ds/3dXMMP/library.xpk and the player picks it up in playerInit.
+
+Everything the player would otherwise work out on device is done here:
+the Vorbis header size, sample rate, channel count and duration, the
+TITLE/ARTIST/ALBUM comments and a seek table with a point about once a second.
+Each track is then fully decoded with the player's own decoder.c to get its
+loudness, peak and waveform overview, and the tags go into a trigram index
+for on-device search and presorted title/artist/album orderings, and the
+tags plus GENRE and DATE are stored as columns for smart playlists. Tracks are analysed in parallel on all
+cores (or -j threads) and throughput is reported in files per second.
+Only single-stream (unchained) Ogg Vorbis files are supported. WAV files
+(16-bit PCM) go in as they are, with tags from their LIST/INFO chunk and
+no seek table, since the player computes where a WAV sample is.
+
+A file with a CUE sheet of the same name beside it (mix.ogg, mix.cue) is
+stored once and listed as one track per sheet TRACK, cut at its INDEX 01
+(PACK_SECTION_CUES). Cuts share the file's seek table and loudness, so the
+player can jump between them on the open stream and play from one into the
+next without a change in gain; each gets its own waveform.
+*/
+#include "pack.h"
+#include "collate.h"
+#include "decoder.h"
+#include "oggindex.h"
+#include "search.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOUDNESS_BLOCK_MS     50
+#define LOUDNESS_GATE         1e-7   // -70 dBFS; quieter blocks don't count towards loudness
+#define DECODE_BUFFER_BYTES   (16 * 1024)
+#define CUE_FRAMES_PER_SECOND 75
+#define CUE_LINE_MAX          1024
+
+// One TRACK of a CUE sheet
+typedef struct {
+    char* title;
+    char* performer;
+    u32 frame;  // INDEX 01 in CD frames from the start of the file
+    u32 start;  // the same in samples, once the file's rate is known
+    u8 waveform[PACK_WAVEFORM_POINTS];
+} CueTrack;
+
+typedef struct {
+    const char* path;
+    u8* data;
+    u32 size;
+    u32 headerSize;
+    u32 sampleRate;
+    u32 totalSamples;
+    u16 channels;
+    PackSeekPoint* seek;
+    u32 seekCount;
+    char* title;
+    char* artist;
+    char* album;
+    char* genre;
+    u16 year;
+    PackLoudness loudness;
+    u8 waveform[PACK_WAVEFORM_POINTS];
+    u64 decodedSamples;
+    char* cueTitle;     // sheet-wide TITLE and PERFORMER
+    char* cuePerformer;
+    CueTrack* cues;     // NULL when the file has no CUE sheet
+    u32 cueCount;
+    u32 start;          // cut tracks only: first sample in the file, with totalSamples the cut's length
+    u32 source;         // file the track's data comes from; cuts of one file share it
+    bool ok;
+} Input;
+
+typedef struct {
+    char* data;
+    u32 size;
+    u32 capacity;
+} StringPool;
+
+// One directory section waiting to be laid out
+typedef struct {
+    u32 id;
+    const void* data;
+    u32 size;
+} SectionData;
+
+#define MAX_SECTIONS 9
+
+static u32 read_u32(const u8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static char* dup_range(const char* s, u32 len) {
+    char* out = malloc(len + 1);
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return out;
+}
+
+// DATE is free-form; the year is the first run of four digits ("1997", "1997-05-12", "May 1997")
+static u16 parse_year(const char* date, u32 len) {
+    u32 i = 0;
+    while (i < len) {
+        u32 digits = 0;
+        while (i + digits < len && date[i + digits] >= '0' && date[i + digits] <= '9')
+            digits++;
+        if (digits == 4)
+            return (date[i] - '0') * 1000 + (date[i + 1] - '0') * 100 + (date[i + 2] - '0') * 10 + (date[i + 3] - '0');
+        i += digits ? digits : 1;
+    }
+    return 0;
+}
+
+static void parse_comments(Input* in, const u8* packet, u32 size) {
+    if (size < 7 + 4 || packet[0] != 3 || memcmp(packet + 1, "vorbis", 6) != 0)
+        return;
+
+    u32 pos = 7;
+    u32 vendorLen = read_u32(packet + pos);
+    pos += 4;
+    if (vendorLen > size - pos || size - pos - vendorLen < 4)
+        return;
+    pos += vendorLen;
+
+    u32 count = read_u32(packet + pos);
+    pos += 4;
+    for (u32 i = 0; i < count && size - pos >= 4; ++i) {
+        u32 len = read_u32(packet + pos);
+        pos += 4;
+        if (len > size - pos)
+            return;
+
+        const char* comment = (const char*)packet + pos;
+        const char* eq = memchr(comment, '=', len);
+        pos += len;
+        if (!eq)
+            continue;
+
+        u32 keyLen = eq - comment;
+        char** field = NULL;
+        if (keyLen == 5 && strncasecmp(comment, "TITLE", 5) == 0)
+            field = &in->title;
+        else if (keyLen == 6 && strncasecmp(comment, "ARTIST", 6) == 0)
+            field = &in->artist;
+        else if (keyLen == 5 && strncasecmp(comment, "ALBUM", 5) == 0)
+            field = &in->album;
+        else if (keyLen == 5 && strncasecmp(comment, "GENRE", 5) == 0)
+            field = &in->genre;
+        else if (keyLen == 4 && strncasecmp(comment, "DATE", 4) == 0 && !in->year)
+            in->year = parse_year(eq + 1, len - keyLen - 1);
+
+        if (field && !*field)
+            *field = dup_range(eq + 1, len - keyLen - 1);
+    }
+}
+
+// Tags from a LIST/INFO chunk: NUL-terminated strings, often padded
+static void parse_info(Input* in, const u8* info, u32 size) {
+    for (u32 pos = 0; size - pos >= 8;) {
+        u32 len = read_u32(info + pos + 4);
+        if (len > size - pos - 8)
+            return;
+
+        const char* text = (const char*)info + pos + 8;
+        u32 textLen = (u32)strnlen(text, len);
+        char** field = NULL;
+        if (memcmp(info + pos, "INAM", 4) == 0)
+            field = &in->title;
+        else if (memcmp(info + pos, "IART", 4) == 0)
+            field = &in->artist;
+        else if (memcmp(info + pos, "IPRD", 4) == 0)
+            field = &in->album;
+        else if (memcmp(info + pos, "IGNR", 4) == 0)
+            field = &in->genre;
+        else if (memcmp(info + pos, "ICRD", 4) == 0 && !in->year)
+            in->year = parse_year(text, textLen);
+
+        if (field && !*field && textLen > 0)
+            *field = dup_range(text, textLen);
+        pos += 8 + len + (len & 1);
+    }
+}
+
+/* Reads the format and tags of a WAV file
+The player's decoder parses the format and finds the sample data, so a
+file that gets in here is one the player can open; headerSize is where the
+samples start.
+*/
+static bool scan_wav(Input* in) {
+    Decoder decoder;
+    if (!decoderOpenMemory(&decoder, in->data, in->size))
+        return false;
+    in->channels = decoder.channels;
+    in->sampleRate = decoder.rate;
+    in->totalSamples = (u32)decoderTotalSamples(&decoder);
+    in->headerSize = decoder.pcmOffset;
+    decoderClose(&decoder);
+
+    for (u32 pos = 12; in->size - pos >= 8;) {
+        u32 size = read_u32(in->data + pos + 4);
+        if (size > in->size - pos - 8)
+            break;
+        if (memcmp(in->data + pos, "LIST", 4) == 0 && size >= 4 && memcmp(in->data + pos + 8, "INFO", 4) == 0)
+            parse_info(in, in->data + pos + 12, size - 4);
+        pos += 8 + size + (size & 1);
+    }
+    return true;
+}
+
+/* Reads the Vorbis headers of one file
+The first three packets are the Vorbis headers; the page that ends the third
+one is where audio starts. The seek table comes from the same oggindex.c code
+the player uses for tracks that aren't in a pack.
+*/
+static bool scan_input(Input* in) {
+    if (in->size >= 12 && memcmp(in->data, "RIFF", 4) == 0 && memcmp(in->data + 8, "WAVE", 4) == 0)
+        return scan_wav(in);
+
+    u32 size;
+    u8* packet = oggReadHeaderPacket(in->data, in->size, 0, &size, NULL);
+    if (packet && size >= 16 && packet[0] == 1 && memcmp(packet + 1, "vorbis", 6) == 0) {
+        in->channels = packet[11];
+        in->sampleRate = read_u32(packet + 12);
+    }
+    free(packet);
+
+    packet = oggReadHeaderPacket(in->data, in->size, 1, &size, NULL);
+    if (packet)
+        parse_comments(in, packet, size);
+    free(packet);
+
+    packet = oggReadHeaderPacket(in->data, in->size, 2, &size, &in->headerSize);
+    bool complete = packet != NULL;
+    free(packet);
+    if (!complete || in->sampleRate == 0 || in->channels == 0)
+        return false;
+
+    in->seekCount = oggBuildSeekTable(in->data, in->size, in->sampleRate * OGG_SEEK_INTERVAL_SECONDS,
+                                      &in->seek, &in->totalSamples);
+    return true;
+}
+
+// Next token of a CUE sheet line, a quoted string or a run of non-blanks; NULL at the end of the line
+static const char* cue_token(const char** line, u32* len) {
+    const char* s = *line;
+    while (*s == ' ' || *s == '\t')
+        s++;
+    if (*s == '\0' || *s == '\r' || *s == '\n')
+        return NULL;
+
+    const char* token;
+    if (*s == '"') {
+        token = ++s;
+        while (*s && *s != '"' && *s != '\r' && *s != '\n')
+            s++;
+        *len = s - token;
+        if (*s == '"')
+            s++;
+    } else {
+        token = s;
+        while (*s && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n')
+            s++;
+        *len = s - token;
+    }
+    *line = s;
+    return token;
+}
+
+static bool cue_keyword(const char* token, u32 len, const char* keyword) {
+    return len == strlen(keyword) && strncasecmp(token, keyword, len) == 0;
+}
+
+/* Reads the CUE sheet beside a file, if there is one
+Only what cutting a single-file mix needs is kept: the sheet's TITLE,
+PERFORMER, REM GENRE and REM DATE, and each TRACK's TITLE, PERFORMER and
+INDEX 01 (pregaps stay with the track before). A sheet naming more than one
+FILE, with a track missing its index, indexes out of order or reaching past
+the end is ignored with a warning and the file goes in whole.
+*/
+static void read_cue_sheet(Input* in) {
+    const char* dot = strrchr(in->path, '.');
+    const char* slash = strrchr(in->path, '/');
+    u32 stem = dot && (!slash || dot > slash) ? (u32)(dot - in->path) : (u32)strlen(in->path);
+    char* cuePath = malloc(stem + 5);
+    memcpy(cuePath, in->path, stem);
+    memcpy(cuePath + stem, ".cue", 5);
+    FILE* file = fopen(cuePath, "r");
+    if (!file) {
+        free(cuePath);
+        return;
+    }
+
+    u32 count = 0, capacity = 16, files = 0;
+    CueTrack* cues = calloc(capacity, sizeof(CueTrack));
+    char line[CUE_LINE_MAX];
+    while (fgets(line, sizeof(line), file)) {
+        const char* s = line;
+        if ((u8)s[0] == 0xEF && (u8)s[1] == 0xBB && (u8)s[2] == 0xBF)
+            s += 3;  // UTF-8 byte order mark
+
+        u32 len, argLen;
+        const char* keyword = cue_token(&s, &len);
+        const char* arg = keyword ? cue_token(&s, &argLen) : NULL;
+        if (!arg)
+            continue;
+
+        CueTrack* track = count ? &cues[count - 1] : NULL;
+        if (cue_keyword(keyword, len, "FILE")) {
+            files++;
+        } else if (cue_keyword(keyword, len, "TRACK")) {
+            if (count == capacity)
+                cues = realloc(cues, (capacity *= 2) * sizeof(CueTrack));
+            cues[count++] = (CueTrack){ .frame = (u32)-1 };
+        } else if (cue_keyword(keyword, len, "TITLE") || cue_keyword(keyword, len, "PERFORMER")) {
+            bool title = len == 5;
+            char** field = track ? (title ? &track->title : &track->performer) : (title ? &in->cueTitle : &in->cuePerformer);
+            if (!*field && argLen > 0)
+                *field = dup_range(arg, argLen);
+        } else if (cue_keyword(keyword, len, "INDEX") && track && argLen == 2 && memcmp(arg, "01", 2) == 0) {
+            const char* time = cue_token(&s, &len);
+            char text[16];
+            unsigned minutes, seconds, frames;
+            if (time && len < sizeof(text)) {
+                memcpy(text, time, len);
+                text[len] = '\0';
+                if (sscanf(text, "%u:%u:%u", &minutes, &seconds, &frames) == 3 && seconds < 60 &&
+                    frames < CUE_FRAMES_PER_SECOND)
+                    track->frame = (minutes * 60 + seconds) * CUE_FRAMES_PER_SECOND + frames;
+            }
+        } else if (cue_keyword(keyword, len, "REM") && !track) {
+            const char* value = cue_token(&s, &len);
+            if (value && cue_keyword(arg, argLen, "GENRE") && !in->genre && len > 0)
+                in->genre = dup_range(value, len);
+            else if (value && cue_keyword(arg, argLen, "DATE") && !in->year)
+                in->year = parse_year(value, len);
+        }
+    }
+    fclose(file);
+
+    const char* problem = files != 1 ? "must name exactly one FILE" : count == 0 ? "has no tracks" : NULL;
+    for (u32 i = 0; i < count && !problem; ++i) {
+        cues[i].start = (u32)((u64)cues[i].frame * in->sampleRate / CUE_FRAMES_PER_SECOND);
+        if (cues[i].frame == (u32)-1)
+            problem = "has a track without INDEX 01";
+        else if (i > 0 && cues[i].start <= cues[i - 1].start)
+            problem = "has indexes out of order";
+        else if (cues[i].start >= in->totalSamples)
+            problem = "has an index past the end of the file";
+    }
+    if (problem) {
+        fprintf(stderr, "%s: warning: sheet %s, packing %s whole\n", cuePath, problem, in->path);
+        for (u32 i = 0; i < count; ++i) {
+            free(cues[i].title);
+            free(cues[i].performer);
+        }
+        free(cues);
+    } else {
+        in->cues = cues;
+        in->cueCount = count;
+    }
+    free(cuePath);
+}
+
+// Raises the waveform point that `frame` of `length` falls in to `level`
+static void mark_waveform(u8* waveform, u64 frame, u64 length, u8 level) {
+    u32 point = length ? (u32)(frame * PACK_WAVEFORM_POINTS / length) : PACK_WAVEFORM_POINTS;
+    if (point < PACK_WAVEFORM_POINTS && level > waveform[point])
+        waveform[point] = level;
+}
+
+/* Decodes the whole track through the player's decoder
+Loudness is the mean power of 50 ms blocks above a -70 dBFS gate (no frequency
+weighting), turned into the gain that brings it to PACK_LOUDNESS_TARGET.
+A file cut by a CUE sheet gets one loudness, and a waveform per cut.
+*/
+static bool decode_input(Input* in) {
+    Decoder decoder;
+    if (!decoderOpenMemory(&decoder, in->data, in->size))
+        return false;
+
+    s16* buffer = malloc(DECODE_BUFFER_BYTES);
+    u32 blockFrames = decoder.rate * LOUDNESS_BLOCK_MS / 1000;
+    u32 blockFill = 0;
+    double blockSum = 0.0, gatedSum = 0.0;
+    u64 gatedBlocks = 0;
+    u32 peak = 0;
+    u64 frame = 0;
+    u32 cue = 0;
+
+    long bytesRead;
+    while ((bytesRead = decoderRead(&decoder, buffer, DECODE_BUFFER_BYTES)) != 0) {
+        if (bytesRead < 0)
+            continue;  // hole in the stream, keep going like the player would
+
+        long frames = bytesRead / sizeof(s16) / decoder.channels;
+        for (long i = 0; i < frames; ++i, ++frame) {
+            u32 framePeak = 0;
+            for (int c = 0; c < decoder.channels; ++c) {
+                s32 sample = buffer[i * decoder.channels + c];
+                u32 magnitude = sample < 0 ? -sample : sample;
+                blockSum += (double)sample * sample;
+                if (magnitude > framePeak)
+                    framePeak = magnitude;
+            }
+            if (framePeak > peak)
+                peak = framePeak;
+
+            u8 level = (u8)(framePeak >> 7);
+            if (in->cueCount) {
+                while (cue + 1 < in->cueCount && frame >= in->cues[cue + 1].start)
+                    cue++;
+                const CueTrack* cut = &in->cues[cue];
+                u64 end = cue + 1 < in->cueCount ? in->cues[cue + 1].start : in->totalSamples;
+                if (frame >= cut->start)
+                    mark_waveform(in->cues[cue].waveform, frame - cut->start, end - cut->start, level);
+            } else {
+                mark_waveform(in->waveform, frame, in->totalSamples, level);
+            }
+
+            if (++blockFill == blockFrames) {
+                double power = blockSum / (blockFrames * decoder.channels * 32768.0 * 32768.0);
+                if (power > LOUDNESS_GATE) {
+                    gatedSum += power;
+                    gatedBlocks++;
+                }
+                blockFill = 0;
+                blockSum = 0.0;
+            }
+        }
+    }
+
+    free(buffer);
+    decoderClose(&decoder);
+
+    in->decodedSamples = frame;
+    in->loudness.peak = peak > 32767 ? 32767 : peak;
+    if (gatedBlocks > 0) {
+        double loudness = 10.0 * log10(gatedSum / gatedBlocks);
+        double gain = (PACK_LOUDNESS_TARGET - loudness) * 100.0;
+        if (gain > 3000.0) gain = 3000.0;
+        if (gain < -3000.0) gain = -3000.0;
+        in->loudness.gain = (s16)lround(gain);
+    }
+    return true;
+}
+
+static bool analyze_input(Input* in) {
+    const char* path = in->path;
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0 || (unsigned long)size > 0xFFFFFFFFu) {
+        fclose(file);
+        return false;
+    }
+
+    in->size = (u32)size;
+    in->data = malloc(in->size);
+    bool ok = fread(in->data, 1, in->size, file) == in->size;
+    fclose(file);
+    ok = ok && scan_input(in);
+    if (ok)
+        read_cue_sheet(in);
+    if (!ok || !decode_input(in)) {
+        free(in->data);
+        in->data = NULL;
+        return false;
+    }
+
+    // The pack writer streams the file again, so don't hold every track in memory
+    free(in->data);
+    in->data = NULL;
+
+    if (!in->title) {
+        // Fall back to the file name without directory or extension
+        const char* base = strrchr(path, '/');
+        base = base ? base + 1 : path;
+        const char* dot = strrchr(base, '.');
+        in->title = dup_range(base, dot ? (u32)(dot - base) : (u32)strlen(base));
+    }
+    return true;
+}
+
+static u32 pool_add(StringPool* pool, const char* s) {
+    if (!s || !*s)
+        return 0;
+
+    u32 len = strlen(s) + 1;
+    if (pool->size + len > pool->capacity) {
+        pool->capacity = (pool->size + len) * 2;
+        pool->data = realloc(pool->data, pool->capacity);
+    }
+    u32 offset = pool->size;
+    memcpy(pool->data + offset, s, len);
+    pool->size += len;
+    return offset;
+}
+
+static u32 align_up(u32 value, u32 align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static void write_padding(FILE* file, u32 count) {
+    static const u8 zeros[PACK_DATA_ALIGN];
+    fwrite(zeros, 1, count, file);
+}
+
+typedef struct {
+    Input* inputs;
+    u32 count;
+    atomic_uint next;
+} WorkQueue;
+
+static void* worker(void* arg) {
+    WorkQueue* queue = (WorkQueue*)arg;
+    for (;;) {
+        u32 i = atomic_fetch_add(&queue->next, 1);
+        if (i >= queue->count)
+            return NULL;
+        queue->inputs[i].ok = analyze_input(&queue->inputs[i]);
+    }
+}
+
+static bool has_track_extension(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && (strcasecmp(name + len - 4, ".ogg") == 0 || strcasecmp(name + len - 4, ".wav") == 0);
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// Expands directories to the .ogg and .wav files directly inside them, sorted so packs are reproducible
+static char** collect_paths(char** args, int count, u32* outCount) {
+    u32 total = 0, capacity = 64;
+    char** paths = malloc(capacity * sizeof(char*));
+
+    for (int i = 0; i < count; ++i) {
+        struct stat st;
+        DIR* dir = (stat(args[i], &st) == 0 && S_ISDIR(st.st_mode)) ? opendir(args[i]) : NULL;
+        if (!dir) {
+            if (total == capacity)
+                paths = realloc(paths, (capacity *= 2) * sizeof(char*));
+            paths[total++] = strdup(args[i]);
+            continue;
+        }
+
+        u32 first = total;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (!has_track_extension(entry->d_name))
+                continue;
+            if (total == capacity)
+                paths = realloc(paths, (capacity *= 2) * sizeof(char*));
+            size_t len = strlen(args[i]) + strlen(entry->d_name) + 2;
+            paths[total] = malloc(len);
+            snprintf(paths[total++], len, "%s/%s", args[i], entry->d_name);
+        }
+        closedir(dir);
+        qsort(paths + first, total - first, sizeof(char*), compare_paths);
+    }
+
+    *outCount = total;
+    return paths;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Copies a track's file into the pack without holding it all in memory
+static bool copy_file(FILE* out, const char* path, u32 size) {
+    FILE* in = fopen(path, "rb");
+    if (!in)
+        return false;
+
+    static u8 buffer[64 * 1024];
+    u32 remaining = size;
+    while (remaining > 0) {
+        size_t chunk = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        if (fread(buffer, 1, chunk, in) != chunk)
+            break;
+        fwrite(buffer, 1, chunk, out);
+        remaining -= chunk;
+    }
+    fclose(in);
+    return remaining == 0;
+}
+
+typedef struct {
+    const char* text;
+    u32 track;
+} ColumnValue;
+
+static int compare_values(const void* a, const void* b) {
+    const ColumnValue* x = (const ColumnValue*)a;
+    const ColumnValue* y = (const ColumnValue*)b;
+    int result = strcmp(x->text, y->text);
+    return result ? result : (x->track > y->track) - (x->track < y->track);
+}
+
+static const char* column_text(const Input* in, int column) {
+    const char* text = column == PACK_TEXT_GENRE ? in->genre : column == PACK_TEXT_ARTIST ? in->artist : in->album;
+    return text ? text : "";
+}
+
+/* Builds the PACK_SECTION_COLUMNS payload
+Each text column is dictionary-coded: its distinct values are numbered in
+byte order and every track stores its value's u16 id. Artist and album
+names reuse the tracks' string offsets; genres are added to the pool.
+Returns NULL if a column has more distinct values than an id can number.
+*/
+static u8* build_columns(const Input* inputs, const PackTrack* entries, u32 trackCount, StringPool* pool, u32* size) {
+    ColumnValue* values = malloc(trackCount * sizeof(ColumnValue));
+    u32* names = malloc((size_t)PACK_TEXT_COUNT * trackCount * sizeof(u32));
+    u16* ids = malloc((size_t)(PACK_TEXT_COUNT + 1) * trackCount * sizeof(u16));
+    PackColumnsHeader header;
+    u32 totalNames = 0;
+    bool ok = values && names && ids;
+
+    for (int column = 0; column < PACK_TEXT_COUNT && ok; ++column) {
+        for (u32 i = 0; i < trackCount; ++i)
+            values[i] = (ColumnValue){ column_text(&inputs[i], column), i };
+        qsort(values, trackCount, sizeof(ColumnValue), compare_values);
+
+        u32 count = 0;
+        for (u32 i = 0; i < trackCount && ok; ++i) {
+            if (i == 0 || strcmp(values[i].text, values[i - 1].text) != 0) {
+                ok = count <= 0xFFFF;
+                const PackTrack* entry = &entries[values[i].track];
+                names[totalNames + count++] = column == PACK_TEXT_GENRE ? pool_add(pool, values[i].text) :
+                                              column == PACK_TEXT_ARTIST ? entry->artist : entry->album;
+            }
+            ids[column * trackCount + values[i].track] = (u16)(count - 1);
+        }
+        header.nameCount[column] = count;
+        totalNames += count;
+    }
+    for (u32 i = 0; i < trackCount && ok; ++i)
+        ids[PACK_TEXT_COUNT * trackCount + i] = inputs[i].year;
+
+    u8* section = NULL;
+    if (ok) {
+        u32 namesSize = totalNames * sizeof(u32);
+        u32 idsSize = (PACK_TEXT_COUNT + 1) * trackCount * sizeof(u16);
+        *size = sizeof(header) + namesSize + idsSize;
+        section = malloc(*size);
+        memcpy(section, &header, sizeof(header));
+        memcpy(section + sizeof(header), names, namesSize);
+        memcpy(section + sizeof(header) + namesSize, ids, idsSize);
+    }
+    free(values);
+    free(names);
+    free(ids);
+    return section;
+}
+
+// The tag table is title, artist, album per track, matching the COLLATE_FIELD_* order
+static const char* tag_field(u32 track, int field, void* user) {
+    const char** tags = (const char**)user;
+    return tags[track * 3 + field];
+}
+
+/* One track per file, or per cut of a file with a CUE sheet
+A cut takes its title and performer from the sheet, falling back to the
+sheet's performer and then the file's artist; the album is the file's, or
+failing that the sheet's title or the file's own title.
+*/
+static Input* cut_tracks(const Input* files, u32 fileCount, u32* trackCount) {
+    u32 count = 0;
+    for (u32 i = 0; i < fileCount; ++i)
+        count += files[i].cueCount ? files[i].cueCount : 1;
+
+    Input* tracks = calloc(count, sizeof(Input));
+    u32 t = 0;
+    for (u32 i = 0; i < fileCount; ++i) {
+        const Input* file = &files[i];
+        if (!file->cueCount) {
+            tracks[t] = *file;
+            tracks[t++].source = i;
+            continue;
+        }
+
+        const char* album = file->album ? file->album : file->cueTitle ? file->cueTitle : file->title;
+        for (u32 c = 0; c < file->cueCount; ++c) {
+            const CueTrack* cue = &file->cues[c];
+            Input* cut = &tracks[t++];
+            *cut = *file;
+            cut->source = i;
+            cut->start = cue->start;
+            cut->totalSamples = (c + 1 < file->cueCount ? file->cues[c + 1].start : file->totalSamples) - cue->start;
+            cut->artist = cue->performer ? cue->performer : file->cuePerformer ? file->cuePerformer : file->artist;
+            cut->album = (char*)album;
+            memcpy(cut->waveform, cue->waveform, PACK_WAVEFORM_POINTS);
+            if (cue->title) {
+                cut->title = cue->title;
+            } else {
+                size_t len = strlen(file->title) + 16;
+                cut->title = malloc(len);
+                snprintf(cut->title, len, "%s - %u", file->title, c + 1);
+            }
+        }
+    }
+
+    *trackCount = count;
+    return tracks;
+}
+
+int main(int argc, char** argv) {
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int arg = 1;
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+        threads = atol(argv[2]);
+        arg = 3;
+    }
+    if (argc - arg < 2 || threads < 1) {
+        fprintf(stderr, "usage: %s [-j threads] library.xpk <track.ogg | track.wav | directory> ...\n", argv[0]);
+        return 1;
+    }
+    const char* outPath = argv[arg];
+
+    u32 fileCount;
+    char** paths = collect_paths(argv + arg + 1, argc - arg - 1, &fileCount);
+    if (fileCount == 0) {
+        fprintf(stderr, "no .ogg or .wav files found\n");
+        return 1;
+    }
+
+    Input* inputs = calloc(fileCount, sizeof(Input));
+    for (u32 i = 0; i < fileCount; ++i)
+        inputs[i].path = paths[i];
+
+    if ((u32)threads > fileCount)
+        threads = fileCount;
+
+    WorkQueue queue = { inputs, fileCount, 0 };
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    double start = seconds_now();
+    for (long i = 0; i < threads; ++i)
+        pthread_create(&workers[i], NULL, worker, &queue);
+    for (long i = 0; i < threads; ++i)
+        pthread_join(workers[i], NULL);
+    double elapsed = seconds_now() - start;
+
+    u32 totalSeek = 0;
+    u32 cutFiles = 0;
+    double audioSeconds = 0.0;
+    for (u32 i = 0; i < fileCount; ++i) {
+        if (!inputs[i].ok) {
+            fprintf(stderr, "%s: not a readable Ogg Vorbis or 16-bit WAV file\n", inputs[i].path);
+            return 1;
+        }
+        if (inputs[i].decodedSamples != inputs[i].totalSamples) {
+            fprintf(stderr, "%s: warning: decoded %llu samples, last granule says %u\n", inputs[i].path,
+                (unsigned long long)inputs[i].decodedSamples, inputs[i].totalSamples);
+        }
+        totalSeek += inputs[i].seekCount;
+        cutFiles += inputs[i].cueCount > 0;
+        audioSeconds += (double)inputs[i].totalSamples / inputs[i].sampleRate;
+    }
+
+    u32 trackCount;
+    Input* tracks = cut_tracks(inputs, fileCount, &trackCount);
+
+    // Offset 0 is the empty string that missing fields point at
+    StringPool pool = { calloc(1, 256), 1, 256 };
+
+    // Cuts of one file are consecutive and share its seek points
+    PackTrack* entries = calloc(trackCount, sizeof(PackTrack));
+    PackSeekPoint* seek = calloc(totalSeek ? totalSeek : 1, sizeof(PackSeekPoint));
+    u32* cueStarts = calloc(trackCount, sizeof(u32));
+    u32 seekFirst = 0;
+    for (u32 i = 0; i < trackCount; ++i) {
+        Input* in = &tracks[i];
+        PackTrack* entry = &entries[i];
+        bool firstOfFile = i == 0 || in->source != tracks[i - 1].source;
+        entry->dataSize = in->size;
+        entry->headerSize = in->headerSize;
+        entry->sampleRate = in->sampleRate;
+        entry->totalSamples = in->totalSamples;
+        entry->channels = in->channels;
+        entry->seekFirst = firstOfFile ? seekFirst : entries[i - 1].seekFirst;
+        entry->seekCount = in->seekCount;
+        entry->title = pool_add(&pool, in->title);
+        entry->artist = pool_add(&pool, in->artist);
+        entry->album = pool_add(&pool, in->album);
+        cueStarts[i] = in->start;
+        if (firstOfFile) {
+            memcpy(seek + seekFirst, in->seek, in->seekCount * sizeof(PackSeekPoint));
+            seekFirst += in->seekCount;
+        }
+    }
+
+    // Added before the string pool is laid out, since genre names go into it
+    u32 columnsSize = 0;
+    u8* columns = build_columns(tracks, entries, trackCount, &pool, &columnsSize);
+    if (!columns)
+        fprintf(stderr, "warning: too many distinct tags, smart playlists will be unavailable\n");
+
+    PackLoudness* loudness = calloc(trackCount, sizeof(PackLoudness));
+    u8* waveforms = calloc(trackCount, PACK_WAVEFORM_POINTS);
+    const char** tags = calloc(trackCount * 3, sizeof(char*));
+    for (u32 i = 0; i < trackCount; ++i) {
+        loudness[i] = tracks[i].loudness;
+        memcpy(waveforms + i * PACK_WAVEFORM_POINTS, tracks[i].waveform, PACK_WAVEFORM_POINTS);
+        tags[i * 3] = tracks[i].title;
+        tags[i * 3 + 1] = tracks[i].artist ? tracks[i].artist : "";
+        tags[i * 3 + 2] = tracks[i].album ? tracks[i].album : "";
+    }
+    u32 searchSize;
+    u8* search = searchBuildIndex(tags, 3, trackCount, &searchSize);
+
+    u32* orders = malloc((size_t)2 * PACK_SORT_COUNT * trackCount * sizeof(u32) + 1);
+    if (!orders || !collateBuildOrders(trackCount, tag_field, tags, orders, orders + PACK_SORT_COUNT * trackCount)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    SectionData data[MAX_SECTIONS] = {
+        { PACK_SECTION_TRACKS, entries, trackCount * sizeof(PackTrack) },
+        { PACK_SECTION_SEEK, seek, totalSeek * sizeof(PackSeekPoint) },
+        { PACK_SECTION_STRINGS, pool.data, pool.size },
+        { PACK_SECTION_LOUDNESS, loudness, trackCount * sizeof(PackLoudness) },
+        { PACK_SECTION_WAVEFORM, waveforms, trackCount * PACK_WAVEFORM_POINTS },
+        { PACK_SECTION_SEARCH, search, searchSize },
+        { PACK_SECTION_SORT, orders, 2 * PACK_SORT_COUNT * trackCount * sizeof(u32) },
+    };
+    u32 sectionCount = 7;
+    if (columns)
+        data[sectionCount++] = (SectionData){ PACK_SECTION_COLUMNS, columns, columnsSize };
+    if (cutFiles)
+        data[sectionCount++] = (SectionData){ PACK_SECTION_CUES, cueStarts, trackCount * sizeof(u32) };
+
+    // Lay out the directory with every section 4-byte aligned, then the page-aligned track data after it
+    PackSection sections[MAX_SECTIONS];
+    u32 offset = sizeof(PackHeader) + sectionCount * sizeof(PackSection);
+    for (u32 i = 0; i < sectionCount; ++i) {
+        offset = align_up(offset, 4);
+        sections[i] = (PackSection){ data[i].id, offset, data[i].size };
+        offset += data[i].size;
+    }
+
+    PackHeader header = {
+        .magic = PACK_MAGIC,
+        .version = PACK_VERSION,
+        .sectionCount = sectionCount,
+        .trackCount = trackCount,
+        .directorySize = offset
+    };
+
+    u32 dataOffset = align_up(offset, PACK_DATA_ALIGN);
+    for (u32 i = 0; i < trackCount; ++i) {
+        if (i > 0 && tracks[i].source == tracks[i - 1].source) {
+            entries[i].dataOffset = entries[i - 1].dataOffset;
+            continue;
+        }
+        entries[i].dataOffset = dataOffset;
+        dataOffset = align_up(dataOffset + entries[i].dataSize, PACK_DATA_ALIGN);
+    }
+
+    FILE* out = fopen(outPath, "wb");
+    if (!out) {
+        fprintf(stderr, "%s: cannot create\n", outPath);
+        return 1;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(sections, sizeof(PackSection), sectionCount, out);
+    u32 position = sizeof(PackHeader) + sectionCount * sizeof(PackSection);
+    for (u32 i = 0; i < sectionCount; ++i) {
+        write_padding(out, sections[i].offset - position);
+        fwrite(data[i].data, 1, data[i].size, out);
+        position = sections[i].offset + sections[i].size;
+    }
+
+    u32 written = header.directorySize;
+    for (u32 i = 0; i < fileCount; ++i) {
+        u32 track = 0;
+        while (tracks[track].source != i)
+            track++;
+        write_padding(out, entries[track].dataOffset - written);
+        if (!copy_file(out, inputs[i].path, inputs[i].size)) {
+            fprintf(stderr, "%s: changed while packing\n", inputs[i].path);
+            return 1;
+        }
+        written = entries[track].dataOffset + inputs[i].size;
+    }
+    write_padding(out, align_up(written, PACK_DATA_ALIGN) - written);
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s: write failed\n", outPath);
+        return 1;
+    }
+
+    for (u32 i = 0; i < trackCount; ++i) {
+        printf("%-40s %6.1fs %5uHz %uch %4u seek points %+6.2fdB peak %5u\n", tracks[i].title,
+            (double)tracks[i].totalSamples / tracks[i].sampleRate,
+            tracks[i].sampleRate, tracks[i].channels, tracks[i].seekCount,
+            tracks[i].loudness.gain / 100.0, tracks[i].loudness.peak);
+    }
+    printf("%u tracks from %u files (%u cut by CUE sheets), %u bytes\n", trackCount, fileCount, cutFiles, written);
+    printf("analysed in %.2fs on %ld threads: %.2f files/s, %.1fx realtime\n",
+        elapsed, threads, fileCount / elapsed, audioSeconds / elapsed);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/* render - runs the playback engine offline, faster than realtime
+Usage: render [-o out.wav] [-T trace.json] [-e effect,...] [-m old|new] track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -o render tools/render.c tools/host/ndsp_host.c tools/host/ctru_host.c
+       tools/host/assets_host.c source/latency.c source/memory.c source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c source/collate.c source/filter.c source/history.c source/stats.c source/trace.c -lvorbisidec -lm
+
+The files stand in for the embedded tracks and each is played start to finish
+through player.c exactly as on the 3DS, except that NDSP frames are driven by
+this loop instead of the DSP clock. With -o, the PCM of every wave buffer the
+DSP consumes is written to a WAV file, giving golden output for checking
+optimized decode paths. Without it the run is a pure throughput benchmark of
+the whole engine: decode, buffer queueing and the frame callback. Clock
+boost decisions are printed as they happen, so a slow decode path shows up
+as boost being switched on. Built with -DTRACE_ENABLED, -T saves the scope
+timers (callbacks, reads, seeks) as a Chrome trace. -e runs an effects
+chain (bass, widen, compressor, limiter, with the UI presets' settings) on
+every buffer; -m old checks it against the Old 3DS budget instead.
+*/
+#include <3ds.h>
+#include "assets_host.h"
+#include "boost.h"
+#include "effects.h"
+#include "player.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    FILE* file;
+    int channels;
+    u32 rate;
+    u64 frames;
+    bool mismatch;
+} WavWriter;
+
+static void write_u32(FILE* file, u32 value) {
+    u8 bytes[4] = { value, value >> 8, value >> 16, value >> 24 };
+    fwrite(bytes, 1, 4, file);
+}
+
+static void write_u16(FILE* file, u16 value) {
+    u8 bytes[2] = { value, value >> 8 };
+    fwrite(bytes, 1, 2, file);
+}
+
+// Header sizes are filled in by wav_finish once the length is known
+static void wav_header(WavWriter* wav) {
+    u32 dataBytes = (u32)(wav->frames * wav->channels * sizeof(s16));
+    fseek(wav->file, 0, SEEK_SET);
+    fwrite("RIFF", 1, 4, wav->file);
+    write_u32(wav->file, 36 + dataBytes);
+    fwrite("WAVEfmt ", 1, 8, wav->file);
+    write_u32(wav->file, 16);
+    write_u16(wav->file, 1);
+    write_u16(wav->file, wav->channels);
+    write_u32(wav->file, wav->rate);
+    write_u32(wav->file, wav->rate * wav->channels * sizeof(s16));
+    write_u16(wav->file, wav->channels * sizeof(s16));
+    write_u16(wav->file, 16);
+    fwrite("data", 1, 4, wav->file);
+    write_u32(wav->file, dataBytes);
+}
+
+static void wav_finish(WavWriter* wav) {
+    wav_header(wav);
+    fclose(wav->file);
+}
+
+static WavWriter wav;
+static u64 frames_played;
+
+static void on_consumed(int id, const s16* samples, u32 frames, int channels, float rate, void* data) {
+    frames_played += frames;
+    if (!wav.file)
+        return;
+
+    if (wav.channels == 0) {
+        wav.channels = channels;
+        wav.rate = (u32)rate;
+        wav_header(&wav);
+    }
+    if (channels != wav.channels || (u32)rate != wav.rate) {
+        wav.mismatch = true;
+        return;
+    }
+    fwrite(samples, sizeof(s16) * channels, frames, wav.file);
+    wav.frames += frames;
+}
+
+static void print_boost_events(void) {
+    BoostEvent event;
+    while (boostPollEvent(&event)) {
+        if (event.type == BOOST_EVENT_TRACK_SUMMARY)
+            printf("  boost on %lux for %.2fs of %.2fs\n", (unsigned long)event.boosts, event.boostedSeconds,
+                event.playedSeconds);
+        else
+            printf("  boost %s at %.2fs: %.2fx realtime, %.0f%% queued\n", event.type == BOOST_EVENT_ON ? "on" : "off",
+                event.playedSeconds, event.realtime, event.fill * 100.0f);
+    }
+}
+
+// Comma-separated effect names into a chain; false on an unknown name or too many
+static bool parse_effects(const char* list, EffectConfig* chain, u32* count) {
+    static const struct {
+        const char* name;
+        EffectConfig config;
+    } known[] = {
+        { "bass", { .type = EFFECT_BASS, .gain = 60, .cutoff = 120 } },
+        { "widen", { .type = EFFECT_WIDEN, .width = 150 } },
+        { "compressor", { .type = EFFECT_COMPRESSOR, .threshold = 120, .ratio = 4 } },
+        { "limiter", { .type = EFFECT_COMPRESSOR, .threshold = 10, .ratio = 0 } },
+    };
+
+    *count = 0;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        int found = -1;
+        for (int i = 0; i < (int)(sizeof(known) / sizeof(known[0])); ++i) {
+            if (strlen(known[i].name) == length && strncmp(list, known[i].name, length) == 0)
+                found = i;
+        }
+        if (found < 0 || *count == EFFECTS_MAX_CHAIN) {
+            fprintf(stderr, "%.*s: unknown effect or chain too long\n", (int)length, list);
+            return false;
+        }
+        chain[(*count)++] = known[found].config;
+        list += length + (list[length] == ',');
+    }
+    return true;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    const char* outPath = NULL;
+    const char* tracePath = NULL;
+    const char* effectList = NULL;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-o") == 0)
+            outPath = argv[arg + 1];
+        else if (strcmp(argv[arg], "-T") == 0)
+            tracePath = argv[arg + 1];
+        else if (strcmp(argv[arg], "-e") == 0)
+            effectList = argv[arg + 1];
+        else if (strcmp(argv[arg], "-m") == 0)
+            hostSetNew3DS(strcmp(argv[arg + 1], "old") != 0);
+        else
+            break;
+        arg += 2;
+    }
+    if (arg >= argc) {
+        fprintf(stderr, "usage: %s [-o out.wav] [-T trace.json] [-e effect,...] [-m old|new] track.ogg [track.ogg ...]\n",
+            argv[0]);
+        return 1;
+    }
+
+    if (!hostAssetsLoad(argv + arg, argc - arg))
+        return 1;
+
+    if (outPath) {
+        wav.file = fopen(outPath, "wb");
+        if (!wav.file) {
+            fprintf(stderr, "%s: cannot create\n", outPath);
+            return 1;
+        }
+    }
+
+    playerInit();
+    hostNdspSetSink(on_consumed, NULL);
+
+    if (effectList) {
+        EffectConfig chain[EFFECTS_MAX_CHAIN];
+        u32 count;
+        char error[64];
+        if (!parse_effects(effectList, chain, &count))
+            return 1;
+        if (!playerSetEffects(chain, count, error, sizeof(error))) {
+            fprintf(stderr, "effects refused: %s\n", error);
+            return 1;
+        }
+        printf("effects: %s, %lu cycles/frame\n", effectList, (unsigned long)effectsChainCost());
+    }
+
+    double totalAudio = 0.0, totalWall = 0.0;
+    for (int i = 0; i < playerTrackCount(); ++i) {
+        u64 startFrames = frames_played;
+        double startTime = hostNdspTime();
+        double start = seconds_now();
+
+        playerPlay(i);
+        if (!playerIsPlaying()) {
+            fprintf(stderr, "%s: cannot decode\n", playerTrackTitle(i));
+            continue;
+        }
+        while (playerIsPlaying()) {
+            hostNdspFrame();
+            boostUpdate();
+        }
+
+        double wall = seconds_now() - start;
+        double audio = hostNdspTime() - startTime;
+        totalAudio += audio;
+        totalWall += wall;
+        printf("%-32s %8llu frames %7.2fs audio in %6.3fs: %6.1fx realtime\n", playerTrackTitle(i),
+            (unsigned long long)(frames_played - startFrames), audio, wall, audio / wall);
+        boostTrackStart(-1);
+        print_boost_events();
+    }
+
+    printf("total %.2fs audio in %.3fs: %.1fx realtime, %u underruns\n",
+        totalAudio, totalWall, totalAudio / totalWall, hostNdspUnderruns(0));
+
+    if (tracePath && !traceWrite(tracePath))
+        fprintf(stderr, "%s: cannot write (is tracing built in with -DTRACE_ENABLED?)\n", tracePath);
+
+    playerExit();
+    hostAssetsFree();
+
+    if (wav.file) {
+        wav_finish(&wav);
+        if (wav.mismatch)
+            fprintf(stderr, "warning: tracks with a different format were left out of %s\n", outPath);
+    }
+    return 0;
+}
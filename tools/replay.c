@@ -0,0 +1,225 @@
+/* replay - runs main.c against a recorded input session on a PC and times every frame
+Usage: replay [-d sd-dir] [-o frames.csv] input.rec track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -Dmain=app_main -o replay tools/replay.c tools/host/ndsp_host.c
+       tools/host/ctru_host.c tools/host/hid_host.c tools/host/c2d_host.c tools/host/art_host.c tools/host/assets_host.c
+       source/main.c source/listview.c source/panel.c source/keyboard.c source/playlist.c source/record.c source/latency.c source/memory.c
+       source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c
+       source/collate.c source/filter.c source/history.c source/stats.c source/trace.c -lvorbisidec -lm
+
+The recording comes from holding L+R while the app starts on the 3DS
+(sdmc:/3ds/3dXMMP/input.rec). Each main loop iteration gets exactly the
+keys and touch point it got on the device, and the tick counter advances by
+the recorded time between iterations, so the app takes the same path through
+its code every run. Graphics are stubbed, NDSP runs on its virtual clock and
+covers aren't decoded. sdmc:/ paths resolve inside sd-dir (default: the
+current directory); give it a copy of the card's 3dXMMP directory from when
+the recording began, and the same tracks, or the replay diverges.
+
+CPU time of the app's own work is measured per frame, apart from the audio
+the virtual DSP consumed meanwhile, and printed as a distribution with the
+worst frames; -o writes every frame's figures to a CSV file.
+*/
+#include <3ds.h>
+#include <citro2d.h>
+#include "assets_host.h"
+#include "record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// -Dmain=app_main renames main.c's entry point; this file's main must keep its name
+#undef main
+int app_main(void);
+
+#define REPLAY_FRAME_BUDGET_US (1000000.0 / 60)
+#define REPLAY_WORST_FRAMES    5
+
+typedef struct {
+    double appUs;    // the main loop iteration itself
+    double audioUs;  // NDSP frames and the player's callback while the frame's ticks elapsed
+    double seconds;  // recorded time the frame began at
+    bool rendered;
+} FrameTime;
+
+static struct {
+    RecordFrame* frames;
+    u32 count;
+    u32 next;         // frame the next aptMainLoop hands to the app
+    u32 timed;        // frames whose iteration has finished
+    FrameTime* times;
+    double frameStart;
+    double virtualSeconds;
+    double startupUs;
+    u32 lastRenders;
+} replay;
+
+static double cpu_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool load_recording(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    RecordHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != RECORD_MAGIC || header.layout != RECORD_LAYOUT) {
+        fprintf(stderr, "%s: not an input recording\n", path);
+        fclose(file);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file) - (long)sizeof(header);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    replay.count = (u32)(bytes / sizeof(RecordFrame));
+    replay.frames = (RecordFrame*)malloc((replay.count ? replay.count : 1) * sizeof(RecordFrame));
+    replay.times = (FrameTime*)calloc(replay.count ? replay.count : 1, sizeof(FrameTime));
+    bool ok = replay.frames && replay.times &&
+              fread(replay.frames, sizeof(RecordFrame), replay.count, file) == replay.count;
+    fclose(file);
+    if (!ok)
+        fprintf(stderr, "%s: cannot read\n", path);
+    return ok;
+}
+
+// Runs at the top of every main loop iteration: closes the previous frame's timing and feeds the next one
+static bool on_frame(void* data) {
+    double now = cpu_us();
+    u32 renders = hostC3DFrameCount();
+    if (replay.next > 0) {
+        FrameTime* time = &replay.times[replay.next - 1];
+        time->appUs = now - replay.frameStart;
+        time->rendered = renders != replay.lastRenders;
+        replay.timed = replay.next;
+    } else {
+        replay.startupUs = now - replay.frameStart;
+    }
+    replay.lastRenders = renders;
+    if (replay.next == replay.count)
+        return false;
+
+    const RecordFrame* frame = &replay.frames[replay.next];
+    hostClockAdvance(frame->ticks);
+    replay.virtualSeconds += (double)frame->ticks / SYSCLOCK_ARM11;
+    while (hostNdspTime() < replay.virtualSeconds)
+        hostNdspFrame();
+    hostHidSetInput(frame->down, frame->held, frame->up, frame->repeat, frame->touchX, frame->touchY);
+
+    FrameTime* time = &replay.times[replay.next++];
+    time->seconds = replay.virtualSeconds;
+    replay.frameStart = cpu_us();
+    time->audioUs = replay.frameStart - now;
+    return true;
+}
+
+// Frame indices by descending app time
+static int compare_slowest(const void* a, const void* b) {
+    double x = replay.times[*(const u32*)a].appUs, y = replay.times[*(const u32*)b].appUs;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void print_summary(u32 timed) {
+    if (timed == 0) {
+        printf("no frames replayed\n");
+        return;
+    }
+
+    u32* order = (u32*)malloc(timed * sizeof(u32));
+    double appTotal = 0.0, audioTotal = 0.0;
+    u32 rendered = 0, overBudget = 0;
+    for (u32 i = 0; i < timed; ++i) {
+        order[i] = i;
+        appTotal += replay.times[i].appUs;
+        audioTotal += replay.times[i].audioUs;
+        rendered += replay.times[i].rendered;
+        overBudget += replay.times[i].appUs > REPLAY_FRAME_BUDGET_US;
+    }
+    qsort(order, timed, sizeof(u32), compare_slowest);
+
+#define PERCENTILE(p) replay.times[order[(timed - 1) * (100 - (p)) / 100]].appUs
+    printf("%u frames (%u rendered), %.1fs of recorded time, startup %.2f ms\n", timed, rendered,
+        replay.virtualSeconds, replay.startupUs / 1000.0);
+    printf("app CPU per frame: mean %.1f us, p50 %.1f, p95 %.1f, p99 %.1f, max %.1f; %u over %.0f us\n",
+        appTotal / timed, PERCENTILE(50), PERCENTILE(95), PERCENTILE(99), PERCENTILE(100), overBudget,
+        REPLAY_FRAME_BUDGET_US);
+    printf("audio CPU: %.1f ms in total, %u underruns\n", audioTotal / 1000.0, hostNdspUnderruns(0));
+#undef PERCENTILE
+
+    // With their input, to find what the user was doing
+    printf("worst frames:\n");
+    for (u32 n = 0; n < REPLAY_WORST_FRAMES && n < timed; ++n) {
+        u32 i = order[n];
+        printf("  %6u at %7.2fs: %8.1f us%s, keys down %08x held %08x\n", i,
+            replay.times[i].seconds, replay.times[i].appUs,
+            replay.times[i].rendered ? " (rendered)" : "", replay.frames[i].down, replay.frames[i].held);
+    }
+    free(order);
+}
+
+static bool write_csv(FILE* file, u32 timed) {
+    fprintf(file, "frame,app_us,audio_us,rendered,down,held\n");
+    for (u32 i = 0; i < timed; ++i)
+        fprintf(file, "%u,%.1f,%.1f,%d,0x%08x,0x%08x\n", i, replay.times[i].appUs, replay.times[i].audioUs,
+            replay.times[i].rendered, replay.frames[i].down, replay.frames[i].held);
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv) {
+    const char* sdDir = NULL;
+    const char* csvPath = NULL;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-d") == 0)
+            sdDir = argv[arg + 1];
+        else if (strcmp(argv[arg], "-o") == 0)
+            csvPath = argv[arg + 1];
+        else
+            break;
+        arg += 2;
+    }
+    if (arg + 1 >= argc) {
+        fprintf(stderr, "usage: %s [-d sd-dir] [-o frames.csv] input.rec track.ogg [track.ogg ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (!load_recording(argv[arg]) || !hostAssetsLoad(argv + arg + 1, argc - arg - 1))
+        return 1;
+    // Opened before entering sd-dir so a relative path means what it says
+    FILE* csv = csvPath ? fopen(csvPath, "w") : NULL;
+    if (csvPath && !csv) {
+        fprintf(stderr, "%s: cannot create\n", csvPath);
+        return 1;
+    }
+    if (sdDir && chdir(sdDir) != 0) {
+        fprintf(stderr, "%s: cannot enter\n", sdDir);
+        return 1;
+    }
+    // The cache creates its directories below sdmc:/, which must exist like on the card
+    mkdir("sdmc:", 0777);
+
+    hostClockSetVirtual(true);
+    hostAptSetFrameHook(on_frame, NULL);
+    replay.frameStart = cpu_us();
+    app_main();
+
+    // An iteration that ended the app (START) runs into shutdown, so it isn't counted
+    print_summary(replay.timed);
+    if (csv && !write_csv(csv, replay.timed)) {
+        fprintf(stderr, "%s: cannot write\n", csvPath);
+        return 1;
+    }
+
+    free(replay.frames);
+    free(replay.times);
+    hostAssetsFree();
+    return 0;
+}
@@ -0,0 +1,229 @@
+/* soak - drives the playback engine through thousands of random actions on the virtual clock
+Usage: soak [-n actions] [-s seed] [-t tolerance-KiB] track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -o soak tools/soak.c tools/host/ndsp_host.c tools/host/ctru_host.c
+       tools/host/assets_host.c source/latency.c source/memory.c source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c source/collate.c source/filter.c source/history.c source/stats.c -lvorbisidec -lm
+
+Track switches, seeks, pauses, stops and plays to the end are picked from a
+seeded generator and separated by a random number of NDSP frames, so hours
+of listening run in seconds and a failing run can be repeated exactly.
+The heap is sampled with mallinfo every SOAK_SAMPLE_EVERY actions. After a
+warmup, the run fails (exit 1) if the smallest heap in use over the last
+quarter exceeds the smallest over the first by more than the tolerance
+(a leak), or if the heap's size grows the same way (fragmentation that
+keeps the allocator from reusing freed space). Underruns are reported too.
+*/
+#include <3ds.h>
+#include "assets_host.h"
+#include "boost.h"
+#include "player.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SOAK_DEFAULT_ACTIONS   5000
+#define SOAK_SAMPLE_EVERY      50
+#define SOAK_MAX_WAIT_FRAMES   400        // about 2 s of audio between actions
+#define SOAK_MAX_TRACK_FRAMES  (60 * 200) // plays to the end give up after about a minute
+#define SOAK_DEFAULT_TOLERANCE 64         // KiB
+
+typedef enum {
+    ACTION_SWITCH,
+    ACTION_SEEK,
+    ACTION_PAUSE,
+    ACTION_STOP,
+    ACTION_PLAY_TO_END,
+    ACTION_COUNT
+} Action;
+
+// Out of 100; the rest of the range falls to ACTION_SWITCH
+static const int action_weights[ACTION_COUNT] = { 40, 30, 18, 7, 5 };
+static const char* const action_names[ACTION_COUNT] = { "switch", "seek", "pause", "stop", "to end" };
+
+typedef struct {
+    u32 actions;
+    size_t inUse;     // bytes handed out by malloc
+    size_t heap;      // bytes the allocator holds from the system
+    size_t trapped;   // free bytes below the top of the heap that can't be given back
+    double virtualSeconds;
+    u32 underruns;
+} Sample;
+
+static u32 rng_state;
+
+static u32 next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static Sample take_sample(u32 actions) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    Sample sample = {
+        .actions = actions,
+        .inUse = (size_t)info.uordblks + (size_t)info.hblkhd,
+        .heap = (size_t)info.arena + (size_t)info.hblkhd,
+        .trapped = (size_t)info.fordblks - (size_t)info.keepcost,
+        .virtualSeconds = hostNdspTime(),
+        .underruns = hostNdspUnderruns(0),
+    };
+    return sample;
+}
+
+static void run_frames(u32 frames) {
+    for (u32 i = 0; i < frames; ++i) {
+        hostNdspFrame();
+        boostUpdate();
+    }
+
+    // Nothing reads the events here; drain them so the ring's drops don't look like churn
+    BoostEvent event;
+    while (boostPollEvent(&event)) {
+    }
+}
+
+static void print_sample(const Sample* sample) {
+    int seconds = (int)sample->virtualSeconds;
+    printf("%7u actions %3d:%02d:%02d  in use %9zu  heap %9zu  trapped %5.1f%%  underruns %u\n", sample->actions,
+        seconds / 3600, seconds / 60 % 60, seconds % 60, sample->inUse, sample->heap,
+        sample->heap ? 100.0 * sample->trapped / sample->heap : 0.0, sample->underruns);
+}
+
+// Smallest value over samples [first, last); transient decode buffers make the minimum the stable figure
+static size_t window_min(const Sample* samples, u32 first, u32 last, bool heap) {
+    size_t least = (size_t)-1;
+    for (u32 i = first; i < last; ++i) {
+        size_t value = heap ? samples[i].heap : samples[i].inUse;
+        if (value < least)
+            least = value;
+    }
+    return least;
+}
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    u32 actions = SOAK_DEFAULT_ACTIONS;
+    u32 seed = 1;
+    size_t tolerance = SOAK_DEFAULT_TOLERANCE * 1024;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-n") == 0)
+            actions = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else if (strcmp(argv[arg], "-s") == 0)
+            seed = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else if (strcmp(argv[arg], "-t") == 0)
+            tolerance = strtoul(argv[arg + 1], NULL, 10) * 1024;
+        else
+            break;
+        arg += 2;
+    }
+    if (arg >= argc || actions < SOAK_SAMPLE_EVERY * 8) {
+        fprintf(stderr, "usage: %s [-n actions (>= %d)] [-s seed] [-t tolerance-KiB] track.ogg [track.ogg ...]\n",
+            argv[0], SOAK_SAMPLE_EVERY * 8);
+        return 1;
+    }
+    rng_state = seed ? seed : 1;
+
+    if (!hostAssetsLoad(argv + arg, argc - arg))
+        return 1;
+    playerInit();
+
+    int tracks = playerTrackCount();
+    u32 sampleCount = actions / SOAK_SAMPLE_EVERY + 1;
+    Sample* samples = calloc(sampleCount, sizeof(Sample));
+    u32 counts[ACTION_COUNT] = { 0 };
+    u32 taken = 0;
+    double start = seconds_now();
+
+    samples[taken++] = take_sample(0);
+    for (u32 i = 1; i <= actions; ++i) {
+        int roll = next_random() % 100;
+        Action action = ACTION_SWITCH;
+        for (int a = 0, sum = 0; a < ACTION_COUNT; ++a) {
+            sum += action_weights[a];
+            if (roll < sum) {
+                action = (Action)a;
+                break;
+            }
+        }
+        counts[action]++;
+
+        int track = next_random() % tracks;
+        switch (action) {
+        case ACTION_SWITCH:
+            playerPlay(track);
+            break;
+        case ACTION_SEEK:
+            playerSeek(playerTrackLength(track) * (next_random() % 1000) / 1000.0f);
+            break;
+        case ACTION_PAUSE:
+            playerPause(!playerIsPaused());
+            break;
+        case ACTION_STOP:
+            playerStop();
+            break;
+        case ACTION_PLAY_TO_END:
+            if (!playerIsPlaying())
+                playerPlay(track);
+            playerPause(false);
+            for (u32 f = 0; f < SOAK_MAX_TRACK_FRAMES && playerIsPlaying(); f += SOAK_MAX_WAIT_FRAMES)
+                run_frames(SOAK_MAX_WAIT_FRAMES);
+            break;
+        default:
+            break;
+        }
+        run_frames(1 + next_random() % SOAK_MAX_WAIT_FRAMES);
+
+        if (i % SOAK_SAMPLE_EVERY == 0) {
+            samples[taken] = take_sample(i);
+            if (taken % (sampleCount / 10 ? sampleCount / 10 : 1) == 0)
+                print_sample(&samples[taken]);
+            taken++;
+        }
+    }
+    double wall = seconds_now() - start;
+    playerStop();
+
+    // First window starts after a warmup so caches and allocator pools have filled
+    u32 quarter = taken / 4;
+    u32 warmup = taken / 8;
+    size_t earlyUse = window_min(samples, warmup, warmup + quarter, false);
+    size_t lateUse = window_min(samples, taken - quarter, taken, false);
+    size_t earlyHeap = window_min(samples, warmup, warmup + quarter, true);
+    size_t lateHeap = window_min(samples, taken - quarter, taken, true);
+    const Sample* last = &samples[taken - 1];
+
+    printf("\n%u actions:", actions);
+    for (int a = 0; a < ACTION_COUNT; ++a)
+        printf(" %u %s%s", counts[a], action_names[a], a + 1 < ACTION_COUNT ? "," : "\n");
+    printf("%.1f h of virtual time in %.1fs (%.0fx), %u underruns\n", last->virtualSeconds / 3600.0, wall,
+        last->virtualSeconds / wall, last->underruns);
+    printf("in use: %zu -> %zu bytes (%+ld)\n", earlyUse, lateUse, (long)lateUse - (long)earlyUse);
+    printf("heap:   %zu -> %zu bytes (%+ld)\n", earlyHeap, lateHeap, (long)lateHeap - (long)earlyHeap);
+
+    bool leaked = lateUse > earlyUse + tolerance;
+    bool fragmented = lateHeap > earlyHeap + tolerance;
+    if (leaked)
+        printf("FAIL: heap in use grew by more than %zu KiB\n", tolerance / 1024);
+    if (fragmented)
+        printf("FAIL: heap size grew by more than %zu KiB\n", tolerance / 1024);
+    if (!leaked && !fragmented)
+        printf("ok\n");
+
+    free(samples);
+    playerExit();
+    hostAssetsFree();
+    return leaked || fragmented ? 1 : 0;
+}
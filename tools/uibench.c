@@ -0,0 +1,262 @@
+/* uibench - runs main.c through scripted UI phases on a PC and reports per-frame cost and draw counts
+Usage: uibench [-n frames-per-phase] [-d sd-dir] track.ogg [track.ogg ...]
+Build: cc -O2 -pthread -Itools/host -Isource -Dmain=app_main -o uibench tools/uibench.c tools/host/ndsp_host.c
+       tools/host/ctru_host.c tools/host/hid_host.c tools/host/c2d_host.c tools/host/art_host.c tools/host/assets_host.c
+       source/main.c source/listview.c source/panel.c source/keyboard.c source/playlist.c source/record.c source/latency.c source/memory.c
+       source/effects.c source/player.c source/decoder.c source/pack.c source/oggindex.c source/cache.c source/boost.c source/search.c
+       source/collate.c source/filter.c source/history.c source/stats.c source/trace.c -lvorbisidec -lm
+
+Like replay, but the input comes from a fixed script instead of a
+recording: each phase (idle, d-pad scrolling, touch drags on the list,
+track switches, seeking, the debug log) runs for the same number of
+frames at 60 per second of virtual time. For every phase it prints the
+app's CPU time per frame, split into all frames and rendered ones, and
+what the rendered frames handed to citro2d (tools/host/citro2d.h): draw
+calls, batches, glyphs and vertices per frame. Comparing runs before and
+after a UI change shows where a frame's cost went without a 3DS.
+*/
+#include <3ds.h>
+#include <citro2d.h>
+#include "assets_host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// -Dmain=app_main renames main.c's entry point; this file's main must keep its name
+#undef main
+int app_main(void);
+
+#define UIBENCH_DEFAULT_FRAMES 600
+#define UIBENCH_FRAME_TICKS    (SYSCLOCK_ARM11 / 60)
+#define UIBENCH_LIST_Y         200  // touch row on the track list where drags start
+
+typedef enum {
+    PHASE_IDLE,
+    PHASE_SCROLL,
+    PHASE_DRAG,
+    PHASE_SWITCH,
+    PHASE_SEEK,
+    PHASE_LOG,
+    PHASE_COUNT
+} Phase;
+
+static const char* const phase_names[PHASE_COUNT] = { "idle", "scroll", "drag", "switch", "seek", "log" };
+
+typedef struct {
+    u32 down;
+    u32 held;
+    u32 up;
+    u32 repeat;
+    u16 touchX;
+    u16 touchY;
+} Input;
+
+typedef struct {
+    double appUs;
+    bool rendered;
+    hostC2DStats draw;
+} FrameCost;
+
+static struct {
+    u32 framesPerPhase;
+    u32 next;   // frame the next aptMainLoop hands to the app
+    u32 timed;  // frames whose iteration has finished
+    FrameCost* costs;
+    double frameStart;
+    double virtualSeconds;
+    u32 lastRenders;
+    Input previous;
+} bench;
+
+static double cpu_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Keys held during frame `f` of a phase; presses and releases are derived from the previous frame
+static Input phase_input(Phase phase, u32 f) {
+    Input in = { 0 };
+    switch (phase) {
+    case PHASE_SCROLL:
+        in.held = KEY_DDOWN;
+        if (f % 4 == 0)
+            in.repeat = KEY_DDOWN;
+        break;
+    case PHASE_DRAG:
+        // A flick up the list every 40 frames: 20 frames of contact, then let it coast
+        if (f % 40 < 20) {
+            in.held = KEY_TOUCH;
+            in.touchX = 160;
+            in.touchY = UIBENCH_LIST_Y - (f % 40) * 8;
+        }
+        break;
+    case PHASE_SWITCH:
+        if (f % 20 == 0)
+            in.held = KEY_DRIGHT;
+        break;
+    case PHASE_SEEK:
+        if (f % 60 < 50)
+            in.held = KEY_R;
+        break;
+    case PHASE_LOG:
+        // Open the log, pause and resume a few times to fill it, and close it again
+        if (f == 0 || f + 1 == bench.framesPerPhase)
+            in.held = KEY_SELECT;
+        else if (f % 30 == 0)
+            in.held = KEY_A;
+        break;
+    default:
+        break;
+    }
+    return in;
+}
+
+static void record_frame(double now) {
+    u32 renders = hostC3DFrameCount();
+    FrameCost* cost = &bench.costs[bench.next - 1];
+    cost->appUs = now - bench.frameStart;
+    cost->rendered = renders != bench.lastRenders;
+    if (cost->rendered)
+        hostC2DGetFrameStats(&cost->draw);
+    bench.lastRenders = renders;
+    bench.timed = bench.next;
+}
+
+// Runs at the top of every main loop iteration: closes the previous frame's timing and scripts the next one
+static bool on_frame(void* data) {
+    double now = cpu_us();
+    if (bench.next > 0)
+        record_frame(now);
+    else
+        bench.lastRenders = hostC3DFrameCount();
+    if (bench.next == bench.framesPerPhase * PHASE_COUNT)
+        return false;
+
+    hostClockAdvance(UIBENCH_FRAME_TICKS);
+    bench.virtualSeconds += 1.0 / 60;
+    while (hostNdspTime() < bench.virtualSeconds)
+        hostNdspFrame();
+
+    Phase phase = (Phase)(bench.next / bench.framesPerPhase);
+    Input in = phase_input(phase, bench.next % bench.framesPerPhase);
+    in.down = in.held & ~bench.previous.held;
+    in.up = bench.previous.held & ~in.held;
+    in.repeat |= in.down;
+    if (!(in.held & KEY_TOUCH)) {
+        in.touchX = 0;
+        in.touchY = 0;
+    }
+    hostHidSetInput(in.down, in.held, in.up, in.repeat, in.touchX, in.touchY);
+    bench.previous = in;
+    bench.next++;
+    bench.frameStart = cpu_us();
+    return true;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void print_phase(Phase phase, double* scratch) {
+    const FrameCost* costs = bench.costs + phase * bench.framesPerPhase;
+    u32 frames = bench.timed > phase * bench.framesPerPhase ? bench.timed - phase * bench.framesPerPhase : 0;
+    if (frames > bench.framesPerPhase)
+        frames = bench.framesPerPhase;
+    if (frames == 0)
+        return;
+
+    double total = 0.0;
+    u32 rendered = 0, dropped = 0;
+    hostC2DStats sum = { 0 }, most = { 0 };
+    for (u32 i = 0; i < frames; ++i) {
+        total += costs[i].appUs;
+        if (!costs[i].rendered)
+            continue;
+
+        const hostC2DStats* draw = &costs[i].draw;
+        scratch[rendered++] = costs[i].appUs;
+        dropped += draw->dropped;
+        sum.drawCalls += draw->drawCalls;
+        sum.batches += draw->batches;
+        sum.glyphsDrawn += draw->glyphsDrawn;
+        sum.vertices += draw->vertices;
+        sum.drawUs += draw->drawUs;
+#define KEEP_MOST(field) if (draw->field > most.field) most.field = draw->field
+        KEEP_MOST(drawCalls);
+        KEEP_MOST(batches);
+        KEEP_MOST(glyphsDrawn);
+        KEEP_MOST(vertices);
+#undef KEEP_MOST
+    }
+
+    printf("%-7s %6u %5u %8.1f", phase_names[phase], frames, rendered, total / frames);
+    if (rendered == 0) {
+        printf("\n");
+        return;
+    }
+    qsort(scratch, rendered, sizeof(double), compare_doubles);
+    printf(" %8.1f %8.1f %8.1f %7.1f %5.0f/%-4u %4.0f/%-3u %6.0f/%-5u %6.0f/%-5u %4u\n",
+        scratch[(rendered - 1) / 2], scratch[(rendered - 1) * 95 / 100], scratch[rendered - 1], sum.drawUs / rendered,
+        (double)sum.drawCalls / rendered, most.drawCalls, (double)sum.batches / rendered, most.batches,
+        (double)sum.glyphsDrawn / rendered, most.glyphsDrawn, (double)sum.vertices / rendered, most.vertices,
+        dropped);
+}
+
+int main(int argc, char** argv) {
+    const char* sdDir = NULL;
+    bench.framesPerPhase = UIBENCH_DEFAULT_FRAMES;
+    int arg = 1;
+    while (arg + 1 < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-n") == 0)
+            bench.framesPerPhase = (u32)strtoul(argv[arg + 1], NULL, 10);
+        else if (strcmp(argv[arg], "-d") == 0)
+            sdDir = argv[arg + 1];
+        else
+            break;
+        arg += 2;
+    }
+    if (arg >= argc || bench.framesPerPhase < 2) {
+        fprintf(stderr, "usage: %s [-n frames-per-phase (>= 2)] [-d sd-dir] track.ogg [track.ogg ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (!hostAssetsLoad(argv + arg, argc - arg))
+        return 1;
+    if (sdDir && chdir(sdDir) != 0) {
+        fprintf(stderr, "%s: cannot enter\n", sdDir);
+        return 1;
+    }
+    // The cache creates its directories below sdmc:/, which must exist like on the card
+    mkdir("sdmc:", 0777);
+
+    u32 frames = bench.framesPerPhase * PHASE_COUNT;
+    bench.costs = (FrameCost*)calloc(frames, sizeof(FrameCost));
+    double* scratch = (double*)malloc(bench.framesPerPhase * sizeof(double));
+    if (!bench.costs || !scratch) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    hostClockSetVirtual(true);
+    hostAptSetFrameHook(on_frame, NULL);
+    double start = cpu_us();
+    app_main();
+
+    printf("%u frames per phase at 60 fps, %.1f s total CPU\n", bench.framesPerPhase, (cpu_us() - start) / 1e6);
+    printf("CPU in us: mean of all frames, then rendered frames only; draw counts per rendered frame as mean/max\n");
+    printf("%-7s %6s %5s %8s %8s %8s %8s %7s %10s %8s %12s %12s %4s\n", "phase", "frames", "drawn", "all", "p50",
+        "p95", "max", "draw", "calls", "batches", "glyphs", "vertices", "drop");
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        print_phase((Phase)phase, scratch);
+
+    free(scratch);
+    free(bench.costs);
+    hostAssetsFree();
+    return 0;
+}